@@ -3,8 +3,389 @@
 
 pxr::Engine* engine {nullptr};
 
-int main()
+//
+// Headless simulation runner. Run with '-sims N -ticks T [-threads K]' to play N independent
+// game sessions, of at most T update ticks each, spread over K threads (default one per core)
+// with a random bot at the controls. Each session runs in its own application instance with
+// its own engine context; the assets are loaded once and shared. The game and the bot of each
+// session draw from their own random streams, split from fixed root seeds, so runs are
+// repeatable whatever the thread count.
+//
+
+struct SimStreams
+{
+  pxr::xorwow _game;
+  pxr::xorwow _bot;
+};
+
+struct SimResult
+{
+  int64_t _ticks;
+  int32_t _score;
+  int32_t _round;
+};
+
+static constexpr int32_t simWindowWidth {SpaceInvaders::baseWorldSize._x + 1};   // world scale 1.
+static constexpr int32_t simWindowHeight {SpaceInvaders::baseWorldSize._y + 1};
+static constexpr float simTickDt {SessionRecording::tickDt};
+static constexpr int32_t botDecisionTicks {30};
+
+static SimResult runSimulation(const SimStreams& streams, int64_t maxTicks, SessionRecorder* recorder = nullptr)
+{
+  pxr::randGenerator = streams._game;
+  pxr::xorwow bot {streams._bot};
+
+  SpaceInvaders app {};
+  app.initialize(nullptr, simWindowWidth, simWindowHeight);
+  app.switchState(GameState::name);
+
+  // The bot holds fire and wanders left and right.
+  pxr::input->setKeyState(pxr::Input::KEY_SPACE, true);
+
+  int64_t tick {0};
+  for(; tick < maxTicks; ++tick){
+    if(tick % botDecisionTicks == 0){
+      uint32_t move = bot.bounded(3);
+      pxr::input->setKeyState(pxr::Input::KEY_LEFT, move == 1);
+      pxr::input->setKeyState(pxr::Input::KEY_RIGHT, move == 2);
+    }
+
+    if(recorder != nullptr)
+      recorder->recordTick(app);
+
+    app.onUpdate(tick * simTickDt, simTickDt);
+    pxr::input->onUpdate();
+
+    if(recorder != nullptr)
+      recorder->recordHashes(app);
+
+    // The session is over when the game leaves play for the hiscore states.
+    std::string state = app.getActiveStateName();
+    if(state != GameState::name && state != SosState::name)
+      break;
+  }
+
+  return {tick, app.getScore(), app.getRound()};
+}
+
+static void runWorker(std::shared_ptr<pxr::Log> log, std::shared_ptr<pxr::Assets> assets,
+                      const std::vector<SimStreams>& streams, std::atomic<int32_t>& nextSim,
+                      int64_t maxTicks, std::vector<SimResult>& results)
+{
+  pxr::Context context {log, assets, 0};
+  int32_t simCount = static_cast<int32_t>(results.size());
+  for(int32_t sim = nextSim++; sim < simCount; sim = nextSim++)
+    results[sim] = runSimulation(streams[sim], maxTicks);
+}
+
+static int runSimulations(int32_t simCount, int64_t maxTicks, int32_t threadCount)
+{
+  auto log = std::make_shared<pxr::Log>();
+  auto assets = std::make_shared<pxr::Assets>();
+
+  // Initializing a prototype instance loads the assets and writes any missing data files, so
+  // the sessions only ever read them.
+  {
+    pxr::Context context {log, assets, 0};
+    SpaceInvaders prototype {};
+    prototype.initialize(nullptr, simWindowWidth, simWindowHeight);
+  }
+  assets->seal();
+
+  pxr::xorwow gameRoot {1}, botRoot {2};
+  std::vector<SimStreams> streams {};
+  for(int32_t sim = 0; sim < simCount; ++sim)
+    streams.push_back({gameRoot.split(), botRoot.split()});
+
+  std::vector<SimResult> results(simCount);
+  std::atomic<int32_t> nextSim {0};
+
+  auto start = std::chrono::steady_clock::now();
+
+  std::vector<std::thread> threads {};
+  for(int32_t i = 0; i < threadCount; ++i)
+    threads.emplace_back(runWorker, log, assets, std::cref(streams), std::ref(nextSim), maxTicks, std::ref(results));
+  for(auto& thread : threads)
+    thread.join();
+
+  std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+
+  int64_t totalTicks {0};
+  int64_t totalScore {0};
+  for(const auto& result : results){
+    totalTicks += result._ticks;
+    totalScore += result._score;
+  }
+
+  std::cout << "sims:" << simCount
+            << " threads:" << threadCount
+            << " ticks:" << totalTicks
+            << " seconds:" << seconds.count()
+            << " ticks/s:" << static_cast<int64_t>(totalTicks / seconds.count())
+            << " mean score:" << (static_cast<double>(totalScore) / simCount)
+            << std::endl;
+
+  return EXIT_SUCCESS;
+}
+
+//
+// Session recording and replay. Run with '-record PATH [-ticks T] [-keyframe-seconds S] [-hashes]'
+// to play the first session of the simulation runner, recording it to PATH with a keyframe every
+// S seconds (see SessionRecording), and its hash stream if asked. Run with '-replay PATH [-seek 
+// SECONDS]' to seek a recording to the given time, reporting how long the seek took and the 
+// game there, then replay it to the end, which should match the recorded session. Run with 
+// '-check PATH' to replay a recording from the start against its hash stream, reporting the 
+// first tick whose state differs and the sections of the state which differ.
+//
+
+static int recordSession(const std::string& path, int64_t maxTicks, int32_t keyframeSeconds, bool isHashing)
 {
+  pxr::Context context {std::make_shared<pxr::Log>(), std::make_shared<pxr::Assets>(), 0};
+
+  SessionRecorder recorder {path, keyframeSeconds, isHashing};
+  if(!recorder.isGood()){
+    std::cerr << "cannot create recording: " << path << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  pxr::xorwow gameRoot {1}, botRoot {2};
+  SimResult result = runSimulation({gameRoot.split(), botRoot.split()}, maxTicks, &recorder);
+  if(!recorder.finish()){
+    std::cerr << "failed to write recording: " << path << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::cout << "recorded ticks:" << recorder.getTickCount()
+            << " keyframes:" << recorder.getKeyframeCount()
+            << " bytes:" << std::filesystem::file_size(path)
+            << " score:" << result._score
+            << " round:" << result._round
+            << std::endl;
+
+  return EXIT_SUCCESS;
+}
+
+static void printReplayState(const char* label, SessionReplay& replay)
+{
+  std::cout << label << " tick:" << replay.getTick()
+            << " score:" << replay.getApp().getScore()
+            << " lives:" << replay.getApp().getLives()
+            << " round:" << replay.getApp().getRound();
+}
+
+static int replaySession(const std::string& path, double seekSeconds)
+{
+  pxr::Context context {std::make_shared<pxr::Log>(), std::make_shared<pxr::Assets>(), 0};
+
+  SessionReplay replay {path};
+  if(!replay.isGood()){
+    std::cerr << "cannot read recording: " << path << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  int64_t seekTick = std::llround(seekSeconds * SessionRecording::ticksPerSecond);
+  seekTick = std::clamp<int64_t>(seekTick, 0, replay.getTickCount());
+
+  auto start = std::chrono::steady_clock::now();
+  bool isSought = replay.seek(seekTick);
+  std::chrono::duration<double, std::milli> milliseconds = std::chrono::steady_clock::now() - start;
+  if(!isSought){
+    std::cerr << "failed to seek recording: " << path << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  printReplayState("seek", replay);
+  std::cout << " keyframe tick:" << replay.getKeyframeTick()
+            << " ms:" << milliseconds.count()
+            << std::endl;
+
+  while(replay.step());
+  if(!replay.isGood()){
+    std::cerr << "failed to replay recording: " << path << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  printReplayState("end", replay);
+  std::cout << std::endl;
+
+  return EXIT_SUCCESS;
+}
+
+static int checkSession(const std::string& path)
+{
+  pxr::Context context {std::make_shared<pxr::Log>(), std::make_shared<pxr::Assets>(), 0};
+
+  SessionReplay replay {path};
+  SessionHashes expected {SessionRecording::getHashesPath(path)};
+  if(!replay.isGood() || !expected.isGood()){
+    std::cerr << "cannot read recording or its hashes: " << path << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  if(expected.getTickCount() != replay.getTickCount()){
+    std::cerr << "recording has " << replay.getTickCount() << " ticks but its hashes have "
+              << expected.getTickCount() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+
+  SessionRecording::SectionHashes actual {};
+  for(int64_t tick = 0; tick < replay.getTickCount(); ++tick){
+    if(!replay.step()){
+      std::cerr << "failed to replay recording: " << path << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    SessionRecording::hashSession(replay.getApp(), actual);
+    const SessionRecording::SectionHashes& hashes = expected.getHashes(tick);
+    if(actual == hashes)
+      continue;
+
+    std::cout << "diverged tick:" << tick 
+              << " seconds:" << (static_cast<double>(tick) / SessionRecording::ticksPerSecond)
+              << " state:" << replay.getApp().getActiveStateName()
+              << std::endl;
+    for(int32_t section = 0; section < SessionRecording::hashSectionCount; ++section){
+      if(actual[section] == hashes[section])
+        continue;
+      std::cout << "  " << std::left << std::setw(10) 
+                << GameState::getSnapshotSectionName(static_cast<GameState::SnapshotSection>(section))
+                << std::hex << " expected:" << hashes[section] << " actual:" << actual[section] 
+                << std::dec << std::endl;
+    }
+    return EXIT_FAILURE;
+  }
+
+  std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+  std::cout << "matched ticks:" << replay.getTickCount() << " seconds:" << seconds.count() << std::endl;
+
+  return EXIT_SUCCESS;
+}
+
+//
+// Random number generation benchmark. Run with '-bench-rng [N]' to time drawing N values (in
+// millions, default 256) by each method; the scalar generator is the baseline.
+//
+
+static constexpr size_t benchBufferSize {1 << 16};
+
+template<typename Fill>
+static void benchRngMethod(const char* name, int64_t valueCount, Fill fill)
+{
+  std::vector<uint32_t> buffer(benchBufferSize);
+  uint32_t checksum {0};   // consumes the values so the work cannot be optimised away.
+
+  auto start = std::chrono::steady_clock::now();
+  for(int64_t done = 0; done < valueCount; done += benchBufferSize){
+    fill(std::span<uint32_t>{buffer});
+    checksum ^= buffer.back();
+  }
+  std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+
+  std::cout << std::left << std::setw(32) << name
+            << " Mvalues/s:" << std::setw(10) << static_cast<int64_t>(valueCount / seconds.count() / 1e6)
+            << " checksum:" << checksum
+            << std::endl;
+}
+
+static int benchRng(int64_t valueCount)
+{
+  pxr::xorwow scalar {1};
+  benchRngMethod("xorwow::operator()", valueCount, [&](std::span<uint32_t> out){
+    for(auto& value : out)
+      value = scalar();
+  });
+
+  benchRngMethod("xorwow::fill", valueCount, [&](std::span<uint32_t> out){
+    scalar.fill(out);
+  });
+
+  pxr::randGenerator.seed(1);
+  benchRngMethod("randUniformUnsignedInt [0, 99]", valueCount, [&](std::span<uint32_t> out){
+    for(auto& value : out)
+      value = pxr::randUniformUnsignedInt(0, 99);
+  });
+
+  pxr::xorwowx8 lanes {pxr::xorwow{1}};
+  benchRngMethod("xorwowx8::fill", valueCount, [&](std::span<uint32_t> out){
+    lanes.fill(out);
+  });
+
+  benchRngMethod("xorwowx8::fillBounded [0, 99]", valueCount, [&](std::span<uint32_t> out){
+    lanes.fillBounded(out, 100);
+  });
+
+  std::vector<float> floats(benchBufferSize);
+  benchRngMethod("xorwowx8::fillFloat [0, 1)", valueCount, [&](std::span<uint32_t> out){
+    lanes.fillFloat(floats, 0.f, 1.f);
+    out.back() = std::bit_cast<uint32_t>(floats.back());
+  });
+
+  return EXIT_SUCCESS;
+}
+
+int main(int argc, char* argv[])
+{
+  int32_t simCount {0};
+  int64_t maxTicks {60 * 60 * 10};
+  int32_t threadCount = std::max(1u, std::thread::hardware_concurrency());
+  int64_t benchRngValues {0};
+  std::string recordPath {};
+  std::string replayPath {};
+  std::string checkPath {};
+  bool isHashing {false};
+  int32_t keyframeSeconds {SessionRecording::defaultKeyframeSeconds};
+  double seekSeconds {0.0};
+
+  for(int i = 1; i < argc; ++i){
+    std::string_view arg {argv[i]};
+    if(arg == "-sims" && i + 1 < argc)
+      simCount = std::atoi(argv[++i]);
+    else if(arg == "-ticks" && i + 1 < argc)
+      maxTicks = std::atoll(argv[++i]);
+    else if(arg == "-threads" && i + 1 < argc)
+      threadCount = std::atoi(argv[++i]);
+    else if(arg == "-bench-rng"){
+      benchRngValues = 256;
+      if(i + 1 < argc && std::isdigit(static_cast<unsigned char>(argv[i + 1][0])))
+        benchRngValues = std::atoll(argv[++i]);
+    }
+    else if(arg == "-record" && i + 1 < argc)
+      recordPath = argv[++i];
+    else if(arg == "-keyframe-seconds" && i + 1 < argc)
+      keyframeSeconds = std::max(1, std::atoi(argv[++i]));
+    else if(arg == "-replay" && i + 1 < argc)
+      replayPath = argv[++i];
+    else if(arg == "-seek" && i + 1 < argc)
+      seekSeconds = std::atof(argv[++i]);
+    else if(arg == "-hashes")
+      isHashing = true;
+    else if(arg == "-check" && i + 1 < argc)
+      checkPath = argv[++i];
+    else{
+      std::cerr << "usage: " << argv[0] << " [-sims N [-ticks T] [-threads K]] [-bench-rng [N]]"
+                << " [-record PATH [-ticks T] [-keyframe-seconds S] [-hashes]] [-replay PATH [-seek SECONDS]]"
+                << " [-check PATH]" << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  if(benchRngValues > 0)
+    return benchRng(benchRngValues * 1000000);
+
+  if(!recordPath.empty())
+    return recordSession(recordPath, maxTicks, keyframeSeconds, isHashing);
+
+  if(!replayPath.empty())
+    return replaySession(replayPath, seekSeconds);
+
+  if(!checkPath.empty())
+    return checkSession(checkPath);
+
+  if(simCount > 0)
+    return runSimulations(simCount, maxTicks, std::clamp(threadCount, 1, simCount));
+
   engine = new pxr::Engine{};
   engine->initialize(std::move(std::unique_ptr<pxr::Application>{new SpaceInvaders{}}));
   engine->run();
@@ -1,8 +1,291 @@
 #include "pixiretro.h"
 
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <cerrno>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 namespace pxr
 {
 
+//===============================================================================================//
+// ##>UTILITY                                                                                    //
+//===============================================================================================//
+
+static constexpr uint64_t xxPrime1 {0x9e3779b185ebca87};
+static constexpr uint64_t xxPrime2 {0xc2b2ae3d27d4eb4f};
+static constexpr uint64_t xxPrime3 {0x165667b19e3779f9};
+static constexpr uint64_t xxPrime4 {0x85ebca77c2b2ae63};
+static constexpr uint64_t xxPrime5 {0x27d4eb2f165667c5};
+
+static uint64_t xxRound(uint64_t acc, uint64_t input)
+{
+  return std::rotl(acc + (input * xxPrime2), 31) * xxPrime1;
+}
+
+static uint64_t xxMerge(uint64_t hash, uint64_t acc)
+{
+  return ((hash ^ xxRound(0, acc)) * xxPrime1) + xxPrime4;
+}
+
+uint64_t hashState(const void* data, size_t size, uint64_t seed)
+{
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  const uint8_t* end = bytes + size;
+  auto read64 = [](const uint8_t* p){uint64_t v; std::memcpy(&v, p, sizeof(v)); return v;};
+  auto read32 = [](const uint8_t* p){uint32_t v; std::memcpy(&v, p, sizeof(v)); return v;};
+
+  uint64_t hash {0};
+  if(size >= 32){
+    // Four independent lanes over 32 byte stripes.
+    uint64_t v1 = seed + xxPrime1 + xxPrime2;
+    uint64_t v2 = seed + xxPrime2;
+    uint64_t v3 = seed;
+    uint64_t v4 = seed - xxPrime1;
+    for(; end - bytes >= 32; bytes += 32){
+      v1 = xxRound(v1, read64(bytes));
+      v2 = xxRound(v2, read64(bytes + 8));
+      v3 = xxRound(v3, read64(bytes + 16));
+      v4 = xxRound(v4, read64(bytes + 24));
+    }
+    hash = std::rotl(v1, 1) + std::rotl(v2, 7) + std::rotl(v3, 12) + std::rotl(v4, 18);
+    hash = xxMerge(xxMerge(xxMerge(xxMerge(hash, v1), v2), v3), v4);
+  }
+  else
+    hash = seed + xxPrime5;
+
+  hash += size;
+
+  for(; end - bytes >= 8; bytes += 8)
+    hash = (std::rotl(hash ^ xxRound(0, read64(bytes)), 27) * xxPrime1) + xxPrime4;
+  if(end - bytes >= 4){
+    hash = (std::rotl(hash ^ (read32(bytes) * xxPrime1), 23) * xxPrime2) + xxPrime3;
+    bytes += 4;
+  }
+  for(; bytes < end; ++bytes)
+    hash = std::rotl(hash ^ (*bytes * xxPrime5), 11) * xxPrime1;
+
+  hash ^= hash >> 33;
+  hash *= xxPrime2;
+  hash ^= hash >> 29;
+  hash *= xxPrime3;
+  hash ^= hash >> 32;
+  return hash;
+}
+
+static constexpr int32_t maxLiteralCount {128};
+static constexpr int32_t minRunLength {3};
+static constexpr int32_t maxRunLength {130};
+static_assert(maxRunExpansion * 2 == maxRunLength);
+
+void compressRuns(std::span<const uint8_t> bytes, ByteWriter& writer)
+{
+  size_t size = bytes.size();
+  size_t literalBegin {0};
+  size_t i {0};
+
+  auto flushLiterals = [&](size_t end){
+    while(literalBegin < end){
+      size_t count = std::min(end - literalBegin, static_cast<size_t>(maxLiteralCount));
+      writer.write(static_cast<uint8_t>(count - 1));
+      writer.writeBytes(bytes.data() + literalBegin, count);
+      literalBegin += count;
+    }
+  };
+
+  while(i < size){
+    size_t run {1};
+    while(i + run < size && bytes[i + run] == bytes[i] && run < maxRunLength)
+      ++run;
+
+    if(run < minRunLength){
+      i += run;
+      continue;
+    }
+
+    flushLiterals(i);
+    writer.write(static_cast<uint8_t>(run + 125));
+    writer.write(bytes[i]);
+    i += run;
+    literalBegin = i;
+  }
+  flushLiterals(size);
+}
+
+bool decompressRuns(std::span<const uint8_t> compressed, std::span<uint8_t> bytes)
+{
+  size_t in {0}, out {0};
+  while(in < compressed.size()){
+    uint8_t header = compressed[in++];
+    if(header < maxLiteralCount){
+      size_t count = header + 1;
+      if(count > compressed.size() - in || count > bytes.size() - out)
+        return false;
+      std::memcpy(bytes.data() + out, compressed.data() + in, count);
+      in += count;
+      out += count;
+    }
+    else{
+      size_t count = header - 125;
+      if(in == compressed.size() || count > bytes.size() - out)
+        return false;
+      std::memset(bytes.data() + out, compressed[in++], count);
+      out += count;
+    }
+  }
+  return out == bytes.size();
+}
+
+Scheduler::Scheduler(int32_t workerCount) :
+  _remaining{0},
+  _runGeneration{0},
+  _isStopping{false}
+{
+  assert(workerCount >= 0);
+  for(int32_t i = 0; i <= workerCount; ++i)
+    _queues.push_back(std::make_unique<WorkQueue>());
+  for(int32_t i = 1; i <= workerCount; ++i)
+    _workers.emplace_back(&Scheduler::workerLoop, this, i);
+}
+
+Scheduler::~Scheduler()
+{
+  {
+    std::lock_guard<std::mutex> lock {_runMutex};
+    _isStopping = true;
+  }
+  _runCondition.notify_all();
+  for(auto& worker : _workers)
+    worker.join();
+}
+
+void Scheduler::addSystem(Resources_t reads, Resources_t writes, System_t system)
+{
+  // Systems using the context must keep their order, as if they all write it.
+  if((reads | writes) & resourceContext)
+    writes |= resourceContext;
+
+  int32_t index = static_cast<int32_t>(_systems.size());
+  int32_t dependencyCount {0};
+  for(int32_t i = 0; i < index; ++i){
+    System& earlier = _systems[i];
+    if((writes & (earlier._reads | earlier._writes)) || (earlier._writes & reads)){
+      earlier._dependents.push_back(index);
+      ++dependencyCount;
+    }
+  }
+  _systems.push_back({reads, writes, std::move(system), {}, dependencyCount});
+  _pendingCounts = std::make_unique<std::atomic<int32_t>[]>(_systems.size());
+}
+
+void Scheduler::run()
+{
+  if(_workers.empty()){
+    for(auto& system : _systems)
+      system._function();
+    return;
+  }
+
+  int32_t systemCount = static_cast<int32_t>(_systems.size());
+  if(systemCount == 0)
+    return;
+
+  for(int32_t i = 0; i < systemCount; ++i)
+    _pendingCounts[i].store(_systems[i]._dependencyCount, std::memory_order_relaxed);
+  _remaining.store(systemCount, std::memory_order_release);
+
+  for(int32_t i = 0; i < systemCount; ++i)
+    if(_systems[i]._dependencyCount == 0)
+      pushSystem(i, 0);
+
+  {
+    std::lock_guard<std::mutex> lock {_runMutex};
+    ++_runGeneration;
+  }
+  _runCondition.notify_all();
+
+  while(_remaining.load(std::memory_order_acquire) > 0)
+    if(!tryRunSystem(0, true))
+      std::this_thread::yield();
+}
+
+int32_t Scheduler::takeSystem(WorkQueue& queue, bool isFromBack)
+{
+  std::lock_guard<std::mutex> lock {queue._mutex};
+  if(queue._systems.empty())
+    return -1;
+  int32_t system {};
+  if(isFromBack){
+    system = queue._systems.back();
+    queue._systems.pop_back();
+  }
+  else{
+    system = queue._systems.front();
+    queue._systems.pop_front();
+  }
+  return system;
+}
+
+bool Scheduler::tryRunSystem(int32_t queue, bool isCaller)
+{
+  // Own work is taken newest first, as its data is likely still in cache, and stolen work
+  // oldest first.
+  int32_t system {-1};
+  if(isCaller)
+    system = takeSystem(_contextQueue, false);
+  if(system < 0)
+    system = takeSystem(*_queues[queue], true);
+  int32_t queueCount = static_cast<int32_t>(_queues.size());
+  for(int32_t i = 1; system < 0 && i < queueCount; ++i)
+    system = takeSystem(*_queues[(queue + i) % queueCount], false);
+  if(system < 0)
+    return false;
+
+  _systems[system]._function();
+  finishSystem(system, queue);
+  return true;
+}
+
+void Scheduler::finishSystem(int32_t system, int32_t queue)
+{
+  for(int32_t dependent : _systems[system]._dependents)
+    if(_pendingCounts[dependent].fetch_sub(1, std::memory_order_acq_rel) == 1)
+      pushSystem(dependent, queue);
+  _remaining.fetch_sub(1, std::memory_order_acq_rel);
+}
+
+void Scheduler::pushSystem(int32_t system, int32_t queue)
+{
+  WorkQueue& target = (_systems[system]._writes & resourceContext) ? _contextQueue : *_queues[queue];
+  std::lock_guard<std::mutex> lock {target._mutex};
+  target._systems.push_back(system);
+}
+
+void Scheduler::workerLoop(int32_t queue)
+{
+  uint64_t seenGeneration {0};
+  while(true){
+    {
+      std::unique_lock<std::mutex> lock {_runMutex};
+      _runCondition.wait(lock, [&]{return _isStopping || _runGeneration != seenGeneration;});
+      if(_isStopping)
+        return;
+      seenGeneration = _runGeneration;
+    }
+    while(_remaining.load(std::memory_order_acquire) > 0)
+      if(!tryRunSystem(queue, false))
+        std::this_thread::yield();
+  }
+}
+
 //===============================================================================================//
 // ##>RANDOM NUMBER GENERATION                                                                   //
 //===============================================================================================//
@@ -47,26 +330,25 @@ void xorwow::seed(std::seed_seq& seq)
   //*_state.end() = 0; why did I do this!? This has to be a bug!
 }
 
-//
-// sequence generator from: https://en.wikipedia.org/wiki/Xorshift
-//
-xorwow::result_type xorwow::operator()()
+void xorwow::fill(std::span<result_type> out)
 {
-  //
-  // Algorithm "xorwow" from p. 5 of Marsaglia, "Xorshift RNGs"
-  //
-  result_type t = _state[4];
-  result_type s = _state[0];
-  _state[4] = _state[3];
-  _state[3] = _state[2];
-  _state[2] = _state[1];
-  _state[1] = s;
-  t ^= t >> 2;
-  t ^= t << 1;
-  t ^= s ^ (s << 4);
-  _state[0] = t;
-  _state[5] += 362437;
-  return t + _state[5];
+  // Steps a local copy of the state so the compiler can keep it in registers.
+  state_type state {_state};
+  for(auto& value : out){
+    result_type t = state[4];
+    result_type s = state[0];
+    state[4] = state[3];
+    state[3] = state[2];
+    state[2] = state[1];
+    state[1] = s;
+    t ^= t >> 2;
+    t ^= t << 1;
+    t ^= s ^ (s << 4);
+    state[0] = t;
+    state[5] += 362437;
+    value = t + state[5];
+  }
+  _state = state;
 }
 
 void xorwow::discard(unsigned long long z)
@@ -75,6 +357,68 @@ void xorwow::discard(unsigned long long z)
     (*this)();
 }
 
+//
+// The xorshift part of the generator, state words [0, 5), is linear over GF(2), so stepping it
+// is multiplying the 160-bit state by a 160x160 bit matrix M and stepping it 2^k times is 
+// multiplying by M^(2^k), found by squaring M k times. Matrices are stored as columns. The Weyl
+// counter, state word 5, advances by 362437 * 2^k, which is 0 mod 2^32 for k >= 32.
+//
+static constexpr int32_t xorshiftBits {160};
+static constexpr int32_t xorshiftWords {5};
+using XorshiftVector = std::array<uint32_t, xorshiftWords>;
+using XorshiftMatrix = std::array<XorshiftVector, xorshiftBits>;
+
+static XorshiftVector multiplyXorshift(const XorshiftMatrix& m, const XorshiftVector& v)
+{
+  XorshiftVector result {};
+  for(int32_t bit = 0; bit < xorshiftBits; ++bit){
+    if(!((v[bit / 32] >> (bit % 32)) & 1))
+      continue;
+    for(int32_t w = 0; w < xorshiftWords; ++w)
+      result[w] ^= m[bit][w];
+  }
+  return result;
+}
+
+static XorshiftMatrix makeJumpMatrix(int32_t log2Steps)
+{
+  // Column n of M is the step of the nth basis vector.
+  XorshiftMatrix m {};
+  for(int32_t bit = 0; bit < xorshiftBits; ++bit){
+    xorwow::state_type state {};
+    state[bit / 32] = uint32_t{1} << (bit % 32);
+    xorwow generator {};
+    generator.setState(state);
+    generator();
+    std::copy_n(generator.getState().begin(), xorshiftWords, m[bit].begin());
+  }
+
+  for(int32_t i = 0; i < log2Steps; ++i){
+    XorshiftMatrix squared {};
+    for(int32_t bit = 0; bit < xorshiftBits; ++bit)
+      squared[bit] = multiplyXorshift(m, m[bit]);
+    m = squared;
+  }
+  return m;
+}
+
+void xorwow::jump()
+{
+  static const XorshiftMatrix jumpMatrix = makeJumpMatrix(64);
+
+  XorshiftVector v {};
+  std::copy_n(_state.begin(), xorshiftWords, v.begin());
+  v = multiplyXorshift(jumpMatrix, v);
+  std::copy_n(v.begin(), xorshiftWords, _state.begin());
+}
+
+xorwow xorwow::split()
+{
+  xorwow stream {*this};
+  jump();
+  return stream;
+}
+
 constexpr xorwow::result_type xorwow::min()
 {
   return std::numeric_limits<result_type>::min();
@@ -100,37 +444,192 @@ bool operator!=(const xorwow& lhs, const xorwow& rhs)
   return !(lhs == rhs);
 }
 
-xorwow randGenerator;
+xorwowx8::xorwowx8(xorwow source) :
+  _blockNext {lane_count}
+{
+  for(int lane = 0; lane < lane_count; ++lane){
+    xorwow stream = source.split();
+    for(int w = 0; w < xorwow::state_size; ++w)
+      _state[w][lane] = stream.getState()[w];
+  }
+}
+
+xorwowx8::result_type xorwowx8::operator()()
+{
+  if(_blockNext == lane_count){
+    generate(_block.data(), 1);
+    _blockNext = 0;
+  }
+  return _block[_blockNext++];
+}
+
+void xorwowx8::fill(std::span<result_type> out)
+{
+  size_t i {0};
+  while(i < out.size() && _blockNext < lane_count)
+    out[i++] = _block[_blockNext++];
+
+  size_t blockCount = (out.size() - i) / lane_count;
+  generate(out.data() + i, blockCount);
+  i += blockCount * lane_count;
+
+  while(i < out.size())
+    out[i++] = (*this)();
+}
+
+void xorwowx8::fillBounded(std::span<result_type> out, result_type range)
+{
+  assert(range > 0);
+  result_type threshold = -range % range;
+
+  // Values are drawn in chunks and mapped by a branch free loop, which vectorises. Rejections
+  // are rare (probability under range / 2^32) so a chunk with any is remapped by a second loop,
+  // which redraws the rejected values from the stream in order, so results stay reproducible.
+  std::array<result_type, 256> bits;
+  for(size_t i = 0; i < out.size(); i += bits.size()){
+    size_t n = std::min(bits.size(), out.size() - i);
+    fill({bits.data(), n});
+
+    bool isRejection {false};
+    for(size_t j = 0; j < n; ++j){
+      uint64_t m = uint64_t{bits[j]} * range;
+      isRejection |= static_cast<result_type>(m) < threshold;
+      out[i + j] = static_cast<result_type>(m >> 32);
+    }
+    if(!isRejection)
+      continue;
+
+    for(size_t j = 0; j < n; ++j){
+      uint64_t m = uint64_t{bits[j]} * range;
+      while(static_cast<result_type>(m) < threshold)
+        m = uint64_t{(*this)()} * range;
+      out[i + j] = static_cast<result_type>(m >> 32);
+    }
+  }
+}
+
+void xorwowx8::fillFloat(std::span<float> out, float lo, float hi)
+{
+  std::array<result_type, 256> bits;
+  for(size_t i = 0; i < out.size(); i += bits.size()){
+    size_t n = std::min(bits.size(), out.size() - i);
+    fill({bits.data(), n});
+    for(size_t j = 0; j < n; ++j)
+      out[i + j] = lo + ((hi - lo) * ((bits[j] >> 8) * 0x1.0p-24f));
+  }
+}
 
 //
-// implementation note: creating a new distribution upon generating each number is actually not
-// much slower than using a single distribution but comes with a massive advantage. Distributions
-// cannot be copied or moved thus making them a pain to maintain within the objects that need 
-// them since it restricts the ability to copy and move such objects. It is thus far more
-// flexible to just call a function which requires the callee to maintain no internal state.
+// Each lane runs the step of xorwow::operator(), a lane per 32-bit element of the vectors. SSE2
+// vectors hold 4 lanes so the step is run on each half of the lanes.
 //
-// note: my tests (on a different but similar xorshift algorithm) showed generating 10^6 random 
-// ints, creating a new distribution each time, took around 3^4us on my machine, whereas using 
-// the same distribution took around 2.4^4, i.e. around 80% of the time. This is an acceptable 
-// difference for my needs.
+void xorwowx8::generate(result_type* out, size_t blockCount)
+{
+#if defined(__AVX2__)
+  __m256i x[xorwow::state_size];
+  for(int w = 0; w < xorwow::state_size; ++w)
+    x[w] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(_state[w].data()));
+
+  const __m256i weyl = _mm256_set1_epi32(362437);
+  for(size_t b = 0; b < blockCount; ++b){
+    __m256i t = x[4];
+    __m256i s = x[0];
+    x[4] = x[3];
+    x[3] = x[2];
+    x[2] = x[1];
+    x[1] = s;
+    t = _mm256_xor_si256(t, _mm256_srli_epi32(t, 2));
+    t = _mm256_xor_si256(t, _mm256_slli_epi32(t, 1));
+    t = _mm256_xor_si256(t, _mm256_xor_si256(s, _mm256_slli_epi32(s, 4)));
+    x[0] = t;
+    x[5] = _mm256_add_epi32(x[5], weyl);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + b * lane_count), _mm256_add_epi32(t, x[5]));
+  }
+
+  for(int w = 0; w < xorwow::state_size; ++w)
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(_state[w].data()), x[w]);
+
+#elif defined(__SSE2__)
+  constexpr int halfCount {lane_count / 4};
+  __m128i x[xorwow::state_size][halfCount];
+  for(int w = 0; w < xorwow::state_size; ++w)
+    for(int h = 0; h < halfCount; ++h)
+      x[w][h] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(_state[w].data() + h * 4));
+
+  const __m128i weyl = _mm_set1_epi32(362437);
+  for(size_t b = 0; b < blockCount; ++b){
+    for(int h = 0; h < halfCount; ++h){
+      __m128i t = x[4][h];
+      __m128i s = x[0][h];
+      x[4][h] = x[3][h];
+      x[3][h] = x[2][h];
+      x[2][h] = x[1][h];
+      x[1][h] = s;
+      t = _mm_xor_si128(t, _mm_srli_epi32(t, 2));
+      t = _mm_xor_si128(t, _mm_slli_epi32(t, 1));
+      t = _mm_xor_si128(t, _mm_xor_si128(s, _mm_slli_epi32(s, 4)));
+      x[0][h] = t;
+      x[5][h] = _mm_add_epi32(x[5][h], weyl);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(out + b * lane_count + h * 4), _mm_add_epi32(t, x[5][h]));
+    }
+  }
+
+  for(int w = 0; w < xorwow::state_size; ++w)
+    for(int h = 0; h < halfCount; ++h)
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(_state[w].data() + h * 4), x[w][h]);
+
+#else
+  for(size_t b = 0; b < blockCount; ++b){
+    for(int lane = 0; lane < lane_count; ++lane){
+      result_type t = _state[4][lane];
+      result_type s = _state[0][lane];
+      _state[4][lane] = _state[3][lane];
+      _state[3][lane] = _state[2][lane];
+      _state[2][lane] = _state[1][lane];
+      _state[1][lane] = s;
+      t ^= t >> 2;
+      t ^= t << 1;
+      t ^= s ^ (s << 4);
+      _state[0][lane] = t;
+      _state[5][lane] += 362437;
+      out[b * lane_count + lane] = t + _state[5][lane];
+    }
+  }
+#endif
+}
+
+thread_local xorwow randGenerator;
+
+//
+// implementation note: these functions keep no state of their own so can be called from 
+// anywhere. They sample the generator directly rather than via the std distributions, which 
+// are portable in interface only and, for bounded ints, cost a division (or more) per call; 
+// bounded ints here are usually a single multiply (see xorwow::bounded).
 //
 
 int randUniformSignedInt(int lo, int hi)
 {
-  std::uniform_int_distribution<int> d {lo, hi};
-  return d(randGenerator);
+  assert(lo <= hi);
+  uint32_t range = static_cast<uint32_t>(hi) - static_cast<uint32_t>(lo) + 1;
+  uint32_t offset = (range == 0) ? randGenerator() : randGenerator.bounded(range); // 0==full range.
+  return static_cast<int>(static_cast<uint32_t>(lo) + offset);
 }
 
 unsigned int randUniformUnsignedInt(unsigned int lo, unsigned int hi)
 {
-  std::uniform_int_distribution<unsigned int> d {lo, hi};
-  return d(randGenerator);
+  assert(lo <= hi);
+  uint32_t range = hi - lo + 1;
+  return lo + ((range == 0) ? randGenerator() : randGenerator.bounded(range));
 }
 
 double randUniformReal(double lo, double hi)
 {
-  std::uniform_real_distribution<double> d {lo, hi};
-  return d(randGenerator);
+  return lo + ((hi - lo) * randGenerator.nextDouble());
+}
+
+float randUniformFloat(float lo, float hi)
+{
+  return lo + ((hi - lo) * randGenerator.nextFloat());
 }
 
 //===============================================================================================//
@@ -154,6 +653,7 @@ Log::~Log()
 
 void Log::log(Level level, const char* error, const std::string& addendum)
 {
+  std::lock_guard<std::mutex> lock {_mutex};
   std::ostream& o {_os ? _os : std::cerr}; 
   o << lvlstr[level] << delim << error;
   if(!addendum.empty())
@@ -161,7 +661,98 @@ void Log::log(Level level, const char* error, const std::string& addendum)
   o << std::endl;
 }
 
-std::unique_ptr<Log> log {nullptr};
+thread_local std::shared_ptr<Log> log {nullptr};
+
+//===============================================================================================//
+// ##>STARTUP REPORT                                                                             //
+//===============================================================================================//
+
+StartupReport::StartupReport() :
+  _start{Clock_t::now()},
+  _phases{},
+  _openPhases{}
+{}
+
+void StartupReport::beginPhase(const std::string& name)
+{
+  std::string fullname {};
+  if(!_openPhases.empty()){
+    fullname += _phases[_openPhases.back()]._name;
+    fullname += phaseSeperator;
+  }
+  fullname += name;
+
+  _openPhases.push_back(_phases.size());
+  _phases.push_back({std::move(fullname), Clock_t::now(), 0.0, 0, 0});
+}
+
+void StartupReport::endPhase()
+{
+  assert(!_openPhases.empty());
+  Phase& phase = _phases[_openPhases.back()];
+  phase._wall_ms = toMilliseconds(Clock_t::now() - phase._start);
+  _openPhases.pop_back();
+
+  std::stringstream ss {};
+  ss << phase._name << " " << std::fixed << std::setprecision(3) << phase._wall_ms << "ms";
+  log->log(Log::INFO, logstr::info_startup_phase, ss.str());
+}
+
+void StartupReport::recordFile(const std::string& path)
+{
+  std::error_code ec {};
+  auto size = std::filesystem::file_size(path, ec);
+  int64_t bytes = ec ? 0 : static_cast<int64_t>(size);
+  for(size_t i : _openPhases){
+    _phases[i]._bytesRead += bytes;
+    ++(_phases[i]._filesOpened);
+  }
+}
+
+void StartupReport::recordFirstShow()
+{
+  while(!_openPhases.empty())
+    endPhase();
+
+  int64_t bytesRead {0};
+  int32_t filesOpened {0};
+  for(const auto& phase : _phases){
+    if(phase._name.find(phaseSeperator) != std::string::npos)
+      continue;
+    bytesRead += phase._bytesRead;
+    filesOpened += phase._filesOpened;
+  }
+  _phases.push_back({"first show", _start, toMilliseconds(Clock_t::now() - _start), bytesRead, filesOpened});
+
+  write();
+}
+
+double StartupReport::toMilliseconds(Clock_t::duration d)
+{
+  return std::chrono::duration<double, std::milli>(d).count();
+}
+
+void StartupReport::write()
+{
+  std::ofstream file {filename, std::ios_base::out | std::ios_base::trunc};
+  if(!file)
+    log->log(Log::WARN, logstr::warn_cannot_create_dataset, filename);
+  else
+    file << csvHeader << '\n';
+
+  for(const auto& phase : _phases){
+    std::stringstream ss {};
+    ss << phase._name << ',' 
+       << std::fixed << std::setprecision(3) << phase._wall_ms << ','
+       << phase._bytesRead << ','
+       << phase._filesOpened;
+    log->log(Log::INFO, logstr::info_startup_report, ss.str());
+    if(file)
+      file << ss.str() << '\n';
+  }
+}
+
+thread_local std::unique_ptr<StartupReport> startup {nullptr};
 
 //===============================================================================================//
 // ##>INPUT                                                                                      //
@@ -194,6 +785,20 @@ void Input::onKeyEvent(const SDL_Event& event)
   }
 }
 
+void Input::setKeyState(KeyCode key, bool isDown)
+{
+  assert(0 <= key && key < KEY_COUNT);
+
+  if(isDown && !_keys[key]._isDown){
+    _keys[key]._isPressed = true;
+    _history.push_back(key);
+  }
+  else if(!isDown && _keys[key]._isDown)
+    _keys[key]._isReleased = true;
+
+  _keys[key]._isDown = isDown;
+}
+
 void Input::onUpdate()
 {
   for(auto& key : _keys)
@@ -275,7 +880,7 @@ int32_t Input::keyToAsciiCode(KeyCode key) const
   }
 }
 
-std::unique_ptr<Input> input {nullptr};
+thread_local std::unique_ptr<Input> input {nullptr};
 
 //===============================================================================================//
 // ##>RESOURCES                                                                                  //
@@ -306,6 +911,8 @@ int32_t Dataset::load(const std::string& filename)
     return -1;
   }
 
+  if(startup) startup->recordFile(filename);
+
   auto lineNoToString = [](int32_t l){return std::string{" ["} + std::to_string(l) + "] ";};
   auto isSpace = [](char c){return std::isspace<char>(c, std::locale::classic());};
 
@@ -459,6 +1066,8 @@ int32_t Dataset::write(const std::string& filename, bool genComments)
     ss << '\n';
     file << ss.str();
   }
+
+  return 0;
 }
 
 int32_t Dataset::getIntValue(int32_t key) const
@@ -594,42 +1203,63 @@ void Dataset::printValue(const Value_t& value, std::ostream& os)
   }
 }
 
+void Assets::seal()
+{
+  for(auto& bitmap : _bitmaps)
+    if(bitmap != nullptr)
+      bitmap->regenerateBytes();
+  _isSealed = true;
+}
+
 void Assets::loadBitmaps(const Manifest_t& manifest)
 {
+  if(_isSealed){
+    for([[maybe_unused]] const auto& tuple : manifest)
+      assert(isLoaded(_bitmaps, std::get<0>(tuple), std::get<2>(tuple)));
+    return;
+  }
+
+  uint64_t sourceHash {0};
+  std::string sharedName {};
+  if(_isSharedCacheOn){
+    sourceHash = hashSources(sharedBitmapsTag, manifest);
+    sharedName = makeSharedName(sharedBitmapsTag, sourceHash);
+    auto unpacker = [this](ByteReader& reader){return unpackBitmaps(reader);};
+    if(readShared(sharedName, sourceHash, unpacker))
+      return;
+  }
+
   for(const auto& tuple : manifest){
     Key_t key = std::get<0>(tuple);
     Name_t name = std::get<1>(tuple);
     Scale_t scale = std::get<2>(tuple);
 
+    assert(0 <= key);
     assert(scale < maxScale);
 
-    auto search = _bitmaps.find(key);
-    if(search == _bitmaps.end()){
-      auto pair = _bitmaps.insert(std::make_pair(key, std::array<std::unique_ptr<Bitmap>, maxScale>{}));
-      assert(pair.second);
-      search = pair.first;
-    }
+    size_t index = tableIndex(key, scale);
+    if(index >= _bitmaps.size())
+      _bitmaps.resize(tableIndex(key + 1, 0));
 
-    if((search->second)[scale] != nullptr){
+    if(_bitmaps[index] != nullptr){
       std::string addendum = std::string{name} + std::string{" : scale:"} + std::to_string(scale); 
       log->log(Log::WARN, logstr::warn_bitmap_already_loaded, std::move(addendum));
       log->log(Log::INFO, logstr::info_skipping_asset_loading);
       continue;
     }
 
-    (search->second)[scale] = std::move(std::make_unique<Bitmap>(loadBitmap(bitmaps_path, name, scale)));
+    _bitmaps[index] = std::make_unique<Bitmap>(loadBitmap(bitmaps_path, name, scale));
   }
+
+  if(_isSharedCacheOn)
+    writeShared(sharedName, sourceHash, packBitmaps(manifest));
 }
 
 Bitmap Assets::loadBitmap(std::string path, std::string name, Scale_t scale)
 {
   assert(scale < maxScale);
 
-  std::string bitpath {};
-  bitpath += path;
-  bitpath += path_seperator;
-  bitpath += name;
-  bitpath += bitmaps_extension;
+  std::string bitpath {makeBitmapPath(path, name)};
 
   log->log(Log::INFO, logstr::info_loading_asset, bitpath);
 
@@ -640,6 +1270,8 @@ Bitmap Assets::loadBitmap(std::string path, std::string name, Scale_t scale)
     return generateErrorBitmap(scale);
   }
 
+  if(startup) startup->recordFile(bitpath);
+
   auto isSpace = [](char c){return std::isspace<char>(c, std::locale::classic());};
 
   std::vector<std::string> rows {};
@@ -695,41 +1327,55 @@ Bitmap Assets::generateErrorBitmap(Scale_t scale)
 
 void Assets::loadFonts(const Manifest_t& manifest)
 {
+  if(_isSealed){
+    for([[maybe_unused]] const auto& tuple : manifest)
+      assert(isLoaded(_fonts, std::get<0>(tuple), std::get<2>(tuple)));
+    return;
+  }
+
+  uint64_t sourceHash {0};
+  std::string sharedName {};
+  if(_isSharedCacheOn){
+    sourceHash = hashSources(sharedFontsTag, manifest);
+    sharedName = makeSharedName(sharedFontsTag, sourceHash);
+    auto unpacker = [this](ByteReader& reader){return unpackFonts(reader);};
+    if(readShared(sharedName, sourceHash, unpacker))
+      return;
+  }
+
   for(const auto& tuple : manifest){
     Key_t key = std::get<0>(tuple);
     Name_t name = std::get<1>(tuple);
     Scale_t scale = std::get<2>(tuple);
 
+    assert(0 <= key);
     assert(scale < maxScale);
 
-    auto search = _fonts.find(key);
-    if(search == _fonts.end()){
-      auto pair = _fonts.insert(std::make_pair(key, std::array<std::unique_ptr<Font>, maxScale>{}));
-      assert(pair.second);
-      search = pair.first;
-    }
+    size_t index = tableIndex(key, scale);
+    if(index >= _fonts.size())
+      _fonts.resize(tableIndex(key + 1, 0));
 
-    if((search->second)[scale] != nullptr){
+    if(_fonts[index] != nullptr){
       std::string addendum = std::string{name} + std::string{" : scale:"} + std::to_string(scale); 
       log->log(Log::WARN, logstr::warn_font_already_loaded, std::move(addendum));
       log->log(Log::INFO, logstr::info_skipping_asset_loading);
       continue;
     }
 
-    (search->second)[scale] = std::move(std::make_unique<Font>(loadFont(name, scale)));
+    _fonts[index] = std::make_unique<Font>(loadFont(name, scale));
   }
+
+  if(_isSharedCacheOn)
+    writeShared(sharedName, sourceHash, packFonts(manifest));
 }
 
 Font Assets::loadFont(std::string name, Scale_t scale)
 {
   Font::Meta meta;
   std::vector<Glyph> glyphs {};
+  std::vector<Bitmap> bitmaps {};
 
-  std::string basepath {};
-  basepath += fonts_path;
-  basepath += path_seperator;
-  basepath += name;
-  basepath += path_seperator;
+  std::string basepath {makeFontBasePath(name)};
 
   std::string fontpath {basepath};
   fontpath += name;
@@ -768,6 +1414,7 @@ Font Assets::loadFont(std::string name, Scale_t scale)
       log->log(Log::INFO, logstr::info_using_error_glyph);
       log->log(Log::INFO, logstr::info_ascii_code, std::to_string(ascii));
       glyphs.emplace_back(generateErrorGlyph(ascii, scale));
+      bitmaps.emplace_back(generateErrorBitmap(scale));
       continue;
     }
 
@@ -780,13 +1427,12 @@ Font Assets::loadFont(std::string name, Scale_t scale)
     glyph._width = glyphdata.getIntValue(GlyphData::KEY_WIDTH) * scale;
     glyph._height = glyphdata.getIntValue(GlyphData::KEY_HEIGHT) * scale;
 
-    glyph._bitmap = loadBitmap(basepath, glyphFilenames[i], scale);
-
-    glyphs.emplace_back(std::move(glyph));
+    glyphs.emplace_back(glyph);
+    bitmaps.emplace_back(loadBitmap(basepath, glyphFilenames[i], scale));
   }
 
   Font font;
-  font.initialize(meta, std::move(glyphs));
+  font.initialize(meta, glyphs, bitmaps);
 
   return font;
 }
@@ -795,6 +1441,7 @@ Font Assets::generateErrorFont(Scale_t scale)
 {
   Font::Meta meta;
   std::vector<Glyph> glyphs {};
+  std::vector<Bitmap> bitmaps {};
 
   FontData fontdata {};
   fontdata.applyDefaults();
@@ -807,10 +1454,11 @@ Font Assets::generateErrorFont(Scale_t scale)
   for(int i = 0; i < asciiCharCount; ++i){
     int32_t ascii = static_cast<int32_t>('!') + i;
     glyphs.emplace_back(generateErrorGlyph(ascii, scale));
+    bitmaps.emplace_back(generateErrorBitmap(scale));
   }
 
   Font font {};
-  font.initialize(meta, std::move(glyphs));
+  font.initialize(meta, glyphs, bitmaps);
   return font;
 }
 
@@ -828,23 +1476,295 @@ Glyph Assets::generateErrorGlyph(int32_t asciiCode, Scale_t scale)
   glyph._width = glyphdata.getIntValue(GlyphData::KEY_WIDTH) * scale;
   glyph._height = glyphdata.getIntValue(GlyphData::KEY_HEIGHT) * scale;
 
-  std::vector<std::string> bits {};
-  for(auto row : errorBits)
-    bits.push_back(row);
+  return glyph;
+}
+
+std::string Assets::makeBitmapPath(const std::string& path, const std::string& name) const
+{
+  std::string bitpath {};
+  bitpath += path;
+  bitpath += path_seperator;
+  bitpath += name;
+  bitpath += bitmaps_extension;
+  return bitpath;
+}
+
+std::string Assets::makeFontBasePath(const std::string& name) const
+{
+  std::string basepath {};
+  basepath += fonts_path;
+  basepath += path_seperator;
+  basepath += name;
+  basepath += path_seperator;
+  return basepath;
+}
+
+uint64_t Assets::hashSources(char tag, const Manifest_t& manifest) const
+{
+  uint64_t hash = hashBytes(&sharedVersion, sizeof(sharedVersion));
+  hash = hashBytes(&tag, sizeof(tag), hash);
+
+  auto hashFile = [&hash](const std::string& path){
+    hash = hashBytes(path.data(), path.size(), hash);
+    std::error_code ec {};
+    uint64_t size = std::filesystem::file_size(path, ec);
+    if(ec) size = 0;
+    int64_t mtime = std::filesystem::last_write_time(path, ec).time_since_epoch().count();
+    if(ec) mtime = 0;
+    hash = hashBytes(&size, sizeof(size), hash);
+    hash = hashBytes(&mtime, sizeof(mtime), hash);
+  };
+
+  for(const auto& tuple : manifest){
+    Key_t key = std::get<0>(tuple);
+    Name_t name = std::get<1>(tuple);
+    Scale_t scale = std::get<2>(tuple);
+    hash = hashBytes(&key, sizeof(key), hash);
+    hash = hashBytes(&scale, sizeof(scale), hash);
+    if(tag == sharedBitmapsTag){
+      hashFile(makeBitmapPath(bitmaps_path, name));
+    }
+    else{
+      std::string basepath {makeFontBasePath(name)};
+      hashFile(basepath + name + fonts_extension);
+      for(const auto& glyphname : glyphFilenames){
+        hashFile(basepath + glyphname + glyphs_extension);
+        hashFile(makeBitmapPath(basepath, glyphname));
+      }
+    }
+  }
+  return hash;
+}
+
+std::string Assets::makeSharedName(char tag, uint64_t sourceHash) const
+{
+  std::stringstream ss {};
+  ss << sharedNamePrefix << tag << '_' << std::hex << sourceHash;
+  return ss.str();
+}
+
+//
+// A segment which is not ready was either abandoned by a builder which crashed or is still
+// being built. It is taken as abandoned if its builder no longer exists, or, as a backstop for
+// pid reuse and builders in other pid namespaces, if it has gone unfinished for the timeout.
+//
+static bool isSharedBuildAbandoned(const struct stat& st, int32_t builderPid, std::chrono::seconds timeout)
+{
+  if(builderPid > 0 && kill(builderPid, 0) == -1 && errno == ESRCH)
+    return true;
+  auto modified = std::chrono::system_clock::from_time_t(st.st_mtime);
+  return std::chrono::system_clock::now() - modified > timeout;
+}
+
+bool Assets::readShared(const std::string& name, uint64_t sourceHash, const Unpacker_t& unpacker)
+{
+  int fd = shm_open(name.c_str(), O_RDONLY, 0);
+  if(fd == -1)
+    return false;
+
+  struct stat st {};
+  if(fstat(fd, &st) == -1){
+    close(fd);
+    return false;
+  }
+
+  if(static_cast<size_t>(st.st_size) < sizeof(SharedHeader)){
+    close(fd);
+    // the segment is still being sized by another process, unless that process died first.
+    if(isSharedBuildAbandoned(st, 0, sharedBuildTimeout)){
+      log->log(Log::WARN, logstr::warn_abandoned_shared_assets, name);
+      shm_unlink(name.c_str());
+    }
+    return false;
+  }
+
+  size_t size = st.st_size;
+  void* segment = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if(segment == MAP_FAILED)
+    return false;
+
+  const SharedHeader* header = static_cast<const SharedHeader*>(segment);
+  const uint8_t* payload = static_cast<const uint8_t*>(segment) + sizeof(SharedHeader);
+  size_t payloadSize = size - sizeof(SharedHeader);
+
+  if(header->_isReady.load(std::memory_order_acquire) == 0){
+    bool isAbandoned = isSharedBuildAbandoned(st, header->_builderPid, sharedBuildTimeout);
+    munmap(segment, size);
+    if(isAbandoned){
+      log->log(Log::WARN, logstr::warn_abandoned_shared_assets, name);
+      shm_unlink(name.c_str());
+    }
+    return false;
+  }
+
+  bool isValid = header->_magic == sharedMagic && 
+                 header->_version == sharedVersion &&
+                 header->_sourceHash == sourceHash &&
+                 header->_payloadSize == payloadSize &&
+                 header->_checksum == hashBytes(payload, payloadSize);
+
+  if(isValid){
+    ByteReader reader {payload, payloadSize};
+    isValid = unpacker(reader) && reader.isDone();
+  }
+
+  munmap(segment, size);
+
+  log->log(isValid ? Log::INFO : Log::WARN, 
+           isValid ? logstr::info_mapped_shared_assets : logstr::warn_invalid_shared_assets, 
+           name);
+
+  // an invalid segment would otherwise be kept, and skipped by every later process, until reboot.
+  if(!isValid)
+    shm_unlink(name.c_str());
+
+  return isValid;
+}
+
+void Assets::writeShared(const std::string& name, uint64_t sourceHash, const std::vector<uint8_t>& payload)
+{
+  // Exclusive creation ensures only one process builds the segment; if it already exists then
+  // another process is building it, so this process just keeps its copy.
+  int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+  if(fd == -1){
+    if(errno != EEXIST)
+      log->log(Log::WARN, logstr::warn_cannot_create_shared_assets, name);
+    return;
+  }
+
+  size_t size = sizeof(SharedHeader) + payload.size();
+  if(ftruncate(fd, size) == -1){
+    close(fd);
+    shm_unlink(name.c_str());
+    log->log(Log::WARN, logstr::warn_cannot_create_shared_assets, name);
+    return;
+  }
+
+  void* segment = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if(segment == MAP_FAILED){
+    shm_unlink(name.c_str());
+    log->log(Log::WARN, logstr::warn_cannot_create_shared_assets, name);
+    return;
+  }
+
+  SharedHeader* header = new (segment) SharedHeader{};
+  header->_magic = sharedMagic;
+  header->_version = sharedVersion;
+  header->_sourceHash = sourceHash;
+  header->_payloadSize = payload.size();
+  header->_checksum = hashBytes(payload.data(), payload.size());
+  header->_builderPid = static_cast<int32_t>(getpid());
+  std::memcpy(static_cast<uint8_t*>(segment) + sizeof(SharedHeader), payload.data(), payload.size());
+  header->_isReady.store(1, std::memory_order_release);
 
-  glyph._bitmap.initialize(std::move(bits), scale);
+  munmap(segment, size);
 
-  return glyph;
+  log->log(Log::INFO, logstr::info_created_shared_assets, name);
+}
+
+std::vector<uint8_t> Assets::packBitmaps(const Manifest_t& manifest) const
+{
+  ByteWriter writer {};
+  writer.write(static_cast<uint32_t>(manifest.size()));
+  for(const auto& tuple : manifest){
+    Key_t key = std::get<0>(tuple);
+    Scale_t scale = std::get<2>(tuple);
+    const Bitmap& bitmap = getBitmap(key, scale);
+    writer.write(key);
+    writer.write(static_cast<uint32_t>(scale));
+    writer.write(bitmap._width);
+    writer.write(bitmap._height);
+    const auto& bytes = bitmap.getBytes();
+    writer.writeBytes(bytes.data(), bytes.size());
+  }
+  return writer.getBytes();
 }
 
-const Bitmap& Assets::getBitmap(Key_t key, Scale_t scale) const
+std::vector<uint8_t> Assets::packFonts(const Manifest_t& manifest) const
 {
-  return *((_bitmaps.at(key))[scale]);
+  ByteWriter writer {};
+  writer.write(static_cast<uint32_t>(manifest.size()));
+  for(const auto& tuple : manifest){
+    Key_t key = std::get<0>(tuple);
+    Scale_t scale = std::get<2>(tuple);
+    const Font& font = getFont(key, scale);
+    writer.write(key);
+    writer.write(static_cast<uint32_t>(scale));
+    writer.write(font._meta);
+    writer.write(font._glyphs);
+    writer.write(font._penAdvances);
+    writer.write(static_cast<uint64_t>(font._atlas.size()));
+    writer.writeBytes(font._atlas.data(), font._atlas.size());
+  }
+  return writer.getBytes();
+}
+
+bool Assets::unpackBitmaps(ByteReader& reader)
+{
+  std::vector<std::pair<size_t, std::unique_ptr<Bitmap>>> unpacked {};
+
+  uint32_t count {0};
+  if(!reader.read(count)) return false;
+  for(uint32_t i = 0; i < count; ++i){
+    Key_t key {0};
+    uint32_t scale {0};
+    int32_t width {0}, height {0};
+    if(!reader.read(key) || !reader.read(scale) || !reader.read(width) || !reader.read(height))
+      return false;
+    if(key < 0 || scale >= maxScale || width <= 0 || height <= 0)
+      return false;
+    std::vector<uint8_t> bytes(((width + 7) / 8) * height);
+    if(!reader.readBytes(bytes.data(), bytes.size()))
+      return false;
+    auto bitmap = std::unique_ptr<Bitmap>(new Bitmap{});
+    bitmap->initialize(bytes.data(), width, height);
+    unpacked.push_back({tableIndex(key, scale), std::move(bitmap)});
+  }
+
+  for(auto& [index, bitmap] : unpacked){
+    if(index >= _bitmaps.size())
+      _bitmaps.resize(index + 1);
+    if(_bitmaps[index] == nullptr)
+      _bitmaps[index] = std::move(bitmap);
+  }
+  return true;
 }
 
-const Font& Assets::getFont(Key_t key, Scale_t scale) const
+bool Assets::unpackFonts(ByteReader& reader)
 {
-  return *((_fonts.at(key))[scale]);
+  std::vector<std::pair<size_t, std::unique_ptr<Font>>> unpacked {};
+
+  uint32_t count {0};
+  if(!reader.read(count)) return false;
+  for(uint32_t i = 0; i < count; ++i){
+    Key_t key {0};
+    uint32_t scale {0};
+    auto font = std::unique_ptr<Font>(new Font{});
+    uint64_t atlasSize {0};
+    if(!reader.read(key) || !reader.read(scale) || !reader.read(font->_meta) || 
+       !reader.read(font->_glyphs) || !reader.read(font->_penAdvances) || !reader.read(atlasSize))
+      return false;
+    if(key < 0 || scale >= maxScale)
+      return false;
+    for(const auto& glyph : font->_glyphs)
+      if(glyph._atlasOffset < 0 || 
+         static_cast<uint64_t>(glyph._atlasOffset + (((glyph._width + 7) / 8) * glyph._height)) > atlasSize)
+        return false;
+    font->_atlas.resize(atlasSize);
+    if(!reader.readBytes(font->_atlas.data(), atlasSize))
+      return false;
+    unpacked.push_back({tableIndex(key, scale), std::move(font)});
+  }
+
+  for(auto& [index, font] : unpacked){
+    if(index >= _fonts.size())
+      _fonts.resize(index + 1);
+    if(_fonts[index] == nullptr)
+      _fonts[index] = std::move(font);
+  }
+  return true;
 }
 
 Bitmap Assets::makeBlockBitmap(int32_t width, int32_t height)
@@ -860,12 +1780,25 @@ Bitmap Assets::makeBlockBitmap(int32_t width, int32_t height)
   return b;
 }
 
-std::unique_ptr<Assets> assets {nullptr};
+Bitmap Assets::makeBitmap(std::vector<std::string> rows)
+{
+  Bitmap b {};
+  b.initialize(std::move(rows));
+  return b;
+}
+
+thread_local std::shared_ptr<Assets> assets {nullptr};
 
 //===============================================================================================//
 // ##>GRAPHICS                                                                                   //
 //===============================================================================================//
 
+Bitmap::Bitmap(int32_t width, int32_t height)
+{
+  std::vector<uint8_t> bytes(((width + 7) / 8) * height, 0);
+  initialize(bytes.data(), width, height);
+}
+
 void Bitmap::initialize(std::vector<std::string> bits, int32_t scale)
   // predicate: bit strings must contain only 0's and 1's
 {
@@ -904,135 +1837,536 @@ void Bitmap::initialize(std::vector<std::string> bits, int32_t scale)
   _width = w;
   _height = bits.size();
 
-  // generate the bit data
-  std::vector<bool> brow {};
-  brow.reserve(w);
-  for(const auto& row : bits){
-    brow.clear();
-    for(char c : row){
-      bool bit = !(c == '0'); 
-      brow.push_back(bit); 
-    }
-    int32_t n = w - row.size();
-    while(n-- > 0){
-      brow.push_back(false); // pad to make all rows equal length
-    }
-    brow.shrink_to_fit();
-    _bits.push_back(brow);
+  // generate the bit data; rows shorter than the width are padded with 0's.
+  _rowWords = (_width + wordBits - 1) / wordBits;
+  _words.assign(_height * _rowWords, 0);
+  for(int32_t row = 0; row < _height; ++row){
+    uint64_t* words = getRowWords(row);
+    const std::string& bitrow = bits[row];
+    for(int32_t col = 0; col < static_cast<int32_t>(bitrow.size()); ++col)
+      if(bitrow[col] != '0')
+        words[col / wordBits] |= getColumnBit(col);
+  }
+
+  _bytes.assign(((_width + 7) / 8) * _height, 0);
+  _dirtyRowMin = _height;
+  _dirtyRowMax = -1;
+  markDirtyRows(0, _height - 1);
+  countPixels();
+}
+
+void Bitmap::initialize(const uint8_t* bytes, int32_t width, int32_t height)
+  // predicate: bytes are rows of ceil(width / 8) bytes, as returned by getBytes.
+{
+  _width = width;
+  _height = height;
+  _rowWords = (width + wordBits - 1) / wordBits;
+
+  // Render bytes are the most significant bytes first of the row words, and any padding bits
+  // in the last byte of a row are 0, so each row is a straight byte copy.
+  int32_t stride = (width + 7) / 8;
+  _words.assign(height * _rowWords, 0);
+  for(int32_t row = 0; row < height; ++row){
+    uint64_t* words = getRowWords(row);
+    for(int32_t i = 0; i < stride; ++i)
+      words[i / 8] |= uint64_t{bytes[(row * stride) + i]} << (56 - ((i % 8) * 8));
   }
 
-  regenerateBytes();
+  _bytes.assign(bytes, bytes + (stride * height));
+  _dirtyRowMin = height;
+  _dirtyRowMax = -1;
+  countPixels();
 }
 
 bool Bitmap::getBit(int32_t row, int32_t col) const
 {
   assert(0 <= row && row < _height);
   assert(0 <= col && col < _width);
-  return _bits[row][col];
+  return getRowWords(row)[col / wordBits] & getColumnBit(col);
 }
 
-void Bitmap::setBit(int32_t row, int32_t col, bool value, bool regen)
+void Bitmap::setBit(int32_t row, int32_t col, bool value)
 {
   assert(0 <= row && row < _height);
   assert(0 <= col && col < _width);
-  _bits[row][col] = value;
-  if(regen)
-    regenerateBytes();
+  uint64_t& word = getRowWords(row)[col / wordBits];
+  uint64_t old = word;
+  if(value)
+    word |= getColumnBit(col);
+  else
+    word &= ~getColumnBit(col);
+  int32_t delta = std::popcount(word) - std::popcount(old);
+  _rowPixelCounts[row] += delta;
+  _pixelCount += delta;
+  markDirtyRows(row, row);
 }
 
-void Bitmap::setRect(int32_t rowMin, int32_t colMin, int32_t rowMax, int32_t colMax, bool value, bool regen)
+void Bitmap::setRect(int32_t rowMin, int32_t colMin, int32_t rowMax, int32_t colMax, bool value)
 {
   // note - inclusive range of rows and columns, i.e. [rowMin, rowMax] and [colMin, colMax]
   
   assert(rowMin >= 0 && rowMax < _height);
   assert(colMin >= 0 && colMax < _width);
 
-  for(int32_t row = rowMin; row <= rowMax; ++row)
-    for(int32_t col = colMin; col <= colMax; ++col)
-      _bits[row][col] = value;
+  for(int32_t row = rowMin; row <= rowMax; ++row){
+    uint64_t* words = getRowWords(row);
+    for(int32_t w = colMin / wordBits; w <= colMax / wordBits; ++w){
+      // Mask of the columns in the rect in word w.
+      int32_t first = std::max(colMin - (w * wordBits), 0);
+      int32_t last = std::min(colMax - (w * wordBits), wordBits - 1);
+      uint64_t mask = (~uint64_t{0} >> first) & (~uint64_t{0} << (wordBits - 1 - last));
+      uint64_t old = words[w];
+      if(value)
+        words[w] |= mask;
+      else
+        words[w] &= ~mask;
+      int32_t delta = std::popcount(words[w]) - std::popcount(old);
+      _rowPixelCounts[row] += delta;
+      _pixelCount += delta;
+    }
+  }
 
-  if(regen)
-    regenerateBytes();
+  markDirtyRows(rowMin, rowMax);
 }
 
-void Font::initialize(Meta meta, std::vector<Glyph> glyphs)
-  // predicate: expects glyphs for all ascii codes in the range 33-126 inclusive.
-  // predicate: expects glyphs to be in ascending order of ascii code.
+void Bitmap::clear()
 {
-  _meta = meta;
-  _glyphs = std::move(glyphs);
+  std::fill(_words.begin(), _words.end(), 0);
+  std::fill(_rowPixelCounts.begin(), _rowPixelCounts.end(), 0);
+  _pixelCount = 0;
+  markDirtyRows(0, _height - 1);
+}
+
+//
+// Returns the 64 bits of a row at columns [col, col + 64), column col in the most significant
+// bit; bits outside the row are 0. Col may be negative.
+//
+static uint64_t extractRowBits(const uint64_t* words, int32_t rowWords, int32_t col)
+{
+  constexpr int32_t wordBits {64};
+  int32_t w = (col >= 0) ? col / wordBits : -((wordBits - 1 - col) / wordBits);
+  int32_t shift = col - (w * wordBits);
+  uint64_t hi = (0 <= w && w < rowWords) ? words[w] : 0;
+  if(shift == 0)
+    return hi;
+  uint64_t lo = (0 <= w + 1 && w + 1 < rowWords) ? words[w + 1] : 0;
+  return (hi << shift) | (lo >> (wordBits - shift));
+}
+
+int32_t Bitmap::findSetBit(int32_t row, int32_t colMin, int32_t colMax) const
+{
+  assert(0 <= row && row < _height);
+  assert(0 <= colMin && colMin <= colMax && colMax < _width);
+
+  const uint64_t* words = getRowWords(row);
+  for(int32_t w = colMin / wordBits; w <= colMax / wordBits; ++w){
+    int32_t first = std::max(colMin - (w * wordBits), 0);
+    int32_t last = std::min(colMax - (w * wordBits), wordBits - 1);
+    uint64_t mask = (~uint64_t{0} >> first) & (~uint64_t{0} << (wordBits - 1 - last));
+    uint64_t bits = words[w] & mask;
+    if(bits != 0)
+      return (w * wordBits) + std::countl_zero(bits);
+  }
+  return -1;
 }
 
-void Bitmap::regenerateBytes()
+uint64_t Bitmap::getLastWordMask() const
 {
-  _bytes.clear();
-  uint8_t byte {0};
-  int32_t bitNo {0};
-  for(const auto& row : _bits){
-    for(bool bit : row){
-      if(bitNo > 7){
-        _bytes.push_back(byte);
-        byte = 0;
-        bitNo = 0;
+  int32_t tail = _width % wordBits;
+  return (tail == 0) ? ~uint64_t{0} : ~uint64_t{0} << (wordBits - tail);
+}
+
+int32_t Bitmap::stamp(const Bitmap& mask, Vector2i offset, StampOp op)
+{
+  int32_t rowMin = std::max(offset._y, 0);
+  int32_t rowMax = std::min(offset._y + mask._height, _height) - 1;
+  int32_t colMin = std::max(offset._x, 0);
+  int32_t colMax = std::min(offset._x + mask._width, _width) - 1;
+  if(rowMin > rowMax || colMin > colMax)
+    return 0;
+
+  int32_t changed {0};
+  for(int32_t row = rowMin; row <= rowMax; ++row){
+    uint64_t* words = getRowWords(row);
+    const uint64_t* maskWords = mask.getRowWords(row - offset._y);
+    for(int32_t w = colMin / wordBits; w <= colMax / wordBits; ++w){
+      uint64_t bits = extractRowBits(maskWords, mask._rowWords, (w * wordBits) - offset._x);
+      if(w == _rowWords - 1)
+        bits &= getLastWordMask();
+      if(bits == 0)
+        continue;
+      uint64_t old = words[w];
+      int32_t delta {0};
+      switch(op){
+        case STAMP_OR:      
+          words[w] |= bits; 
+          delta = std::popcount(old ^ words[w]); 
+          break;
+        case STAMP_XOR:     
+          words[w] ^= bits; 
+          delta = std::popcount(words[w]) - std::popcount(old); 
+          break;
+        case STAMP_AND_NOT: 
+          words[w] &= ~bits; 
+          delta = -std::popcount(old ^ words[w]); 
+          break;
       }
-      if(bit) 
-        byte |= 0x01 << (7 - bitNo);
-      bitNo++;
+      changed += (op == STAMP_XOR) ? std::popcount(bits) : std::abs(delta);
+      _rowPixelCounts[row] += delta;
+      _pixelCount += delta;
     }
-    _bytes.push_back(byte);
-    byte = 0;
-    bitNo = 0;
   }
+
+  if(changed != 0)
+    markDirtyRows(rowMin, rowMax);
+
+  return changed;
 }
 
-int32_t Font::calculateStringWidth(const std::string& str) const
+void Font::initialize(Meta meta, const std::vector<Glyph>& glyphs, const std::vector<Bitmap>& bitmaps)
+  // predicate: expects a bitmap for each glyph, i.e. bitmaps[i] is the bitmap of glyphs[i].
 {
-  int32_t sum {0};
-  for(char c : str){
-    if(c == ' ') 
-      sum += getWordSpace();
-    else 
-      sum += getGlyph(c)._advance + _meta._glyphSpace;
+  assert(glyphs.size() == bitmaps.size());
+
+  _meta = meta;
+
+  _glyphs.fill(Glyph{0, 0, 0, 0, 0, 0, 0});
+  _penAdvances.fill(0);
+
+  size_t atlasSize {0};
+  for(const auto& glyph : glyphs)
+    atlasSize += ((glyph._width + 7) / 8) * glyph._height;
+
+  _atlas.clear();
+  _atlas.reserve(atlasSize);
+
+  //
+  // Glyph rows are re-strided from the bitmap's width to the glyph's width as glBitmap is
+  // called with the glyph's dimensions; bitmaps have trailing zeros stripped so may be narrower.
+  //
+  for(size_t i = 0; i < glyphs.size(); ++i){
+    Glyph glyph = glyphs[i];
+    const Bitmap& bitmap = bitmaps[i];
+
+    assert(0 <= glyph._asciiCode && glyph._asciiCode < glyphTableSize);
+
+    glyph._atlasOffset = _atlas.size();
+
+    int32_t glyphStride = (glyph._width + 7) / 8;
+    int32_t bitmapStride = (bitmap.getWidth() + 7) / 8;
+    const auto& bytes = bitmap.getBytes();
+    for(int32_t row = 0; row < glyph._height; ++row){
+      for(int32_t col = 0; col < glyphStride; ++col){
+        bool isInBitmap = row < bitmap.getHeight() && col < bitmapStride;
+        _atlas.push_back(isInBitmap ? bytes[(row * bitmapStride) + col] : 0);
+      }
+    }
+
+    _glyphs[glyph._asciiCode] = glyph;
+    _penAdvances[glyph._asciiCode] = glyph._advance + _meta._glyphSpace;
   }
-  return sum;
+
+  _penAdvances[static_cast<uint8_t>(' ')] = _meta._wordSpace;
 }
 
-bool Bitmap::isEmpty()
+void Bitmap::markDirtyRows(int32_t rowMin, int32_t rowMax)
 {
-  for(const auto& row : _bits)
-    for(const auto& bit : row)
-      if(bit)
-        return false;
+  _dirtyRowMin = std::min(_dirtyRowMin, rowMin);
+  _dirtyRowMax = std::max(_dirtyRowMax, rowMax);
+}
 
-  return true;
+void Bitmap::countPixels()
+{
+  _rowPixelCounts.assign(_height, 0);
+  _pixelCount = 0;
+  for(int32_t row = 0; row < _height; ++row){
+    const uint64_t* words = getRowWords(row);
+    for(int32_t w = 0; w < _rowWords; ++w)
+      _rowPixelCounts[row] += std::popcount(words[w]);
+    _pixelCount += _rowPixelCounts[row];
+  }
 }
 
-bool Bitmap::isApproxEmpty(int32_t threshold)
+void Bitmap::regenerateBytes() const
 {
-  int32_t count {0};
-  for(const auto& row : _bits){
-    for(const auto& bit : row){
-      if(bit){
-        ++count;
-        if(count > threshold)
-          return false;
-      }
+  if(_dirtyRowMin > _dirtyRowMax)
+    return;
+
+  // The render bytes of a word are its bytes most significant first, i.e. the word stored big
+  // endian, so rows are copied a word at a time, the last truncated to the row's bytes.
+  int32_t stride = (_width + 7) / 8;
+  int32_t rowWords = _rowWords;
+  int32_t tailBytes = stride - ((rowWords - 1) * 8);
+  const uint64_t* words = _words.data() + (_dirtyRowMin * rowWords);
+  uint8_t* bytes = _bytes.data() + (_dirtyRowMin * stride);
+  for(int32_t row = _dirtyRowMin; row <= _dirtyRowMax; ++row){
+    for(int32_t w = 0; w < rowWords; ++w){
+      uint64_t word = words[w];
+      if constexpr(std::endian::native == std::endian::little)
+        word = __builtin_bswap64(word);
+      if(w < rowWords - 1)
+        std::memcpy(bytes + (w * 8), &word, 8);
+      else
+        for(int32_t i = 0; i < tailBytes; ++i)
+          bytes[(w * 8) + i] = static_cast<uint8_t>(words[w] >> (56 - (i * 8)));
     }
+    words += rowWords;
+    bytes += stride;
   }
-  return true;
+  _dirtyRowMin = _height;
+  _dirtyRowMax = -1;
+}
+
+void Bitmap::pack(ByteWriter& writer) const
+{
+  writer.write(_width);
+  writer.write(_height);
+  writer.writeBytes(_words.data(), _words.size() * sizeof(uint64_t));
+}
+
+bool Bitmap::unpack(ByteReader& reader)
+{
+  int32_t width {0}, height {0};
+  bool isValid = reader.read(width) && reader.read(height) && width == _width && height == _height &&
+                 reader.readBytes(_words.data(), _words.size() * sizeof(uint64_t));
+
+  // The bits past the width must be 0 for the word ops to hold.
+  uint64_t padMask = ~getLastWordMask();
+  for(int32_t row = 0; isValid && row < _height; ++row)
+    isValid = (getRowWords(row)[_rowWords - 1] & padMask) == 0;
+
+  if(!isValid)
+    std::fill(_words.begin(), _words.end(), 0);
+
+  markDirtyRows(0, _height - 1);
+  countPixels();
+  return isValid;
+}
+
+int32_t Font::calculateStringWidth(std::string_view str) const
+{
+  int32_t sum {0};
+  for(char c : str)
+    sum += getPenAdvance(c);
+  return sum;
 }
 
 void Bitmap::print(std::ostream& out) const
 {
-  for(auto iter = _bits.rbegin(); iter != _bits.rend(); ++iter){
-    for(bool bit : *iter){
-      out << bit;
+  for(int32_t row = _height - 1; row >= 0; --row){
+    for(int32_t col = 0; col < _width; ++col){
+      out << getBit(row, col);
     }
     out << '\n';
   }
   out << std::endl;
 }
 
+//
+// Maps a byte of bitmap pixels to its pooled pixels, each the OR of a group of factor pixels, 
+// right aligned; 8 / factor bits.
+//
+static constexpr std::array<uint8_t, 256> makePoolTable(int32_t factor)
+{
+  std::array<uint8_t, 256> table {};
+  int32_t groupMask = (1 << factor) - 1;
+  for(int32_t byte = 0; byte < 256; ++byte){
+    uint8_t pooled {0};
+    for(int32_t shift = 8 - factor; shift >= 0; shift -= factor)
+      pooled = (pooled << 1) | (((byte >> shift) & groupMask) != 0);
+    table[byte] = pooled;
+  }
+  return table;
+}
+
+static constexpr std::array<std::array<uint8_t, 256>, 4> poolTables {
+  makePoolTable(1), makePoolTable(2), makePoolTable(4), makePoolTable(8)
+};
+
+bool Bitmap::poolRow(int32_t row, int32_t factor, uint64_t* orWords, uint8_t* outBits) const
+  // predicate: orWords holds _rowWords words and outBits (_rowWords * 8) / factor bytes.
+{
+  // Most blocks of a sparse playfield are empty, which the row pixel counts tell for free.
+  int32_t rowMin = row * factor;
+  int32_t rowMax = std::min(rowMin + factor, _height) - 1;
+  int32_t blockPixelCount {0};
+  for(int32_t r = rowMin; r <= rowMax; ++r)
+    blockPixelCount += _rowPixelCounts[r];
+  if(blockPixelCount == 0)
+    return false;
+
+  // OR the block's rows together, a vector of words at a time.
+  std::memcpy(orWords, getRowWords(rowMin), _rowWords * sizeof(uint64_t));
+  for(int32_t r = rowMin + 1; r <= rowMax; ++r){
+    const uint64_t* words = getRowWords(r);
+    int32_t w {0};
+#if defined(__AVX2__)
+    for(; w + 4 <= _rowWords; w += 4){
+      __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(orWords + w));
+      __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(words + w));
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(orWords + w), _mm256_or_si256(a, b));
+    }
+#endif
+#if defined(__SSE2__)
+    for(; w + 2 <= _rowWords; w += 2){
+      __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(orWords + w));
+      __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(words + w));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(orWords + w), _mm_or_si128(a, b));
+    }
+#endif
+    for(; w < _rowWords; ++w)
+      orWords[w] |= words[w];
+  }
+
+  // Pool across the row; a word of 64 pixels pools to 8 / factor bytes. Groups never straddle 
+  // bytes as the factor divides 8. Unpooled words are just their bytes most significant first.
+  if(factor == 1){
+    for(int32_t w = 0; w < _rowWords; ++w){
+      uint64_t word = orWords[w];
+      if constexpr(std::endian::native == std::endian::little)
+        word = __builtin_bswap64(word);
+      std::memcpy(outBits + (w * 8), &word, 8);
+    }
+    return true;
+  }
+
+  const std::array<uint8_t, 256>& table = poolTables[std::countr_zero(static_cast<uint32_t>(factor))];
+  int32_t groupBits = 8 / factor;
+  for(int32_t w = 0; w < _rowWords; ++w){
+    uint64_t pooled {0};
+    for(int32_t shift = 56; shift >= 0; shift -= 8)
+      pooled = (pooled << groupBits) | table[(orWords[w] >> shift) & 0xff];
+    for(int32_t i = groupBits - 1; i >= 0; --i)
+      *outBits++ = static_cast<uint8_t>(pooled >> (i * 8));
+  }
+  return true;
+}
+
+void Bitmap::poolBits(int32_t factor, std::span<uint8_t> out) const
+{
+  assert(factor == 1 || factor == 2 || factor == 4 || factor == 8);
+
+  int32_t pooledHeight = getPooledSize(_height, factor);
+  int32_t stride = (getPooledSize(_width, factor) + 7) / 8;
+  assert(static_cast<int32_t>(out.size()) >= stride * pooledHeight);
+
+  thread_local std::vector<uint64_t> orWords {};
+  thread_local std::vector<uint8_t> bits {};
+  orWords.resize(_rowWords);
+  bits.resize(_rowWords * 8);
+
+  for(int32_t row = 0; row < pooledHeight; ++row){
+    if(poolRow(row, factor, orWords.data(), bits.data()))
+      std::memcpy(out.data() + (row * stride), bits.data(), stride);
+    else
+      std::memset(out.data() + (row * stride), 0, stride);
+  }
+}
+
+//
+// Raises each pixel of a row of gray pixels to gray where its bit (msb first) is set.
+//
+static void maxGrayRow(const uint8_t* bits, uint8_t gray, uint8_t* pixels, int32_t pixelCount)
+  // predicate: bits is readable up to 4 bytes past the row's bits.
+{
+  int32_t i {0};
+
+#if defined(__AVX2__)
+  // Broadcast 4 bytes of bits, spread each over 8 lanes, and select a bit per lane.
+  const __m256i spread = _mm256_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 
+                                          2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3);
+  const __m256i select = _mm256_set1_epi64x(0x0102040810204080);
+  const __m256i grays = _mm256_set1_epi8(static_cast<char>(gray));
+  for(; i + 32 <= pixelCount; i += 32){
+    uint32_t word {};
+    std::memcpy(&word, bits + (i / 8), sizeof(word));
+    __m256i lanes = _mm256_shuffle_epi8(_mm256_set1_epi32(static_cast<int32_t>(word)), spread);
+    __m256i isSet = _mm256_cmpeq_epi8(_mm256_and_si256(lanes, select), select);
+    __m256i* out = reinterpret_cast<__m256i*>(pixels + i);
+    _mm256_storeu_si256(out, _mm256_max_epu8(_mm256_loadu_si256(out), _mm256_and_si256(isSet, grays)));
+  }
+#elif defined(__SSE2__)
+  const __m128i select = _mm_set1_epi64x(0x0102040810204080);
+  const __m128i grays = _mm_set1_epi8(static_cast<char>(gray));
+  for(; i + 16 <= pixelCount; i += 16){
+    __m128i lanes = _mm_unpacklo_epi64(_mm_set1_epi8(static_cast<char>(bits[i / 8])), 
+                                       _mm_set1_epi8(static_cast<char>(bits[(i / 8) + 1])));
+    __m128i isSet = _mm_cmpeq_epi8(_mm_and_si128(lanes, select), select);
+    __m128i* out = reinterpret_cast<__m128i*>(pixels + i);
+    _mm_storeu_si128(out, _mm_max_epu8(_mm_loadu_si128(out), _mm_and_si128(isSet, grays)));
+  }
+#endif
+
+  for(; i < pixelCount; ++i)
+    if(bits[i / 8] & (0x80 >> (i % 8)))
+      pixels[i] = std::max(pixels[i], gray);
+}
+
+void Bitmap::poolGray(std::span<const Bitmap> planes, std::span<const uint8_t> grays, 
+                      int32_t factor, std::span<uint8_t> out)
+{
+  assert(!planes.empty() && planes.size() == grays.size());
+  assert(factor == 1 || factor == 2 || factor == 4 || factor == 8);
+
+  int32_t width = planes[0]._width;
+  int32_t height = planes[0]._height;
+  int32_t rowWords = planes[0]._rowWords;
+  int32_t pooledWidth = getPooledSize(width, factor);
+  int32_t pooledHeight = getPooledSize(height, factor);
+  assert(static_cast<int32_t>(out.size()) >= pooledWidth * pooledHeight);
+
+  thread_local std::vector<uint64_t> orWords {};
+  thread_local std::vector<uint8_t> bits {};
+  orWords.resize(rowWords);
+  bits.resize((rowWords * 8) + 4);
+
+  std::fill(out.begin(), out.begin() + (pooledWidth * pooledHeight), 0);
+
+  for(size_t p = 0; p < planes.size(); ++p){
+    const Bitmap& plane = planes[p];
+    assert(plane._width == width && plane._height == height);
+    if(grays[p] == 0 || plane.isEmpty())
+      continue;
+
+    for(int32_t row = 0; row < pooledHeight; ++row)
+      if(plane.poolRow(row, factor, orWords.data(), bits.data()))
+        maxGrayRow(bits.data(), grays[p], out.data() + (row * pooledWidth), pooledWidth);
+  }
+}
+
+FrameStack::FrameStack(int32_t frameCount, int32_t frameSize) :
+  _frames(((2 * static_cast<size_t>(frameCount)) - 1) * frameSize, 0),
+  _frameCount{frameCount},
+  _frameSize{frameSize},
+  _newest{frameCount - 1}
+{
+  assert(frameCount >= 1 && frameSize >= 0);
+}
+
+void FrameStack::push(std::span<const uint8_t> frame)
+{
+  assert(static_cast<int32_t>(frame.size()) == _frameSize);
+
+  _newest = (_newest + 1) % _frameCount;
+  std::copy(frame.begin(), frame.end(), _frames.begin() + (_newest * _frameSize));
+  if(_newest < _frameCount - 1)
+    std::copy(frame.begin(), frame.end(), _frames.begin() + ((_newest + _frameCount) * _frameSize));
+}
+
+void FrameStack::fill(std::span<const uint8_t> frame)
+{
+  for(int32_t i = 0; i < _frameCount; ++i)
+    push(frame);
+}
+
+std::span<const uint8_t> FrameStack::getFrames() const
+{
+  // The oldest frame is the slot after the newest; when the newest is the last of the k slots
+  // the frames are in place, else the newest ones are the copies from slot k on.
+  size_t oldest = (_newest + 1) % _frameCount;
+  return {_frames.data() + (oldest * _frameSize), static_cast<size_t>(_frameCount) * _frameSize};
+}
+
 Renderer::Renderer(const Config& config)
 {
   _config = config;
@@ -1108,16 +2442,12 @@ void Renderer::blitText(Vector2f position, const std::string& text,  const Font&
   glRasterPos2f(position._x, position._y);
 
   for(char c : text){
-    if(!(' ' <= c && c <= '~'))
+    int32_t advance = font.getPenAdvance(c);
+    if(advance == 0)
       continue;
 
-    if(c == ' '){
-      glBitmap(0, 0, 0, 0, font.getWordSpace(), 0, nullptr);
-    }
-    else{
-      const Glyph& g = font.getGlyph(c);      
-      glBitmap(g._width, g._height, g._offsetX, g._offsetY, g._advance + font.getGlyphSpace(), 0, g._bitmap.getBytes().data());
-    }
+    const Glyph& g = font.getGlyph(c);
+    glBitmap(g._width, g._height, g._offsetX, g._offsetY, advance, 0, font.getGlyphBytes(g));
   }
 }
 
@@ -1181,7 +2511,7 @@ Vector2i Renderer::getWindowSize() const
   return size;
 }
 
-std::unique_ptr<Renderer> renderer {nullptr};
+thread_local std::unique_ptr<Renderer> renderer {nullptr};
 
 //===============================================================================================//
 // ##>COLLISION DETECTION                                                                        //
@@ -1229,11 +2559,15 @@ static void findPixelIntersectionSets(const AABB& aOverlap, const Bitmap& aBitma
   int32_t aBitRow, bBitRow, aBitCol, bBitCol, aBitValue, bBitValue;
 
   for(int32_t row = 0; row < overlapHeight; ++row){
+    aBitRow = aOverlap._ymin + row;
+    bBitRow = bOverlap._ymin + row;
+
+    // Cull rows in which either bitmap has no pixels set.
+    if(aBitmap.getRowPixelCount(aBitRow) == 0 || bBitmap.getRowPixelCount(bBitRow) == 0)
+      continue;
+
     for(int32_t col = 0; col < overlapWidth; ++col){
-      aBitRow = aOverlap._ymin + row;
       aBitCol = aOverlap._xmin + col;
-
-      bBitRow = bOverlap._ymin + row;
       bBitCol = bOverlap._xmin + col;
 
       aBitValue = aBitmap.getBit(aBitRow, aBitCol);
@@ -1254,7 +2588,7 @@ static void findPixelIntersectionSets(const AABB& aOverlap, const Bitmap& aBitma
 const Collision& testCollision(Vector2i aPosition, const Bitmap& aBitmap, 
                                Vector2i bPosition, const Bitmap& bBitmap, bool pixelLists)
 {
-  static Collision c;
+  thread_local Collision c;
 
   c._isCollision = false;
   c._aOverlap = {0, 0, 0, 0};
@@ -1284,32 +2618,92 @@ const Collision& testCollision(Vector2i aPosition, const Bitmap& aBitmap,
   return c;
 }
 
+ColumnSweep testColumnSweep(int32_t x, int32_t width, int32_t yMin, int32_t yMax, 
+                            Vector2i position, const Bitmap& bitmap, bool isAscending)
+{
+  ColumnSweep sweep {false, {0, 0}, 0};
+
+  // The swept area w.r.t the bitmap's coordinate space, clipped to the bitmap.
+  int32_t colMin = std::max(x - position._x, 0);
+  int32_t colMax = std::min(x + width - 1 - position._x, bitmap.getWidth() - 1);
+  int32_t rowMin = std::max(yMin - position._y, 0);
+  int32_t rowMax = std::min(yMax - position._y, bitmap.getHeight() - 1);
+
+  if(colMin > colMax || rowMin > rowMax)
+    return sweep;
+
+  int32_t rowStep = isAscending ? 1 : -1;
+  int32_t rowBegin = isAscending ? rowMin : rowMax;
+  int32_t rowEnd = isAscending ? rowMax + 1 : rowMin - 1;
+
+  for(int32_t row = rowBegin; row != rowEnd; row += rowStep){
+    if(bitmap.getRowPixelCount(row) == 0)
+      continue;
+
+    int32_t col = bitmap.findSetBit(row, colMin, colMax);
+    if(col == -1)
+      continue;
+
+    sweep._isHit = true;
+    sweep._pixel = {col, row};
+    sweep._screenY = position._y + row;
+    break;
+  }
+
+  return sweep;
+}
+
 //===============================================================================================//
 // ##>MIXER                                                                                      //
 //===============================================================================================//
 
-Mixer::Mixer()
+std::atomic<bool> Mixer::_isMusicFinished {false};
+
+Mixer::Mixer(bool isHeadless) :
+  _sounds{},
+  _music{},
+  _volume{1.f},
+  _musicVolume{1.f},
+  _queuedMusic{0},
+  _queuedLoops{0},
+  _queuedFadeInTime_ms{0},
+  _isMusicQueued{false},
+  _isHeadless{isHeadless}
 {
+  if(_isHeadless) return;
+
+  Mix_Init(MIX_INIT_MP3);
+
   if(Mix_OpenAudio(sampleFreq, sampleFormat, numOutChannels, chunkSize) != 0){
     log->log(Log::FATAL, logstr::fail_open_audio, std::string{Mix_GetError()});
     exit(EXIT_FAILURE);
   }
 
   Mix_AllocateChannels(numMixChannels);
+  Mix_HookMusicFinished(&Mixer::onMusicFinished);
 }
 
 Mixer::~Mixer()
 {
+  if(_isHeadless) return;
+
   stopChannel(allChannels);
+  stopMusic();
+  Mix_HookMusicFinished(nullptr);
 
   for(auto pair : _sounds)
     Mix_FreeChunk(pair.second);
 
+  for(auto pair : _music)
+    Mix_FreeMusic(pair.second);
+
   Mix_CloseAudio();
+  Mix_Quit();
 }
 
 void Mixer::loadSoundsWAV(const Manifest_t& manifest)
 {
+  if(_isHeadless) return;
   std::string path {};
   Mix_Chunk* chunk {nullptr};
   for(auto pair : manifest){
@@ -1322,14 +2716,37 @@ void Mixer::loadSoundsWAV(const Manifest_t& manifest)
       log->log(Log::WARN, logstr::warn_cannot_load_sound, std::string{Mix_GetError()});
       continue;
     }
+    if(startup) startup->recordFile(path);
     log->log(Log::INFO, logstr::info_loaded_sound, path + ", key:" + std::to_string(pair.first));
     _sounds.emplace(std::make_pair(pair.first, chunk));
     chunk = nullptr;
   }
 }
 
+void Mixer::loadMusic(const Manifest_t& manifest)
+{
+  if(_isHeadless) return;
+  std::string path {};
+  Mix_Music* music {nullptr};
+  for(auto pair : manifest){
+    path.clear();
+    path += sounds_path;
+    path += pair.second;
+    path += music_extension;
+    music = Mix_LoadMUS(path.c_str());
+    if(!music){
+      log->log(Log::WARN, logstr::warn_cannot_load_music, std::string{Mix_GetError()});
+      continue;
+    }
+    log->log(Log::INFO, logstr::info_loaded_music, path + ", key:" + std::to_string(pair.first));
+    _music.emplace(std::make_pair(pair.first, music));
+    music = nullptr;
+  }
+}
+
 Mixer::Channel_t Mixer::playSound(Key_t sndkey, int loops)
 {
+  if(_isHeadless) return nullChannel;
   Mix_Chunk* chunk = findChunk(sndkey);
   if(chunk == nullptr) return -1;
   Channel_t channel = Mix_PlayChannel(-1, chunk, loops);
@@ -1342,6 +2759,7 @@ Mixer::Channel_t Mixer::playSound(Key_t sndkey, int loops)
 
 Mixer::Channel_t Mixer::playSoundTimed(Key_t sndkey, int loops, int timeLimit_ms)
 {
+  if(_isHeadless) return nullChannel;
   Mix_Chunk* chunk = findChunk(sndkey);
   if(chunk == nullptr) return -1;
   Channel_t channel = Mix_PlayChannelTimed(-1, chunk, loops, timeLimit_ms);
@@ -1354,6 +2772,7 @@ Mixer::Channel_t Mixer::playSoundTimed(Key_t sndkey, int loops, int timeLimit_ms
 
 Mixer::Channel_t Mixer::playSoundFadeIn(Key_t sndkey, int loops, int fadeInTime_ms)
 {
+  if(_isHeadless) return nullChannel;
   Mix_Chunk* chunk = findChunk(sndkey);
   if(chunk == nullptr) return -1;
   int channel = Mix_FadeInChannel(-1, chunk, loops, fadeInTime_ms);
@@ -1366,6 +2785,7 @@ Mixer::Channel_t Mixer::playSoundFadeIn(Key_t sndkey, int loops, int fadeInTime_
 
 Mixer::Channel_t Mixer::playSoundFadeInTimed(Key_t sndkey, int loops, int fadeInTime_ms, int timeLimit_ms)
 {
+  if(_isHeadless) return nullChannel;
   Mix_Chunk* chunk = findChunk(sndkey);
   if(chunk == nullptr) return -1;
   int channel = Mix_FadeInChannelTimed(-1, chunk, loops, fadeInTime_ms, timeLimit_ms);
@@ -1378,29 +2798,135 @@ Mixer::Channel_t Mixer::playSoundFadeInTimed(Key_t sndkey, int loops, int fadeIn
 
 void Mixer::stopChannel(Channel_t channel)
 {
+  if(_isHeadless) return;
   if(channel == nullChannel) return;
   Mix_HaltChannel(channel);
 }
 
 void Mixer::pauseChannel(Channel_t channel)
 {
+  if(_isHeadless) return;
   if(channel == nullChannel) return;
   Mix_Pause(channel);
 }
 
 void Mixer::resumeChannel(Channel_t channel)
 {
+  if(_isHeadless) return;
   if(channel == nullChannel) return;
   Mix_Resume(channel);
 }
 
 void Mixer::setVolume(float volume)
 {
+  if(_isHeadless){
+    _volume = std::clamp(volume, 0.f, 1.f);
+    return;
+  }
   int ivolume = std::clamp(volume, 0.f, 1.f) * MIX_MAX_VOLUME;
   ivolume = Mix_Volume(allChannels, ivolume); // returns average volume of all mixing channels.
   _volume = static_cast<float>(ivolume) / MIX_MAX_VOLUME;
 }
 
+void Mixer::playMusic(Key_t muskey, int loops, int fadeInTime_ms)
+{
+  if(_isHeadless) return;
+  _isMusicQueued = false;
+  Mix_Music* music = findMusic(muskey);
+  if(music == nullptr) return;
+  _isMusicFinished = false;
+  int r = (fadeInTime_ms > 0) ? Mix_FadeInMusic(music, loops, fadeInTime_ms) : Mix_PlayMusic(music, loops);
+  if(r == -1)
+    log->log(Log::WARN, logstr::warn_cannot_play_music, std::string{Mix_GetError()});
+}
+
+void Mixer::crossfadeMusic(Key_t muskey, int fadeTime_ms, int loops)
+{
+  if(_isHeadless) return;
+  if(!isMusicPlaying()){
+    playMusic(muskey, loops, fadeTime_ms);
+    return;
+  }
+
+  _queuedMusic = muskey;
+  _queuedLoops = loops;
+  _queuedFadeInTime_ms = fadeTime_ms;
+  _isMusicQueued = true;
+
+  // If a fade out is already in progress the queued music will start when it completes.
+  if(Mix_FadingMusic() != MIX_FADING_OUT)
+    Mix_FadeOutMusic(fadeTime_ms);
+}
+
+void Mixer::fadeOutMusic(int fadeOutTime_ms)
+{
+  if(_isHeadless) return;
+  _isMusicQueued = false;
+  if(!isMusicPlaying()) return;
+  Mix_FadeOutMusic(fadeOutTime_ms);
+}
+
+void Mixer::stopMusic()
+{
+  if(_isHeadless) return;
+  _isMusicQueued = false;
+  Mix_HaltMusic();
+}
+
+void Mixer::pauseMusic()
+{
+  if(_isHeadless) return;
+  Mix_PauseMusic();
+}
+
+void Mixer::resumeMusic()
+{
+  if(_isHeadless) return;
+  Mix_ResumeMusic();
+}
+
+bool Mixer::isMusicPlaying() const
+{
+  if(_isHeadless) return false;
+  return Mix_PlayingMusic() != 0;
+}
+
+void Mixer::setMusicVolume(float volume)
+{
+  if(_isHeadless){
+    _musicVolume = std::clamp(volume, 0.f, 1.f);
+    return;
+  }
+  int ivolume = std::clamp(volume, 0.f, 1.f) * MIX_MAX_VOLUME;
+  Mix_VolumeMusic(ivolume);
+  _musicVolume = static_cast<float>(Mix_VolumeMusic(-1)) / MIX_MAX_VOLUME;
+}
+
+void Mixer::onUpdate()
+{
+  if(_isHeadless) return;
+  if(!_isMusicFinished.exchange(false))
+    return;
+
+  if(_isMusicQueued)
+    playMusic(_queuedMusic, _queuedLoops, _queuedFadeInTime_ms);
+}
+
+void Mixer::onMusicFinished()
+{
+  _isMusicFinished = true;
+}
+
+Mix_Music* Mixer::findMusic(Key_t muskey)
+{
+  auto search = _music.find(muskey);
+  if(search == _music.end()){
+    log->log(Log::WARN, logstr::warn_missing_music, std::to_string(muskey));
+    return nullptr;
+  }
+  return search->second;
+}
+
 Mix_Chunk* Mixer::findChunk(Key_t sndkey)
 {
   auto search = _sounds.find(sndkey);
@@ -1411,7 +2937,7 @@ Mix_Chunk* Mixer::findChunk(Key_t sndkey)
   return search->second;
 }
 
-std::unique_ptr<Mixer> mixer;
+thread_local std::unique_ptr<Mixer> mixer;
 
 //===============================================================================================//
 // ##>UI                                                                                         //
@@ -1814,7 +3340,7 @@ void Application::onWindowResize(int32_t windowWidth, int32_t windowHeight)
 
   if((windowWidth < worldSize._x) || (windowHeight < worldSize._y)){
     _isWindowTooSmall = true;
-    _engine->pause();
+    if(_engine) _engine->pause();
     _viewport._x = 0;
     _viewport._y = 0;
     _viewport._w = windowWidth;
@@ -1822,7 +3348,7 @@ void Application::onWindowResize(int32_t windowWidth, int32_t windowHeight)
   }
   else{
     _isWindowTooSmall = false;
-    _engine->unpause();
+    if(_engine) _engine->unpause();
     _viewport._x = (windowWidth - worldSize._x) / 2;
     _viewport._y = (windowHeight - worldSize._y) / 2;
     _viewport._w = worldSize._x;
@@ -1875,6 +3401,29 @@ void Application::drawWindowTooSmall()
 // ##>ENGINE                                                                                     //
 //===============================================================================================//
 
+Context::Context(std::shared_ptr<Log> sharedLog, std::shared_ptr<Assets> sharedAssets, xorwow::result_type seed) :
+  _threadId{std::this_thread::get_id()}
+{
+  assert(input == nullptr); // Only one context (or engine) per thread.
+
+  log = std::move(sharedLog);
+  input = std::make_unique<Input>();
+  mixer = std::make_unique<Mixer>(true);
+  renderer = nullptr;
+  assets = std::move(sharedAssets);
+  randGenerator.seed(seed);
+}
+
+Context::~Context()
+{
+  assert(std::this_thread::get_id() == _threadId);
+
+  assets.reset();
+  mixer.reset();
+  input.reset();
+  log.reset();
+}
+
 Engine::Duration_t Engine::RealClock::update()
 {
   _now1 = Clock_t::now();
@@ -1916,6 +3465,7 @@ void Engine::TPSMeter::recordTicks(Duration_t realDt, int32_t ticks)
 void Engine::initialize(std::unique_ptr<Application> app)
 {
   log = std::make_unique<Log>();
+  startup = std::make_unique<StartupReport>();
 
   // 
   // Testing the seed_seq on my system shows it just produces the same results with every run, 
@@ -1934,13 +3484,17 @@ void Engine::initialize(std::unique_ptr<Application> app)
 
   _app = std::move(app);
 
+  startup->beginPhase("config");
   if(_config.load(Config::filename) != 0)
     _config.write(Config::filename); // generate a default file if one doesn't exist.
+  startup->endPhase();
 
+  startup->beginPhase("sdl init");
   if(SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO) != 0){
     log->log(Log::FATAL, logstr::fail_sdl_init, std::string{SDL_GetError()});
     exit(EXIT_FAILURE);
   }
+  startup->endPhase();
 
   LoopTick* tick = &_loopTicks[LOOPTICK_UPDATE];
   tick->_onTick = &Engine::onUpdateTick;
@@ -1974,19 +3528,27 @@ void Engine::initialize(std::unique_ptr<Application> app)
     _config.getBoolValue(Config::KEY_FULLSCREEN)
   };
 
+  startup->beginPhase("window and gl context");
   renderer = std::make_unique<Renderer>(rconfig);
+  startup->endPhase();
 
+  startup->beginPhase("mixer open");
   mixer = std::make_unique<Mixer>();
+  startup->endPhase();
 
   input = std::make_unique<Input>();
-  assets = std::make_unique<Assets>();
+  assets = std::make_unique<Assets>(_config.getBoolValue(Config::KEY_SHARED_ASSETS));
 
+  startup->beginPhase("engine font");
   Assets::Manifest_t manifest {{engineFontKey, engineFontName, engineFontScale}};
   assets->loadFonts(manifest);
+  startup->endPhase();
 
   Vector2i windowSize = pxr::renderer->getWindowSize();
 
+  startup->beginPhase("app");
   _app->initialize(this, windowSize._x, windowSize._y);
+  startup->endPhase();
 
   _frameNo = 0;
   _isSleeping = true;
@@ -2046,6 +3608,8 @@ void Engine::mainloop()
     }
   }
 
+  pxr::mixer->onUpdate();
+
   //
   // TODO: make the update loop more elegant - needed to make drawing based on real clock not
   // on game clock so drawing doesnt stop when the game pauses or slow down when the timeline 
@@ -2175,6 +3739,11 @@ void Engine::onDrawTick(Duration_t gameNow, Duration_t gameDt, Duration_t realDt
     drawPerformanceStats(realDt, gameDt);
 
   pxr::renderer->show();
+
+  if(startup){
+    startup->recordFirstShow();
+    startup.reset();
+  }
 }
 
 double Engine::durationToMilliseconds(Duration_t d)
@@ -9,17 +9,30 @@
 #include <algorithm>
 #include <cassert>
 #include <string>
+#include <string_view>
 #include <cstring>
 #include <sstream>
 #include <cmath>
 #include <vector>
+#include <array>
+#include <unordered_map>
 #include <initializer_list>
 #include <memory>
 #include <fstream>
 #include <variant>
 #include <tuple>
+#include <utility>
 #include <random>
 #include <limits>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <bit>
+#include <functional>
+#include <type_traits>
+#include <filesystem>
+#include <span>
 
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_opengl.h>
@@ -37,6 +50,1038 @@ inline T wrap(T value, T lo, T hi)
   return (value < lo) ? hi : (value > hi) ? lo : value;
 }
 
+//
+// 64-bit FNV-1a hash; pass the result of a previous call as the seed to hash data in parts.
+//
+constexpr uint64_t fnvOffsetBasis {0xcbf29ce484222325};
+
+inline uint64_t hashBytes(const void* data, size_t size, uint64_t hash = fnvOffsetBasis)
+{
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  for(size_t i = 0; i < size; ++i){
+    hash ^= bytes[i];
+    hash *= 0x100000001b3;
+  }
+  return hash;
+}
+
+//
+// 64-bit xxHash (XXH64), for hashing larger buffers, e.g. simulation state every tick, many 
+// times faster than the above. Reads words in native byte order.
+//
+uint64_t hashState(const void* data, size_t size, uint64_t seed = 0);
+
+//
+// Minimal helpers to (de)serialize trivially copyable data to/from flat byte buffers. Values
+// are written in native byte order so buffers are only portable between like machines.
+//
+
+class ByteWriter
+{
+public:
+  template<typename T>
+  void write(const T& value)
+  {
+    static_assert(std::is_trivially_copyable_v<T>);
+    writeBytes(&value, sizeof(T));
+  }
+
+  // Writes values a field at a time, e.g. the members of structs with padding, whose bytes are
+  // indeterminate, when the output must be canonical.
+  template<typename... Ts>
+  void writeEach(const Ts&... values)
+  {
+    (write(values), ...);
+  }
+
+  void writeBytes(const void* data, size_t size)
+  {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    _bytes.insert(_bytes.end(), bytes, bytes + size);
+  }
+
+  const std::vector<uint8_t>& getBytes() const {return _bytes;}
+  void clear() {_bytes.clear();}   // Keeps the capacity, for reuse.
+
+private:
+  std::vector<uint8_t> _bytes;
+};
+
+class ByteReader
+{
+public:
+  ByteReader(const uint8_t* data, size_t size) : _data{data}, _size{size}, _position{0}{}
+
+  // All reads fail, returning false, if they would read past the end of the buffer. Reading a
+  // bool also fails if the byte is neither 0 nor 1.
+  template<typename T>
+  bool read(T& value)
+  {
+    static_assert(std::is_trivially_copyable_v<T>);
+    if constexpr(std::is_same_v<T, bool>){
+      uint8_t byte {0};
+      if(!readBytes(&byte, sizeof(byte)) || byte > 1)
+        return false;
+      value = (byte == 1);
+      return true;
+    }
+    else
+      return readBytes(&value, sizeof(T));
+  }
+
+  template<typename... Ts>
+  bool readEach(Ts&... values)
+  {
+    return (read(values) && ...);
+  }
+
+  bool readBytes(void* data, size_t size)
+  {
+    if(size > _size - _position) return false;
+    if(size == 0) return true;   // data may be null for empty buffers.
+    std::memcpy(data, _data + _position, size);
+    _position += size;
+    return true;
+  }
+
+  bool isDone() const {return _position == _size;}
+  size_t getRemaining() const {return _size - _position;}
+
+private:
+  const uint8_t* _data;
+  size_t _size;
+  size_t _position;
+};
+
+//
+// Run length coding of byte buffers, for data such as snapshots which is mostly runs of zeros.
+// The format is the engine's own: a header byte h < 128 is followed by h + 1 literal bytes, 
+// else by one byte repeated h - 125 times, so a run of 3 to 130 bytes takes 2. Decompressing 
+// fails, returning false, unless the input decodes to exactly fill the output, which can be at
+// most maxRunExpansion times the size of the input.
+//
+constexpr size_t maxRunExpansion {65};
+void compressRuns(std::span<const uint8_t> bytes, ByteWriter& writer);
+bool decompressRuns(std::span<const uint8_t> compressed, std::span<uint8_t> bytes);
+
+//
+// Hashed timer wheel. Timers are scheduled a number of ticks into the future and are bucketed
+// into slots by their due tick, so advancing the wheel a tick visits only the timers sharing
+// the slot of that tick; idle timers cost nothing. Timers due further ahead than a full turn
+// of the wheel wait in their slot until the wheel comes round to their due tick.
+//
+// Timers are plain data; an event id and a data value which are passed back to the handler
+// given to advance when the timer falls due. Timers due on the same tick fall due in the order
+// they were scheduled.
+//
+class TimerWheel
+{
+public:
+  using EventId_t = int32_t;
+  using Tick_t = uint64_t;
+
+  struct Timer
+  {
+    Tick_t _dueTick;
+    EventId_t _event;
+    int32_t _data;
+  };
+
+  static constexpr int32_t nullNode {-1};
+
+  //
+  // Refers to a scheduled timer so it can be cancelled in constant time. A handle goes stale
+  // when its timer falls due or is cancelled; cancelling through a stale handle is a no-op.
+  //
+  struct Handle
+  {
+    int32_t _node {nullNode};
+    uint32_t _generation {0};
+  };
+
+  static constexpr int32_t defaultSlotCount {256};
+
+public:
+  // predicate: slotCount is a power of 2.
+  explicit TimerWheel(int32_t slotCount = defaultSlotCount) :
+    _slots(slotCount),
+    _now{0},
+    _timerCount{0}
+  {
+    assert(slotCount > 0 && std::has_single_bit(static_cast<uint32_t>(slotCount)));
+  }
+
+  // Timers scheduled with a delay of less than 1 tick fall due on the next tick.
+  Handle schedule(int32_t delayTicks, EventId_t event, int32_t data = 0)
+  {
+    assert(event != cancelledEvent);
+    Tick_t dueTick = _now + std::max(delayTicks, 1);
+    int32_t node = allocateNode();
+    _nodes[node]._timer = {dueTick, event, data};
+    _nodes[node]._state = NODE_SCHEDULED;
+    link(getSlot(dueTick), node);
+    ++_timerCount;
+    return {node, _nodes[node]._generation};
+  }
+
+  // Cancels a timer, including one falling due in the current advance.
+  void cancel(Handle handle)
+  {
+    if(!isPending(handle))
+      return;
+    Node& node = _nodes[handle._node];
+    if(node._state == NODE_DUE){
+      node._timer._event = cancelledEvent;
+      return;
+    }
+    unlink(getSlot(node._timer._dueTick), handle._node);
+    freeNode(handle._node);
+    --_timerCount;
+  }
+
+  bool isPending(Handle handle) const
+  {
+    return 0 <= handle._node && handle._node < static_cast<int32_t>(_nodes.size()) && 
+           _nodes[handle._node]._state != NODE_FREE &&
+           _nodes[handle._node]._generation == handle._generation;
+  }
+
+  // Cancels all timers.
+  void clear()
+  {
+    for(int32_t node = 0; node < static_cast<int32_t>(_nodes.size()); ++node){
+      if(_nodes[node]._state == NODE_SCHEDULED)
+        freeNode(node);
+      else if(_nodes[node]._state == NODE_DUE)
+        _nodes[node]._timer._event = cancelledEvent;
+    }
+    for(auto& slot : _slots)
+      slot = Slot{};
+    _timerCount = 0;
+  }
+
+  // Advances the wheel a tick, calling handler(event, data) for each timer falling due. The
+  // handler may schedule and cancel timers.
+  template<typename Handler>
+  void advance(Handler&& handler)
+  {
+    ++_now;
+
+    Slot& slot = getSlot(_now);
+    if(slot._head == nullNode)
+      return;
+
+    // Move the due timers out of the slot first so the handler is free to schedule into it.
+    _due.clear();
+    for(int32_t node = slot._head; node != nullNode;){
+      int32_t next = _nodes[node]._next;
+      if(_nodes[node]._timer._dueTick == _now){
+        unlink(slot, node);
+        _nodes[node]._state = NODE_DUE;
+        _due.push_back(node);
+      }
+      node = next;
+    }
+    _timerCount -= _due.size();
+
+    for(size_t i = 0; i < _due.size(); ++i){
+      Timer timer = _nodes[_due[i]]._timer;
+      freeNode(_due[i]);
+      if(timer._event != cancelledEvent)
+        handler(timer._event, timer._data);
+    }
+    _due.clear();
+  }
+
+  // predicate: isPending(handle).
+  const Timer& getTimer(Handle handle) const {return _nodes[handle._node]._timer;}
+
+  // Calls fn(timer) for each pending timer, in no particular order.
+  template<typename Fn>
+  void forEach(Fn&& fn) const
+  {
+    for(const auto& node : _nodes)
+      if(node._state == NODE_SCHEDULED)
+        fn(node._timer);
+  }
+
+  Tick_t getNow() const {return _now;}
+  int32_t getTimerCount() const {return _timerCount;}
+
+  // Packs the clock, all pending timers and the node pool, so handles stay valid across a pack
+  // and unpack. Must not be called from within advance. Unpacking fails, returning false and
+  // leaving the wheel empty, if the packed wheel is malformed or has a different slot count.
+  void pack(ByteWriter& writer) const
+  {
+    assert(_due.empty());
+    writer.write(static_cast<int32_t>(_slots.size()));
+    writer.write(_now);
+    writer.write(static_cast<int32_t>(_nodes.size()));
+    for(const auto& node : _nodes)
+      writer.writeEach(node._timer._dueTick, node._timer._event, node._timer._data, 
+                       node._prev, node._next, node._generation, node._state);
+    writer.write(static_cast<int32_t>(_freeNodes.size()));
+    for(int32_t node : _freeNodes)
+      writer.write(node);
+    for(const auto& slot : _slots)
+      writer.writeEach(slot._head, slot._tail);
+  }
+
+  bool unpack(ByteReader& reader)
+  {
+    auto fail = [this]{
+      _nodes.clear();
+      _freeNodes.clear();
+      clear();
+      return false;
+    };
+
+    int32_t slotCount {0}, nodeCount {0}, freeCount {0};
+    if(!reader.read(slotCount) || slotCount != static_cast<int32_t>(_slots.size()) || 
+       !reader.read(_now) || !reader.read(nodeCount) || 
+       nodeCount < 0 || static_cast<size_t>(nodeCount) > reader.getRemaining() / packedNodeSize)
+      return fail();
+
+    _nodes.resize(nodeCount);
+    for(auto& node : _nodes)
+      if(!reader.readEach(node._timer._dueTick, node._timer._event, node._timer._data, 
+                          node._prev, node._next, node._generation, node._state))
+        return fail();
+
+    if(!reader.read(freeCount) || freeCount < 0 || freeCount > nodeCount)
+      return fail();
+    _freeNodes.resize(freeCount);
+    for(int32_t& node : _freeNodes)
+      if(!reader.read(node))
+        return fail();
+
+    for(auto& slot : _slots)
+      if(!reader.readEach(slot._head, slot._tail))
+        return fail();
+
+    // Every node must be on the free list or on the list of the slot of its due tick, once.
+    _isSeen.assign(nodeCount, false);
+    auto isFresh = [&](int32_t node){return 0 <= node && node < nodeCount && !_isSeen[node];};
+    for(int32_t node : _freeNodes){
+      if(!isFresh(node) || _nodes[node]._state != NODE_FREE)
+        return fail();
+      _isSeen[node] = true;
+    }
+    _timerCount = 0;
+    for(int32_t s = 0; s < slotCount; ++s){
+      int32_t prev {nullNode};
+      for(int32_t node = _slots[s]._head; node != nullNode; node = _nodes[node]._next){
+        if(!isFresh(node))
+          return fail();
+        const Node& n = _nodes[node];
+        if(n._state != NODE_SCHEDULED || n._prev != prev || n._timer._dueTick <= _now ||
+           static_cast<int32_t>(n._timer._dueTick & (slotCount - 1)) != s)
+          return fail();
+        _isSeen[node] = true;
+        prev = node;
+        ++_timerCount;
+      }
+      if(_slots[s]._tail != prev)
+        return fail();
+    }
+    if(std::find(_isSeen.begin(), _isSeen.end(), false) != _isSeen.end())
+      return fail();
+    return true;
+  }
+
+private:
+  static constexpr EventId_t cancelledEvent {std::numeric_limits<EventId_t>::min()};
+
+  //
+  // Timers are held in a pool of nodes, each slot a doubly linked list of its nodes in the 
+  // order they were scheduled, so both scheduling and cancelling through a handle are constant
+  // time. Freed nodes are reused last in first out.
+  //
+  enum NodeState : int32_t {NODE_FREE, NODE_SCHEDULED, NODE_DUE};
+
+  struct Node
+  {
+    Timer _timer;
+    int32_t _prev;
+    int32_t _next;
+    uint32_t _generation;     // Advanced each time the node is freed, staling its handles.
+    NodeState _state;
+  };
+
+  struct Slot
+  {
+    int32_t _head {nullNode};
+    int32_t _tail {nullNode};
+  };
+
+  static constexpr size_t packedNodeSize {sizeof(Tick_t) + (6 * sizeof(int32_t))};
+
+  Slot& getSlot(Tick_t tick) {return _slots[tick & (_slots.size() - 1)];}
+
+  int32_t allocateNode()
+  {
+    if(_freeNodes.empty()){
+      _nodes.push_back(Node{{0, cancelledEvent, 0}, nullNode, nullNode, 0, NODE_FREE});
+      return static_cast<int32_t>(_nodes.size()) - 1;
+    }
+    int32_t node = _freeNodes.back();
+    _freeNodes.pop_back();
+    return node;
+  }
+
+  void freeNode(int32_t node)
+  {
+    _nodes[node]._state = NODE_FREE;
+    ++_nodes[node]._generation;
+    _freeNodes.push_back(node);
+  }
+
+  void link(Slot& slot, int32_t node)
+  {
+    _nodes[node]._prev = slot._tail;
+    _nodes[node]._next = nullNode;
+    if(slot._tail == nullNode)
+      slot._head = node;
+    else
+      _nodes[slot._tail]._next = node;
+    slot._tail = node;
+  }
+
+  void unlink(Slot& slot, int32_t node)
+  {
+    Node& n = _nodes[node];
+    if(n._prev == nullNode)
+      slot._head = n._next;
+    else
+      _nodes[n._prev]._next = n._next;
+    if(n._next == nullNode)
+      slot._tail = n._prev;
+    else
+      _nodes[n._next]._prev = n._prev;
+  }
+
+private:
+  std::vector<Node> _nodes;
+  std::vector<int32_t> _freeNodes;
+  std::vector<Slot> _slots;
+  std::vector<int32_t> _due;
+  std::vector<bool> _isSeen;      // Scratch for validating an unpack, kept to reuse its storage.
+  Tick_t _now;
+  int32_t _timerCount;
+};
+
+//
+// Archetype entity component system. An entity is an id with a set of components, which are
+// plain (trivially copyable) data types registered with the store. Entities with the same set
+// of components, an archetype, are stored together as a packed array (column) per component,
+// so a query for some set of components runs over the contiguous columns of each archetype
+// having the set and visits only live entities.
+//
+// Structural changes (creating and destroying entities, adding and removing components) move
+// rows within and between columns so cannot be made whilst a query runs. Instead they can be
+// deferred to a command buffer, which flush applies in order. Deferred creates reserve their
+// entity id immediately so the id can be used before the flush.
+//
+// Queries visit archetypes in their order of creation and the rows of each in order (or both in
+// reverse order), and ids are recycled in a fixed order, so the same sequence of calls always
+// has the same results.
+//
+class EntityStore
+{
+public:
+  using Entity_t = int32_t;
+  using ComponentId_t = int32_t;
+
+  static constexpr Entity_t nullEntity {-1};
+  static constexpr int32_t maxComponents {64};
+
+public:
+  EntityStore() : _iterating{0}{}
+
+  // Component ids are assigned in order of registration so pack and unpack must be done by
+  // stores which registered the same components in the same order.
+  template<typename C>
+  void registerComponent()
+  {
+    static_assert(std::is_trivially_copyable_v<C>);
+    assert(static_cast<int32_t>(_componentSizes.size()) < maxComponents);
+    int32_t typeIndex = getTypeIndex<C>();
+    if(typeIndex >= static_cast<int32_t>(_componentIds.size()))
+      _componentIds.resize(typeIndex + 1, nullComponent);
+    assert(_componentIds[typeIndex] == nullComponent);
+    _componentIds[typeIndex] = static_cast<ComponentId_t>(_componentSizes.size());
+    _componentSizes.push_back(sizeof(C));
+  }
+
+  // Creates the archetype of the components Cs up front, if it does not exist, so the first
+  // entities of it do not allocate the archetype whilst running.
+  template<typename... Cs>
+  void addArchetype()
+  {
+    assert(_iterating == 0);
+    getArchetype((uint64_t{0} | ... | toComponentBit<Cs>()));
+  }
+
+  template<typename... Cs>
+  Entity_t create(const Cs&... components)
+  {
+    assert(_iterating == 0);
+    Entity_t entity = reserve();
+    insert(entity, components...);
+    return entity;
+  }
+
+  void destroy(Entity_t entity)
+  {
+    assert(_iterating == 0 && isAlive(entity));
+    Location& location = _locations[entity];
+    removeRow(*_archetypes[location._archetype], location._row);
+    location = {nullArchetype, 0};
+    _freeIds.push_back(entity);
+  }
+
+  template<typename C>
+  void addComponent(Entity_t entity, const C& component)
+  {
+    assert(_iterating == 0 && isAlive(entity) && !hasComponent<C>(entity));
+    uint64_t mask = _archetypes[_locations[entity]._archetype]->_mask | toComponentBit<C>();
+    Archetype& archetype = moveRow(entity, getArchetype(mask));
+    getColumn<C>(archetype)[_locations[entity]._row] = component;
+  }
+
+  template<typename C>
+  void removeComponent(Entity_t entity)
+  {
+    assert(_iterating == 0 && isAlive(entity) && hasComponent<C>(entity));
+    uint64_t mask = _archetypes[_locations[entity]._archetype]->_mask & ~toComponentBit<C>();
+    moveRow(entity, getArchetype(mask));
+  }
+
+  // The components of a deferred create are copied into the command buffer as a row, in 
+  // component id order, for flush to append to the columns of the archetype.
+  template<typename... Cs>
+  Entity_t deferCreate(const Cs&... components)
+  {
+    Entity_t entity = reserve();
+    uint64_t mask = (uint64_t{0} | ... | toComponentBit<Cs>());
+    assert(std::popcount(mask) == sizeof...(Cs));   // Components must be distinct.
+    int32_t offset = static_cast<int32_t>(_commandBytes.size());
+    _commandBytes.resize(offset + getRowSize(mask));
+    (std::memcpy(_commandBytes.data() + offset + getRowOffset(mask, getComponentId<Cs>()), 
+                 &components, sizeof(Cs)), ...);
+    _commands.push_back({COMMAND_CREATE, entity, mask, offset});
+    return entity;
+  }
+
+  void deferDestroy(Entity_t entity)
+  {
+    _commands.push_back({COMMAND_DESTROY, entity, 0, 0});
+  }
+
+  // Reserves the command buffer for a number of deferred changes, having deferred creates of 
+  // components totalling a number of bytes, so that deferring up to those does not allocate.
+  void reserveDeferred(int32_t commandCount, int32_t byteCount)
+  {
+    _commands.reserve(commandCount);
+    _commandBytes.reserve(byteCount);
+  }
+
+  // Applies the deferred changes in the order they were made.
+  void flush()
+  {
+    assert(_iterating == 0);
+    for(const auto& command : _commands){
+      if(command._type == COMMAND_DESTROY){
+        destroy(command._entity);
+        continue;
+      }
+      assert(_locations[command._entity]._archetype == pendingArchetype);
+      Archetype& archetype = getArchetype(command._mask);
+      int32_t row = appendRow(archetype, command._entity);
+      const uint8_t* bytes = _commandBytes.data() + command._offset;
+      for(auto& column : archetype._columns){
+        std::memcpy(column._bytes.data() + (row * column._elementSize), bytes, column._elementSize);
+        bytes += column._elementSize;
+      }
+    }
+    _commands.clear();
+    _commandBytes.clear();
+  }
+
+  // Destroys all entities (ids restart from 0) and drops any deferred changes.
+  void clear()
+  {
+    for(auto& archetype : _archetypes){
+      archetype->_entities.clear();
+      for(auto& column : archetype->_columns)
+        column._bytes.clear();
+    }
+    _locations.clear();
+    _freeIds.clear();
+    _commands.clear();
+    _commandBytes.clear();
+  }
+
+  bool isAlive(Entity_t entity) const
+  {
+    return 0 <= entity && entity < static_cast<Entity_t>(_locations.size()) && 
+           _locations[entity]._archetype >= 0;
+  }
+
+  template<typename C>
+  bool hasComponent(Entity_t entity) const
+  {
+    assert(isAlive(entity));
+    return _archetypes[_locations[entity]._archetype]->_mask & toComponentBit<C>();
+  }
+
+  template<typename C>
+  C& get(Entity_t entity)
+  {
+    assert(isAlive(entity) && hasComponent<C>(entity));
+    const Location& location = _locations[entity];
+    return getColumn<C>(*_archetypes[location._archetype])[location._row];
+  }
+
+  // Calls fn(entity, components...) for every entity having all the components Cs.
+  template<typename... Cs, typename Fn>
+  void each(Fn&& fn)
+  {
+    uint64_t mask = (toComponentBit<Cs>() | ...);
+    ++_iterating;
+    for(auto& archetype : _archetypes){
+      if((archetype->_mask & mask) != mask)
+        continue;
+      std::tuple<Cs*...> columns {getColumn<Cs>(*archetype)...};
+      int32_t rowCount = static_cast<int32_t>(archetype->_entities.size());
+      for(int32_t row = 0; row < rowCount; ++row)
+        fn(archetype->_entities[row], std::get<Cs*>(columns)[row]...);
+    }
+    --_iterating;
+  }
+
+  // As each but visits the archetypes, and the rows of each, in reverse order.
+  template<typename... Cs, typename Fn>
+  void eachReverse(Fn&& fn)
+  {
+    uint64_t mask = (toComponentBit<Cs>() | ...);
+    ++_iterating;
+    for(auto iter = _archetypes.rbegin(); iter != _archetypes.rend(); ++iter){
+      Archetype& archetype = **iter;
+      if((archetype._mask & mask) != mask)
+        continue;
+      std::tuple<Cs*...> columns {getColumn<Cs>(archetype)...};
+      for(int32_t row = static_cast<int32_t>(archetype._entities.size()) - 1; row >= 0; --row)
+        fn(archetype._entities[row], std::get<Cs*>(columns)[row]...);
+    }
+    --_iterating;
+  }
+
+  // Returns the number of entities having all the components Cs.
+  template<typename... Cs>
+  int32_t count() const
+  {
+    uint64_t mask = (toComponentBit<Cs>() | ...);
+    int32_t result {0};
+    for(const auto& archetype : _archetypes)
+      if((archetype->_mask & mask) == mask)
+        result += static_cast<int32_t>(archetype->_entities.size());
+    return result;
+  }
+
+  // Returns the number of deferred creates of entities having all the components Cs.
+  template<typename... Cs>
+  int32_t countDeferred() const
+  {
+    uint64_t mask = (toComponentBit<Cs>() | ...);
+    return static_cast<int32_t>(std::count_if(_commands.begin(), _commands.end(), [mask](const Command& command){
+      return command._type == COMMAND_CREATE && (command._mask & mask) == mask;
+    }));
+  }
+
+  //
+  // Packs all entities and their ids, with empty archetypes, so that queries visit entities
+  // in the same order after a pack and unpack. Must not be called with changes deferred. 
+  // Unpacking fails, returning false, if the packed store is malformed or has different 
+  // components; the store is then left cleared. Unpacking reuses the archetypes (and their 
+  // storage) which match those packed, so unpacking a store of the same shape does not allocate.
+  //
+  void pack(ByteWriter& writer) const
+  {
+    assert(_commands.empty());
+    writer.write(static_cast<int32_t>(_componentSizes.size()));
+    writer.writeBytes(_componentSizes.data(), _componentSizes.size() * sizeof(int32_t));
+    writer.write(static_cast<int32_t>(_locations.size()));
+    writer.write(static_cast<int32_t>(_freeIds.size()));
+    writer.writeBytes(_freeIds.data(), _freeIds.size() * sizeof(Entity_t));
+    writer.write(static_cast<int32_t>(_archetypes.size()));
+    for(const auto& archetype : _archetypes){
+      writer.write(archetype->_mask);
+      writer.write(static_cast<int32_t>(archetype->_entities.size()));
+      writer.writeBytes(archetype->_entities.data(), archetype->_entities.size() * sizeof(Entity_t));
+      for(const auto& column : archetype->_columns)
+        writer.writeBytes(column._bytes.data(), column._bytes.size());
+    }
+  }
+
+  bool unpack(ByteReader& reader)
+  {
+    clear();
+    if(!unpackStore(reader)){
+      clear();
+      return false;
+    }
+    return true;
+  }
+
+private:
+  static constexpr ComponentId_t nullComponent {-1};
+  static constexpr int32_t nullArchetype {-1};
+  static constexpr int32_t pendingArchetype {-2};   // Reserved by a deferred create.
+
+  struct Column
+  {
+    int32_t _elementSize;
+    std::vector<uint8_t> _bytes;
+  };
+
+  struct Archetype
+  {
+    uint64_t _mask;
+    std::vector<Entity_t> _entities;                     // Row -> entity.
+    std::vector<Column> _columns;                        // In component id order.
+    std::array<int8_t, maxComponents> _columnIndices;    // Component id -> column, or -1.
+    int32_t _index;
+  };
+
+  struct Location
+  {
+    int32_t _archetype;
+    int32_t _row;
+  };
+
+  enum CommandType { COMMAND_CREATE, COMMAND_DESTROY };
+
+  struct Command
+  {
+    CommandType _type;
+    Entity_t _entity;
+    uint64_t _mask;                                      // Components of a create.
+    int32_t _offset;                                     // Of a create's row in the buffer.
+  };
+
+private:
+  static int32_t makeTypeIndex()
+  {
+    static std::atomic<int32_t> next {0};
+    return next++;
+  }
+
+  // A process wide index for each component type, mapped to the ids of each store.
+  template<typename C>
+  static int32_t getTypeIndex()
+  {
+    static const int32_t index = makeTypeIndex();
+    return index;
+  }
+
+  template<typename C>
+  ComponentId_t getComponentId() const
+  {
+    int32_t typeIndex = getTypeIndex<C>();
+    assert(typeIndex < static_cast<int32_t>(_componentIds.size()) && _componentIds[typeIndex] != nullComponent);
+    return _componentIds[typeIndex];
+  }
+
+  template<typename C>
+  uint64_t toComponentBit() const {return uint64_t{1} << getComponentId<C>();}
+
+  template<typename C>
+  C* getColumn(Archetype& archetype) const
+  {
+    Column& column = archetype._columns[archetype._columnIndices[getComponentId<C>()]];
+    return reinterpret_cast<C*>(column._bytes.data());
+  }
+
+  Archetype& getArchetype(uint64_t mask)
+  {
+    auto iter = _archetypeIndices.find(mask);
+    if(iter != _archetypeIndices.end())
+      return *_archetypes[iter->second];
+
+    auto archetype = std::make_unique<Archetype>();
+    archetype->_mask = mask;
+    archetype->_columnIndices.fill(-1);
+    for(ComponentId_t id = 0; id < static_cast<ComponentId_t>(_componentSizes.size()); ++id){
+      if(!(mask & (uint64_t{1} << id)))
+        continue;
+      archetype->_columnIndices[id] = static_cast<int8_t>(archetype->_columns.size());
+      archetype->_columns.push_back({_componentSizes[id], {}});
+    }
+    archetype->_index = static_cast<int32_t>(_archetypes.size());
+    _archetypeIndices[mask] = archetype->_index;
+    _archetypes.push_back(std::move(archetype));
+    return *_archetypes.back();
+  }
+
+  int32_t getRowSize(uint64_t mask) const
+  {
+    int32_t size {0};
+    for(; mask != 0; mask &= mask - 1)
+      size += _componentSizes[std::countr_zero(mask)];
+    return size;
+  }
+
+  // The offset of a component within a row of the components of mask, in component id order.
+  int32_t getRowOffset(uint64_t mask, ComponentId_t id) const
+  {
+    return getRowSize(mask & ((uint64_t{1} << id) - 1));
+  }
+
+  // Drops the archetypes from count on; must only be called when the store is empty.
+  void truncateArchetypes(int32_t count)
+  {
+    while(static_cast<int32_t>(_archetypes.size()) > count){
+      _archetypeIndices.erase(_archetypes.back()->_mask);
+      _archetypes.pop_back();
+    }
+  }
+
+  Entity_t reserve()
+  {
+    Entity_t entity {};
+    if(!_freeIds.empty()){
+      entity = _freeIds.back();
+      _freeIds.pop_back();
+    }
+    else{
+      entity = static_cast<Entity_t>(_locations.size());
+      _locations.push_back({});
+    }
+    _locations[entity] = {pendingArchetype, 0};
+    return entity;
+  }
+
+  template<typename... Cs>
+  void insert(Entity_t entity, const Cs&... components)
+  {
+    assert(_locations[entity]._archetype == pendingArchetype);
+    uint64_t mask = (uint64_t{0} | ... | toComponentBit<Cs>());
+    assert(std::popcount(mask) == sizeof...(Cs));   // Components must be distinct.
+    Archetype& archetype = getArchetype(mask);
+    int32_t row = appendRow(archetype, entity);
+    ((getColumn<Cs>(archetype)[row] = components), ...);
+  }
+
+  int32_t appendRow(Archetype& archetype, Entity_t entity)
+  {
+    int32_t row = static_cast<int32_t>(archetype._entities.size());
+    archetype._entities.push_back(entity);
+    for(auto& column : archetype._columns)
+      column._bytes.resize(column._bytes.size() + column._elementSize);
+    _locations[entity] = {archetype._index, row};
+    return row;
+  }
+
+  // Moves the last row into the removed row to keep the columns packed.
+  void removeRow(Archetype& archetype, int32_t row)
+  {
+    int32_t last = static_cast<int32_t>(archetype._entities.size()) - 1;
+    if(row != last){
+      Entity_t moved = archetype._entities[last];
+      archetype._entities[row] = moved;
+      _locations[moved]._row = row;
+      for(auto& column : archetype._columns)
+        std::memcpy(column._bytes.data() + (row * column._elementSize), 
+                    column._bytes.data() + (last * column._elementSize), 
+                    column._elementSize);
+    }
+    archetype._entities.pop_back();
+    for(auto& column : archetype._columns)
+      column._bytes.resize(column._bytes.size() - column._elementSize);
+  }
+
+  // Moves an entity to another archetype, keeping the components the archetypes share.
+  Archetype& moveRow(Entity_t entity, Archetype& to)
+  {
+    Location from = _locations[entity];
+    Archetype& source = *_archetypes[from._archetype];
+    int32_t row = appendRow(to, entity);
+    for(ComponentId_t id = 0; id < static_cast<ComponentId_t>(_componentSizes.size()); ++id){
+      if(source._columnIndices[id] < 0 || to._columnIndices[id] < 0)
+        continue;
+      const Column& sourceColumn = source._columns[source._columnIndices[id]];
+      Column& toColumn = to._columns[to._columnIndices[id]];
+      std::memcpy(toColumn._bytes.data() + (row * toColumn._elementSize), 
+                  sourceColumn._bytes.data() + (from._row * sourceColumn._elementSize),
+                  toColumn._elementSize);
+    }
+    removeRow(source, from._row);
+    return to;
+  }
+
+  bool unpackStore(ByteReader& reader)
+  {
+    int32_t componentCount {0};
+    if(!reader.read(componentCount) || componentCount != static_cast<int32_t>(_componentSizes.size()))
+      return false;
+    for(int32_t id = 0; id < componentCount; ++id){
+      int32_t size {0};
+      if(!reader.read(size) || size != _componentSizes[id])
+        return false;
+    }
+
+    int32_t entityCount {0}, freeCount {0};
+    if(!reader.read(entityCount) || !reader.read(freeCount) || entityCount < 0 || freeCount < 0 ||
+       freeCount > entityCount || entityCount > static_cast<int64_t>(reader.getRemaining()))
+      return false;
+
+    _locations.assign(entityCount, {nullArchetype, 0});
+    _freeIds.resize(freeCount);
+    if(!reader.readBytes(_freeIds.data(), freeCount * sizeof(Entity_t)))
+      return false;
+    for(Entity_t entity : _freeIds)
+      if(entity < 0 || entity >= entityCount)
+        return false;
+
+    uint64_t componentsMask = (componentCount == maxComponents) ? ~uint64_t{0} : (uint64_t{1} << componentCount) - 1;
+    int32_t archetypeCount {0};
+    if(!reader.read(archetypeCount) || archetypeCount < 0)
+      return false;
+    int32_t liveCount {0};
+    for(int32_t i = 0; i < archetypeCount; ++i){
+      uint64_t mask {0};
+      int32_t rowCount {0};
+      if(!reader.read(mask) || (mask & ~componentsMask) || !reader.read(rowCount) || rowCount < 0 || 
+         rowCount > entityCount - liveCount)
+        return false;
+
+      // Reuse the archetype if it matches, else rebuild it and the rest.
+      if(i >= static_cast<int32_t>(_archetypes.size()) || _archetypes[i]->_mask != mask){
+        truncateArchetypes(i);
+        if(_archetypeIndices.contains(mask))
+          return false;
+        getArchetype(mask);
+      }
+      Archetype& archetype = *_archetypes[i];
+      archetype._entities.resize(rowCount);
+      if(!reader.readBytes(archetype._entities.data(), rowCount * sizeof(Entity_t)))
+        return false;
+      for(auto& column : archetype._columns){
+        column._bytes.resize(rowCount * column._elementSize);
+        if(!reader.readBytes(column._bytes.data(), column._bytes.size()))
+          return false;
+      }
+      for(int32_t row = 0; row < rowCount; ++row){
+        Entity_t entity = archetype._entities[row];
+        if(entity < 0 || entity >= entityCount || _locations[entity]._archetype != nullArchetype)
+          return false;
+        _locations[entity] = {archetype._index, row};
+      }
+      liveCount += rowCount;
+    }
+    truncateArchetypes(archetypeCount);
+
+    // Every id must be either live or free, and only once.
+    if(liveCount + freeCount != entityCount)
+      return false;
+    for(Entity_t entity : _freeIds){
+      if(_locations[entity]._archetype != nullArchetype)
+        return false;
+      _locations[entity]._archetype = pendingArchetype;   // Marks seen, for duplicates.
+    }
+    for(Entity_t entity : _freeIds)
+      _locations[entity]._archetype = nullArchetype;
+    return true;
+  }
+
+private:
+  std::vector<int32_t> _componentSizes;                 // Component id -> size.
+  std::vector<ComponentId_t> _componentIds;             // Type index -> component id.
+  std::vector<std::unique_ptr<Archetype>> _archetypes;
+  std::unordered_map<uint64_t, int32_t> _archetypeIndices;
+  std::vector<Location> _locations;                     // Entity -> location.
+  std::vector<Entity_t> _freeIds;
+  std::vector<Command> _commands;
+  std::vector<uint8_t> _commandBytes;                   // Component rows of deferred creates.
+  int32_t _iterating;
+};
+
+//
+// Runs the systems of a tick, functions which declare the resources (bits of a mask, defined by
+// the user) they read and write, concurrently where they do not conflict. Two systems conflict
+// if either writes a resource the other reads or writes. Each system depends on every system 
+// added before it which it conflicts with, so the systems form a DAG in which conflicting
+// systems keep the order they were added in; results are thus always the same as running the
+// systems serially in order, whatever the number of workers and however they interleave.
+//
+// Systems run on a pool of worker threads plus the thread calling run, which share the ready 
+// systems by work stealing; each thread pushes the systems readied by its own work onto its 
+// own queue and takes from the queues of others when it runs dry. The engine context (log, 
+// input, mixer, random generator etc) is thread local so a system which uses it must declare
+// the context resource; such systems always run on the calling thread.
+//
+// With no workers (the default) run simply calls the systems in order.
+//
+class Scheduler
+{
+public:
+  using Resources_t = uint64_t;
+  using System_t = std::function<void()>;
+
+  static constexpr Resources_t resourceContext {uint64_t{1} << 63};
+
+public:
+  explicit Scheduler(int32_t workerCount = 0);
+  ~Scheduler();
+
+  Scheduler(const Scheduler&) = delete;
+  Scheduler& operator=(const Scheduler&) = delete;
+
+  // Must not be called during run.
+  void addSystem(Resources_t reads, Resources_t writes, System_t system);
+
+  // Runs every system once; returns when all have finished.
+  void run();
+
+  int32_t getWorkerCount() const {return static_cast<int32_t>(_workers.size());}
+  int32_t getSystemCount() const {return static_cast<int32_t>(_systems.size());}
+
+private:
+  struct System
+  {
+    Resources_t _reads;
+    Resources_t _writes;
+    System_t _function;
+    std::vector<int32_t> _dependents;
+    int32_t _dependencyCount;
+  };
+
+  struct WorkQueue
+  {
+    std::mutex _mutex;
+    std::deque<int32_t> _systems;
+  };
+
+  static int32_t takeSystem(WorkQueue& queue, bool isFromBack);
+  void workerLoop(int32_t queue);
+  bool tryRunSystem(int32_t queue, bool isCaller);
+  void finishSystem(int32_t system, int32_t queue);
+  void pushSystem(int32_t system, int32_t queue);
+
+private:
+  std::vector<System> _systems;
+  std::unique_ptr<std::atomic<int32_t>[]> _pendingCounts;  // Dependencies left this run.
+  std::vector<std::unique_ptr<WorkQueue>> _queues;          // [0] is the caller's.
+  WorkQueue _contextQueue;                                  // Only the caller takes from it.
+  std::vector<std::thread> _workers;
+  std::atomic<int32_t> _remaining;                          // Systems left this run.
+  std::mutex _runMutex;
+  std::condition_variable _runCondition;
+  uint64_t _runGeneration;                                  // Guarded by _runMutex.
+  bool _isStopping;                                         // Guarded by _runMutex.
+};
+
 //===============================================================================================//
 // ##>MATH                                                                                       //
 //===============================================================================================//
@@ -151,6 +1196,58 @@ void Vector2f::normalize()
   }
 }
 
+//
+// A 16.16 fixed point number. Integer arithmetic is exact, so state kept in fixed point evolves
+// bit-identically on all compilers, optimisation levels and CPUs, unlike float state, which is
+// what replays and lockstep simulations need. Floats should only enter by conversion of 
+// constants, a single correctly rounded operation, and only leave for rendering.
+//
+struct Fixed
+{
+  using Raw_t = int32_t;
+  static constexpr int32_t fractionBits {16};
+  static constexpr Raw_t one {Raw_t{1} << fractionBits};
+
+  constexpr Fixed() : _raw{0} {}
+  constexpr explicit Fixed(int32_t value) : _raw{value * one} {}
+  explicit Fixed(float value) : _raw{static_cast<Raw_t>(std::lround(value * one))} {}
+
+  static constexpr Fixed fromRaw(Raw_t raw) {Fixed f {}; f._raw = raw; return f;}
+
+  constexpr int32_t toInt() const {return _raw >> fractionBits;}   // Rounds toward -infinity.
+  constexpr float toFloat() const {return _raw * (1.f / one);}
+
+  constexpr Fixed operator-() const {return fromRaw(-_raw);}
+  constexpr Fixed operator+(Fixed f) const {return fromRaw(_raw + f._raw);}
+  constexpr void operator+=(Fixed f) {_raw += f._raw;}
+  constexpr Fixed operator-(Fixed f) const {return fromRaw(_raw - f._raw);}
+  constexpr void operator-=(Fixed f) {_raw -= f._raw;}
+  constexpr Fixed operator*(Fixed f) const {return fromRaw((int64_t{_raw} * f._raw) >> fractionBits);}
+  constexpr Fixed operator*(int32_t scale) const {return fromRaw(_raw * scale);}
+  constexpr Fixed operator/(int32_t divisor) const {return fromRaw(_raw / divisor);}
+  constexpr auto operator<=>(const Fixed&) const = default;
+
+  Raw_t _raw;
+};
+
+struct Vector2x
+{
+  constexpr Vector2x() : _x{}, _y{} {}
+  constexpr Vector2x(Fixed x, Fixed y) : _x{x}, _y{y} {}
+  constexpr explicit Vector2x(const Vector2i& v) : _x{v._x}, _y{v._y} {}
+
+  constexpr Vector2x operator+(const Vector2x& v) const {return Vector2x{_x + v._x, _y + v._y};}
+  constexpr void operator+=(const Vector2x& v) {_x += v._x; _y += v._y;}
+  constexpr Vector2x operator-(const Vector2x& v) const {return Vector2x{_x - v._x, _y - v._y};}
+  constexpr void operator-=(const Vector2x& v) {_x -= v._x; _y -= v._y;}
+  constexpr Vector2x operator*(int32_t scale) const {return Vector2x{_x * scale, _y * scale};}
+  constexpr Vector2i toVector2i() const {return Vector2i{_x.toInt(), _y.toInt()};}
+  constexpr Vector2f toVector2f() const {return Vector2f{_x.toFloat(), _y.toFloat()};}
+
+  Fixed _x;
+  Fixed _y;
+};
+
 template<typename T>
 struct Rect
 {
@@ -191,10 +1288,71 @@ public:
 
   void seed(std::seed_seq& seq);
 
-  result_type operator()();
+  //
+  // Algorithm "xorwow" from p. 5 of Marsaglia, "Xorshift RNGs". Sequence generator from: 
+  // https://en.wikipedia.org/wiki/Xorshift
+  //
+  result_type operator()()
+  {
+    result_type t = _state[4];
+    result_type s = _state[0];
+    _state[4] = _state[3];
+    _state[3] = _state[2];
+    _state[2] = _state[1];
+    _state[1] = s;
+    t ^= t >> 2;
+    t ^= t << 1;
+    t ^= s ^ (s << 4);
+    _state[0] = t;
+    _state[5] += 362437;
+    return t + _state[5];
+  }
+
+  //
+  // Returns a value uniformly distributed on [0, range), without bias, by Lemire's multiply and
+  // reject method; the common case is a single multiply and the division needed to find the
+  // rejection threshold is only done when a rejection is possible.
+  //
+  result_type bounded(result_type range)
+  {
+    assert(range > 0);
+    uint64_t m = uint64_t{(*this)()} * range;
+    result_type low = static_cast<result_type>(m);
+    if(low < range){
+      result_type threshold = -range % range;
+      while(low < threshold){
+        m = uint64_t{(*this)()} * range;
+        low = static_cast<result_type>(m);
+      }
+    }
+    return static_cast<result_type>(m >> 32);
+  }
+
+  // Returns a value uniformly distributed on [0, 1) from the top 24 bits of a single draw.
+  float nextFloat() {return ((*this)() >> 8) * 0x1.0p-24f;}
+
+  // Returns a value uniformly distributed on [0, 1) from 53 bits of two draws.
+  double nextDouble()
+  {
+    uint64_t hi = (*this)() >> 5;
+    uint64_t lo = (*this)() >> 6;
+    return ((hi << 26) | lo) * 0x1.0p-53;
+  }
+
+  // Writes the next out.size() values of the sequence, same as calling operator() for each.
+  void fill(std::span<result_type> out);
 
   void discard(unsigned long long z);
 
+  //
+  // Advances the generator 2^64 steps in constant time (a 160-bit matrix-vector product). 
+  // Split returns a generator at the current position, then jumps this generator, thus 
+  // repeatedly splitting a generator yields independent non-overlapping streams of 2^64 values,
+  // e.g. one per simulation, which are reproducible from the seed of the root generator.
+  //
+  void jump();
+  xorwow split();
+
   static constexpr result_type min();
   static constexpr result_type max();
 
@@ -207,7 +1365,47 @@ private:
   state_type _state;
 };
 
-extern xorwow randGenerator;
+//
+// Eight xorwow generators, the lanes, stepped together with SIMD; AVX2 if the build targets it,
+// else SSE2, else plain loops, all giving the same values. A single xorwow cannot be vectorised
+// as every step depends on the last, so the lanes are instead split from a source generator,
+// making them independent streams. Output is lane-interleaved, value i coming from lane i % 8,
+// and is buffered a block at a time, so the sequence depends only on the source generator and
+// not on how it is divided between calls. Use for bulk needs, e.g. batch simulation or effects.
+//
+class xorwowx8
+{
+public:
+  using result_type = xorwow::result_type;
+
+  static constexpr int lane_count = 8;
+
+  xorwowx8() : xorwowx8(xorwow{}){}
+  explicit xorwowx8(xorwow source);
+
+  result_type operator()();
+
+  void fill(std::span<result_type> out);
+
+  // Fills with values uniformly distributed on [0, range), by xorwow::bounded's method.
+  void fillBounded(std::span<result_type> out, result_type range);
+
+  // Fills with values uniformly distributed on [lo, hi), by xorwow::nextFloat's method.
+  void fillFloat(std::span<float> out, float lo, float hi);
+
+private:
+  using Lanes_t = std::array<result_type, lane_count>;
+
+  // Writes blockCount blocks of lane_count values to out.
+  void generate(result_type* out, size_t blockCount);
+
+private:
+  std::array<Lanes_t, xorwow::state_size> _state;    // _state[word][lane].
+  Lanes_t _block;
+  int _blockNext;
+};
+
+extern thread_local xorwow randGenerator;
 
 //
 // Two engines are equal if their internal states are equivilent.
@@ -229,6 +1427,7 @@ unsigned int randUniformUnsignedInt(unsigned int lo, unsigned int hi);
 // returns a random real value uniformly distributed on the interval [li, hi).
 //
 double randUniformReal(double lo, double hi);
+float randUniformFloat(float lo, float hi);
 
 //===============================================================================================//
 // ##>LOG                                                                                        //
@@ -256,6 +1455,16 @@ namespace logstr
   constexpr const char* warn_cannot_play_sound = "failed to play a sound";
   constexpr const char* warn_cannot_load_sound = "failed to load a sound";
   constexpr const char* warn_missing_sound = "missing sound with key";
+  constexpr const char* warn_cannot_load_music = "failed to load music";
+  constexpr const char* warn_cannot_play_music = "failed to play music";
+  constexpr const char* warn_missing_music = "missing music with key";
+  constexpr const char* warn_invalid_shared_assets = "invalid shared asset cache";
+  constexpr const char* warn_cannot_create_shared_assets = "failed to create shared asset cache";
+  constexpr const char* warn_abandoned_shared_assets = "removing abandoned shared asset cache";
+  constexpr const char* warn_malformed_snapshot = "malformed game snapshot";
+  constexpr const char* warn_fleet_beats_floored = "fleet too small to scale cycle beats; aliens move faster than base rates";
+  constexpr const char* warn_cannot_open_recording = "failed to open session recording";
+  constexpr const char* warn_malformed_recording = "malformed session recording";
 
   constexpr const char* info_stderr_log = "logging to standard error";
   constexpr const char* info_using_default_config = "using default engine configuration";
@@ -281,6 +1490,11 @@ namespace logstr
   constexpr const char* info_skipping_asset_loading = "skipping asset loading";
   constexpr const char* info_ascii_code = "ascii code";
   constexpr const char* info_loaded_sound = "successfully loaded sound";
+  constexpr const char* info_loaded_music = "successfully opened music stream";
+  constexpr const char* info_created_shared_assets = "created shared asset cache";
+  constexpr const char* info_mapped_shared_assets = "loaded assets from shared cache";
+  constexpr const char* info_startup_phase = "startup phase";
+  constexpr const char* info_startup_report = "startup report";
 }; 
 
 class Log
@@ -304,13 +1518,72 @@ public:
   Log();
   ~Log();
 
+  // Thread safe; contexts on different threads may share a log.
   void log(Level level, const char* error, const std::string& addendum = std::string{});
 
 private:
   std::ofstream _os;
+  std::mutex _mutex;
 };
 
-extern std::unique_ptr<Log> log;
+extern thread_local std::shared_ptr<Log> log;
+
+//===============================================================================================//
+// ##>STARTUP REPORT                                                                             //
+//===============================================================================================//
+
+//
+// Records the wall time, bytes read and files opened by each phase of engine and application
+// startup. Phases can nest, e.g. 'app/bitmaps' within 'app'; the io of a nested phase is also
+// counted in all of its parents. Loaders report the files they open via recordFile.
+//
+// The report completes upon the first frame being shown, at which point it is written to the
+// log and as csv to the startup file (one row per phase, in the order the phases began).
+//
+
+class StartupReport
+{
+public:
+  using Clock_t = std::chrono::steady_clock;
+
+  static constexpr const char* filename {"startup"};
+  static constexpr const char* csvHeader {"phase,wall_ms,bytes_read,files_opened"};
+  static constexpr char phaseSeperator {'/'};
+
+public:
+  StartupReport();
+  ~StartupReport() = default;
+
+  void beginPhase(const std::string& name);
+  void endPhase();
+  void recordFile(const std::string& path);
+  void recordFirstShow();
+
+private:
+  struct Phase
+  {
+    std::string _name;
+    Clock_t::time_point _start;
+    double _wall_ms;
+    int64_t _bytesRead;
+    int32_t _filesOpened;
+  };
+
+  static double toMilliseconds(Clock_t::duration d);
+
+  void write();
+
+private:
+  Clock_t::time_point _start;
+  std::vector<Phase> _phases;
+  std::vector<size_t> _openPhases;   // indices into _phases, innermost last.
+};
+
+//
+// Only exists during the engine's startup; null once the report has been written, and always
+// null on the threads of headless contexts, which have no startup to report.
+//
+extern thread_local std::unique_ptr<StartupReport> startup;
 
 
 //===============================================================================================//
@@ -344,6 +1617,12 @@ public:
   bool isKeyPressed(KeyCode key) {return _keys[key]._isPressed;}
   bool isKeyReleased(KeyCode key) {return _keys[key]._isReleased;}
 
+  //
+  // Sets the state of a key without an SDL event, for driving input from code, e.g. bots. A 
+  // press or release is registered only if the state changes.
+  //
+  void setKeyState(KeyCode key, bool isDown);
+
   int32_t keyToAsciiCode(KeyCode key) const;
 
   const std::vector<KeyCode>& getHistory() const {return _history;}
@@ -356,7 +1635,7 @@ private:
   std::vector<KeyCode> _history;        // All keys pressed between calls to 'onUpdate'.
 };
 
-extern std::unique_ptr<Input> input;
+extern thread_local std::unique_ptr<Input> input;
 
 //===============================================================================================//
 // ##>RESOURCES                                                                                  //
@@ -442,7 +1721,16 @@ public:
   static constexpr const int32_t maxScale {8};
 
 public:
-  Assets() = default;
+  //
+  // If the shared cache is on, each manifest of decoded assets is packed into a named shared 
+  // memory segment by the first process to load it, and unpacked from that segment, without
+  // touching the asset files, by any other process on the host which loads the same manifest. 
+  // The segment name is derived from a hash of the manifest and the size and modify time of 
+  // every source file, so editing an asset file results in a new segment. Segments persist
+  // until the host restarts (or are removed from /dev/shm). A segment left unfinished by a
+  // builder which crashed, or which fails validation, is unlinked so the next load rebuilds it.
+  //
+  explicit Assets(bool isSharedCacheOn = false) : _isSharedCacheOn{isSharedCacheOn}, _isSealed{false}{}
   ~Assets() = default;
 
   Assets(const Assets&) = delete;
@@ -454,11 +1742,36 @@ public:
   void loadBitmaps(const Manifest_t& manifest);
   void loadFonts(const Manifest_t& manifest);
 
-  const Bitmap& getBitmap(Key_t key, Scale_t scale) const;
-  const Font& getFont(Key_t key, Scale_t scale) const;
+  //
+  // Sealed assets are read only, so may be shared by contexts on different threads. Loading into
+  // sealed assets is a silent no-op; everything in the manifest must already be loaded. Sealing
+  // regenerates the render bytes of all bitmaps, so getBytes on a sealed bitmap never writes.
+  //
+  void seal();
+  bool isSealed() const {return _isSealed;}
+
+  //
+  // Lookups are a single index into a flat table so they are cheap enough to call per entity
+  // per tick. The returned references are stable for the lifetime of the assets instance, so
+  // hot loops can also resolve them once and store the pointers.
+  //
+  const Bitmap& getBitmap(Key_t key, Scale_t scale) const
+  {
+    assert(isLoaded(_bitmaps, key, scale));
+    return *_bitmaps[tableIndex(key, scale)];
+  }
+
+  const Font& getFont(Key_t key, Scale_t scale) const
+  {
+    assert(isLoaded(_fonts, key, scale));
+    return *_fonts[tableIndex(key, scale)];
+  }
 
   Bitmap makeBlockBitmap(int32_t width, int32_t height);
 
+  // Makes a bitmap from rows of '0' and '1' chars; rows[0] is the bottom row.
+  Bitmap makeBitmap(std::vector<std::string> rows);
+
 private:
   static constexpr const char path_seperator = '/';
 
@@ -515,18 +1828,70 @@ private:
   };
 
 private:
+  struct SharedHeader
+  {
+    uint32_t _magic;
+    uint32_t _version;
+    uint64_t _sourceHash;
+    uint64_t _payloadSize;
+    uint64_t _checksum;          // hash of the payload.
+    int32_t _builderPid;         // process building the segment, for detecting crashed builds.
+    std::atomic<uint32_t> _isReady;
+  };
+
+  static constexpr uint32_t sharedMagic {0x50585241}; // 'PXRA'
+  static constexpr uint32_t sharedVersion {2};
+  static constexpr const char* sharedNamePrefix {"/pxr_assets_"};
+  static constexpr char sharedBitmapsTag {'b'};
+  static constexpr char sharedFontsTag {'f'};
+
+  // A segment not ready after this long is assumed orphaned by a builder which crashed.
+  static constexpr std::chrono::seconds sharedBuildTimeout {10};
+
+  using Unpacker_t = std::function<bool(ByteReader&)>;
+
+private:
+  std::string makeBitmapPath(const std::string& path, const std::string& name) const;
+  std::string makeFontBasePath(const std::string& name) const;
+
+  uint64_t hashSources(char tag, const Manifest_t& manifest) const;
+  std::string makeSharedName(char tag, uint64_t sourceHash) const;
+  bool readShared(const std::string& name, uint64_t sourceHash, const Unpacker_t& unpacker);
+  void writeShared(const std::string& name, uint64_t sourceHash, const std::vector<uint8_t>& payload);
+
+  std::vector<uint8_t> packBitmaps(const Manifest_t& manifest) const;
+  std::vector<uint8_t> packFonts(const Manifest_t& manifest) const;
+  bool unpackBitmaps(ByteReader& reader);
+  bool unpackFonts(ByteReader& reader);
+
   Bitmap loadBitmap(std::string path, std::string name, Scale_t scale = 1);
   Font loadFont(std::string name, Scale_t scale = 1);
   Bitmap generateErrorBitmap(Scale_t scale);
   Font generateErrorFont(Scale_t scale);
   Glyph generateErrorGlyph(int32_t asciiCode, Scale_t scale);
 
+  static size_t tableIndex(Key_t key, Scale_t scale) {return (key * maxScale) + scale;}
+
+  template<typename T>
+  static bool isLoaded(const std::vector<std::unique_ptr<T>>& table, Key_t key, Scale_t scale)
+  {
+    size_t index = tableIndex(key, scale);
+    return 0 <= key && scale < maxScale && index < table.size() && table[index] != nullptr;
+  }
+
 private:
-  std::unordered_map<Key_t, std::array<std::unique_ptr<Bitmap>, maxScale>> _bitmaps;
-  std::unordered_map<Key_t, std::array<std::unique_ptr<Font>, maxScale>> _fonts;
+  //
+  // Asset keys are expected to be small dense enums, thus assets are stored in flat tables 
+  // indexed by [key * maxScale + scale]; empty slots are null.
+  //
+  std::vector<std::unique_ptr<Bitmap>> _bitmaps;
+  std::vector<std::unique_ptr<Font>> _fonts;
+
+  bool _isSharedCacheOn;
+  bool _isSealed;
 };
 
-extern std::unique_ptr<Assets> assets;
+extern thread_local std::shared_ptr<Assets> assets;
 
 //===============================================================================================//
 // ##>GRAPHICS                                                                                   //
@@ -556,6 +1921,10 @@ class Bitmap final
   friend Assets;
 
 public:
+  enum StampOp { STAMP_OR, STAMP_XOR, STAMP_AND_NOT };
+
+public:
+  Bitmap(int32_t width, int32_t height);   // A blank bitmap, e.g. to stamp others into.
   Bitmap(const Bitmap&) = default;
   Bitmap(Bitmap&&) = default;
   Bitmap& operator=(const Bitmap&) = default;
@@ -565,41 +1934,135 @@ public:
   bool getBit(int32_t row, int32_t col) const;
   int32_t getWidth() const {return _width;}
   int32_t getHeight() const {return _height;}
-  const std::vector<uint8_t>& getBytes() const {return _bytes;}
 
-  void setBit(int32_t row, int32_t col, bool value, bool regen = true);
-  void setRect(int32_t rowMin, int32_t colMin, int32_t rowMax, int32_t colMax, bool value, bool regen = true);
-  
-  void regenerateBytes();
+  // Regenerates the render bytes of any rows mutated since the last call.
+  const std::vector<uint8_t>& getBytes() const {regenerateBytes(); return _bytes;}
 
-  bool isEmpty();
-  bool isApproxEmpty(int32_t threshold);
+  void setBit(int32_t row, int32_t col, bool value);
+  void setRect(int32_t rowMin, int32_t colMin, int32_t rowMax, int32_t colMax, bool value);
+  void clear();
+
+  //
+  // Combines the set bits of a mask bitmap into this bitmap, with the mask's bottom-left pixel
+  // at offset in this bitmap's coordinate space. Mask bits falling outside this bitmap are 
+  // ignored. Operates a word at a time. Returns the number of pixels changed.
+  //
+  int32_t stamp(const Bitmap& mask, Vector2i offset, StampOp op);
+
+  //
+  // Mutations only mark the rows they touch as dirty; the render bytes of dirty rows are 
+  // regenerated lazily on the next call to getBytes, or explicitly by calling this.
+  //
+  void regenerateBytes() const;
+
+  // Set pixel counts are maintained by all mutations so these are constant time.
+  int32_t getPixelCount() const {return _pixelCount;}
+  int32_t getRowPixelCount(int32_t row) const {return _rowPixelCounts[row];}
+
+  // Returns the first set column in [colMin, colMax] of a row, or -1 if none are set.
+  int32_t findSetBit(int32_t row, int32_t colMin, int32_t colMax) const;
+  bool isEmpty() const {return _pixelCount == 0;}
+  bool isApproxEmpty(int32_t threshold) const {return _pixelCount <= threshold;}
+
+  //
+  // Packs the bit words. Unpacking restores bits packed from a bitmap of the same size, failing,
+  // returning false and clearing all bits, if the sizes differ or the data is malformed.
+  //
+  void pack(ByteWriter& writer) const;
+  bool unpack(ByteReader& reader);
 
   void print(std::ostream& out) const;
 
+  //
+  // Observation kernels; reduce bitmaps to small images in a caller buffer without rendering.
+  // Both pool factor x factor blocks of pixels, the factor a power of 2 up to 8, into an image
+  // of getPooledSize(width) by getPooledSize(height) pixels in the row order of the bitmap. 
+  // poolBits ORs each block to 1 bit per pixel, in rows laid out as the render bytes. poolGray
+  // maps planes of equal size, one per palette color, to a byte per pixel; the max of the grays
+  // of the planes with a pixel set in the block, else 0.
+  //
+  static int32_t getPooledSize(int32_t size, int32_t factor) {return (size + factor - 1) / factor;}
+  void poolBits(int32_t factor, std::span<uint8_t> out) const;
+  static void poolGray(std::span<const Bitmap> planes, std::span<const uint8_t> grays, 
+                       int32_t factor, std::span<uint8_t> out);
+
 private:
   Bitmap() = default;
 
   void initialize(std::vector<std::string> bits, int32_t scale = 1);
+  void initialize(const uint8_t* bytes, int32_t width, int32_t height);
+
+  void markDirtyRows(int32_t rowMin, int32_t rowMax);
+  void countPixels();
+
+  static constexpr int32_t wordBits {64};
+
+  uint64_t* getRowWords(int32_t row) {return _words.data() + (row * _rowWords);}
+  const uint64_t* getRowWords(int32_t row) const {return _words.data() + (row * _rowWords);}
+  uint64_t getColumnBit(int32_t col) const {return uint64_t{1} << (wordBits - 1 - (col % wordBits));}
+  uint64_t getLastWordMask() const;
+  bool poolRow(int32_t row, int32_t factor, uint64_t* orWords, uint8_t* outBits) const;
 
 private:
-  std::vector<std::vector<bool>> _bits;  // used for bit manipulation ops - indexed [row][col]
-  std::vector<uint8_t> _bytes;           // used for rendering
+  //
+  // Bits are stored as rows of 64-bit words, used for bit manipulation ops. Column 0 of a row is
+  // the most significant bit of the row's first word, thus the bytes of each word, most 
+  // significant first, are the render bytes. Bits past the width in the last word of a row 
+  // are always 0.
+  //
+  std::vector<uint64_t> _words;
+  mutable std::vector<uint8_t> _bytes;   // used for rendering
+  mutable int32_t _dirtyRowMin;          // Dirty rows are [min, max]; none if min > max.
+  mutable int32_t _dirtyRowMax;
+  std::vector<int32_t> _rowPixelCounts;  // Set pixels in each row.
+  int32_t _pixelCount;                   // Set pixels in the bitmap.
   int32_t _width;
   int32_t _height;
+  int32_t _rowWords;                     // Words per row.
+};
+
+//
+// A ring of the last k frames (observations) of a fixed size, held so the frames, oldest first,
+// are always contiguous; a push writes the frame at its slot and again k slots on, unless it is
+// the last slot, so no copy is needed to read the stack.
+//
+class FrameStack
+{
+public:
+  FrameStack(int32_t frameCount, int32_t frameSize);
+
+  void push(std::span<const uint8_t> frame);
+  void fill(std::span<const uint8_t> frame);   // Sets every frame, e.g. on a reset.
+
+  std::span<const uint8_t> getFrames() const;
+  int32_t getFrameCount() const {return _frameCount;}
+  int32_t getFrameSize() const {return _frameSize;}
+
+private:
+  std::vector<uint8_t> _frames;    // 2k - 1 frames.
+  int32_t _frameCount;
+  int32_t _frameSize;
+  int32_t _newest;                 // Slot of the newest frame, in [0, k).
 };
 
 struct Glyph // note -- cannot nest in font as it needs to be forward declared.
 {
-  Bitmap _bitmap;
   int32_t _asciiCode;
   int32_t _offsetX;
   int32_t _offsetY;
   int32_t _advance;
   int32_t _width;
   int32_t _height;
+  int32_t _atlasOffset;   // Byte offset of the glyph's bitmap rows in the font atlas.
 };
 
+//
+// All glyph bitmaps of a font are packed into a single contiguous atlas, each glyph stored as
+// rows of ceil(width / 8) bytes in the layout expected by glBitmap. Glyph metrics are held in
+// a table with an entry for every byte value so any char can be looked up safely; chars
+// without a glyph have zero size and a pen advance of zero.
+//
+
 class Font
 {
   friend class Assets;
@@ -619,21 +2082,30 @@ public:
   Font& operator=(const Font&) = default;
   Font& operator=(Font&&) = default;
 
-  const Glyph& getGlyph(char c) const {return _glyphs[static_cast<int32_t>(c - '!')];}
+  static constexpr int32_t glyphTableSize {256};
+
+public:
+  const Glyph& getGlyph(char c) const {return _glyphs[static_cast<uint8_t>(c)];}
+  const uint8_t* getGlyphBytes(const Glyph& g) const {return _atlas.data() + g._atlasOffset;}
+
+  // The distance the pen moves after drawing a char, including the glyph or word spacing.
+  int32_t getPenAdvance(char c) const {return _penAdvances[static_cast<uint8_t>(c)];}
+
   int32_t getLineSpace() const {return _meta._lineSpace;}
   int32_t getWordSpace() const {return _meta._wordSpace;}
   int32_t getGlyphSpace() const {return _meta._glyphSpace;}
   int32_t getSize() const {return _meta._size;}
 
-  int32_t calculateStringWidth(const std::string& str) const;
+  int32_t calculateStringWidth(std::string_view str) const;
 
 private:
   Font() = default;
-  void initialize(Meta meta, std::vector<Glyph> glyphs);
-
+  void initialize(Meta meta, const std::vector<Glyph>& glyphs, const std::vector<Bitmap>& bitmaps);
 
 private:
-  std::vector<Glyph> _glyphs;
+  std::vector<uint8_t> _atlas;
+  std::array<Glyph, glyphTableSize> _glyphs;
+  std::array<int32_t, glyphTableSize> _penAdvances;
   Meta _meta;
 };
 
@@ -659,6 +2131,7 @@ public:
   float getRed() const {return _r;}
   float getGreen() const {return _g;}
   float getBlue() const {return _b;}
+  uint8_t getGray() const {return static_cast<uint8_t>(std::lround(255.f * ((0.299f * _r) + (0.587f * _g) + (0.114f * _b))));}
   void setRed(float r){_r = std::clamp(r, lo, hi);}
   void setGreen(float g){_g = std::clamp(g, lo, hi);}
   void setBlue(float b){_b = std::clamp(b, lo, hi);}
@@ -727,7 +2200,7 @@ private:
   iRect _viewport;
 };
 
-extern std::unique_ptr<Renderer> renderer;
+extern thread_local std::unique_ptr<Renderer> renderer;
 
 //===============================================================================================//
 // ##>COLLISION DETECTION                                                                        //
@@ -812,6 +2285,24 @@ struct Collision
 const Collision& testCollision(Vector2i aPosition, const Bitmap& aBitmap, 
                                Vector2i bPosition, const Bitmap& bBitmap, bool pixelLists = true);
 
+//
+// Swept column test. Tests a solid column of pixels, with left edge at screen x and the given
+// width, swept vertically over the screen rows [yMin, yMax], against a bitmap at position. The
+// sweep either ascends, meeting the lowest rows first, or descends. The result is the first
+// pixel of the bitmap met by the sweep. This allows thin fast moving sprites to be tested over
+// the whole distance they moved in a tick, rather than only at their position at the tick, so
+// they cannot tunnel through other sprites.
+//
+struct ColumnSweep
+{
+  bool _isHit;
+  Vector2i _pixel;      // The first pixel met w.r.t the bitmap's coordinate space.
+  int32_t _screenY;     // The row of the pixel met w.r.t screen space.
+};
+
+ColumnSweep testColumnSweep(int32_t x, int32_t width, int32_t yMin, int32_t yMax, 
+                            Vector2i position, const Bitmap& bitmap, bool isAscending = true);
+
 //===============================================================================================//
 // ##>MIXER                                                                                      //
 //===============================================================================================//
@@ -832,15 +2323,26 @@ public:
 
   static constexpr const char* sounds_path = "assets/sounds/";
   static constexpr const char* sounds_extension = ".wav";
+  static constexpr const char* music_extension = ".mpeg";
 
   static constexpr Channel_t allChannels = -1;
   static constexpr Channel_t nullChannel = -2;
 
-  Mixer();  
+  static constexpr int loopForever = -1;
+
+  // A headless mixer opens no audio device and loads and plays nothing; all calls are no-ops.
+  explicit Mixer(bool isHeadless = false);  
   ~Mixer();
 
   void loadSoundsWAV(const Manifest_t& manifest);
 
+  //
+  // Music is streamed; loading only opens the file and music is decoded a buffer at a time by
+  // the SDL audio thread as it plays, so long tracks cost neither big PCM buffers in memory 
+  // nor decode stalls on the game thread. Only one music track can play at a time.
+  //
+  void loadMusic(const Manifest_t& manifest);
+
   Channel_t playSound(Key_t sndkey, int loops = 0);
   Channel_t playSoundTimed(Key_t sndkey, int loops, int timeLimit_ms);
   Channel_t playSoundFadeIn(Key_t sndkey, int loops, int fadeInTime_ms);
@@ -853,15 +2355,49 @@ public:
   void setVolume(float volume); // value from 0 to 1.
   int getVolume() const {return _volume;}
 
+  void playMusic(Key_t muskey, int loops = loopForever, int fadeInTime_ms = 0);
+
+  //
+  // Fades out any playing music then fades in the new music. The switch happens when the 
+  // fade out completes, which is detected in onUpdate, so onUpdate must be called regularly.
+  //
+  void crossfadeMusic(Key_t muskey, int fadeTime_ms, int loops = loopForever);
+
+  void fadeOutMusic(int fadeOutTime_ms);
+  void stopMusic();
+  void pauseMusic();
+  void resumeMusic();
+  bool isMusicPlaying() const;
+
+  void setMusicVolume(float volume); // value from 0 to 1.
+  float getMusicVolume() const {return _musicVolume;}
+
+  void onUpdate();
+
 private:
   Mix_Chunk* findChunk(Key_t sndkey);
+  Mix_Music* findMusic(Key_t muskey);
+
+  static void onMusicFinished();
 
 private:
   std::unordered_map<Key_t, Mix_Chunk*> _sounds;
+  std::unordered_map<Key_t, Mix_Music*> _music;
   float _volume;
+  float _musicVolume;
+
+  Key_t _queuedMusic;
+  int _queuedLoops;
+  int _queuedFadeInTime_ms;
+  bool _isMusicQueued;
+
+  bool _isHeadless;
+
+  // Set from the SDL audio thread, which cannot call back into the mixer itself.
+  static std::atomic<bool> _isMusicFinished;
 };
 
-extern std::unique_ptr<Mixer> mixer;
+extern thread_local std::unique_ptr<Mixer> mixer;
 
 //===============================================================================================//
 // ##>UI                                                                                         //
@@ -1066,6 +2602,7 @@ public:
   Application() = default;
   virtual ~Application() = default;
   
+  // The engine is null for headless instances run in a Context.
   virtual bool initialize(Engine* engine, int32_t windowWidth, int32_t windowHeight);
 
   virtual std::string getName() const = 0;
@@ -1077,6 +2614,7 @@ public:
   virtual void onDraw(double now, float dt);
 
   void switchState(const std::string& name);
+  std::string getActiveStateName() const {return (*_activeState)->getName();}
 
   bool isWindowTooSmall() const {return _isWindowTooSmall;}
 
@@ -1100,6 +2638,30 @@ private:
 // ##>ENGINE                                                                                     //
 //===============================================================================================//
 
+//
+// The engine services (log, startup report, input, mixer, renderer, assets and the random 
+// number generator) are thread local so each thread can host its own application instance. The
+// engine creates the services of the thread it runs on. A context creates the services of the
+// thread it is constructed on for a headless instance, i.e. one with no renderer and a silent
+// mixer and no startup report, driven by calling the application's onUpdate directly, and
+// destroys them when it is destroyed, thus a context must be destroyed on the thread which
+// constructed it.
+//
+// Contexts on different threads may share a log and sealed assets (see Assets::seal).
+//
+class Context
+{
+public:
+  Context(std::shared_ptr<Log> sharedLog, std::shared_ptr<Assets> sharedAssets, xorwow::result_type seed);
+  ~Context();
+
+  Context(const Context&) = delete;
+  Context& operator=(const Context&) = delete;
+
+private:
+  std::thread::id _threadId;
+};
+
 class Engine
 {
 public:
@@ -1211,6 +2773,7 @@ public:
       KEY_FULLSCREEN, 
       KEY_OPENGL_MAJOR, 
       KEY_OPENGL_MINOR,
+      KEY_SHARED_ASSETS,
     };
 
     Config() : Dataset({
@@ -1219,7 +2782,8 @@ public:
       {KEY_WINDOW_HEIGHT, "windowHeight", {500},   {300},   {1000}},
       {KEY_FULLSCREEN,    "fullscreen",   {false}, {false}, {true}},
       {KEY_OPENGL_MAJOR,  "openglMajor",  {2},     {2},     {2},  },
-      {KEY_OPENGL_MINOR,  "openglMinor",  {1},     {1},     {1},  }
+      {KEY_OPENGL_MINOR,  "openglMinor",  {1},     {1},     {1},  },
+      {KEY_SHARED_ASSETS, "sharedAssets", {false}, {false}, {true}}
     }){}
   };
 
@@ -0,0 +1,101 @@
+#ifndef _SI_ENV_H_
+#define _SI_ENV_H_
+
+/*
+ * C interface to the space invaders reinforcement learning environment (see class Env in 
+ * spaceinvaders.h), for agents written in other languages. Link against libsi.so (make libsi.so)
+ * and run from the game directory, as the assets are loaded from it.
+ *
+ * An env may only be used on the thread which created it. Each thread is given a headless 
+ * engine context when it first creates an env, unless it already has one. Resets and steps 
+ * reuse the env's storage, which grows only while the first episodes reach new highs (of bombs,
+ * timers etc), after which they do not allocate. Observations are copied into caller owned 
+ * buffers of si_env_observation_size bytes, which may be null to skip the copy.
+ */
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SI_ENV_ABI_VERSION 3
+
+typedef struct si_env si_env;
+typedef struct si_batch si_batch;
+
+enum si_observation_type
+{
+  SI_OBSERVATION_FRAME = 0,      /* 1 bit per pixel playfield; rows of ceil(width / 8) bytes,  */
+                                 /* bottom row first, leftmost pixel in the msb.               */
+  SI_OBSERVATION_FEATURES = 1,   /* floats; see GameState::writeFeatures.                      */
+  SI_OBSERVATION_GRAY = 2        /* a gray byte per pixel, rows of width bytes, bottom first.  */
+};
+
+/*
+ * Frame and gray observations are pooled down by pool_factor (1, 2, 4 or 8), a pixel being set,
+ * or taking the brightest gray, if any in its block is; the frame width and height are those 
+ * pooled. Observations are the last stack_count (>= 1) observations, oldest first, a reset 
+ * filling the stack with the first.
+ */
+typedef struct si_env_options
+{
+  int32_t observation_type;
+  int32_t ticks_per_step;
+  int32_t pool_factor;
+  int32_t stack_count;
+} si_env_options;
+
+enum si_action
+{
+  SI_ACTION_NOOP, SI_ACTION_LEFT, SI_ACTION_RIGHT, SI_ACTION_FIRE, SI_ACTION_LEFT_FIRE, 
+  SI_ACTION_RIGHT_FIRE, SI_ACTION_COUNT
+};
+
+int32_t si_env_abi_version(void);
+
+/* Return null if the observation type or any option is invalid, or the options are null. */
+si_env* si_env_create(int32_t observation_type, int32_t ticks_per_step);
+si_env* si_env_create_with(const si_env_options* options);
+si_env* si_env_clone(const si_env* env);
+void si_env_destroy(si_env* env);
+
+int32_t si_env_observation_size(const si_env* env);
+int32_t si_env_frame_width(const si_env* env);
+int32_t si_env_frame_height(const si_env* env);
+
+void si_env_reset(si_env* env, uint32_t seed, void* observation);
+
+/* Returns 1 if the game is over, 0 if not, and -1 if the action is invalid. */
+int32_t si_env_step(si_env* env, int32_t action, void* observation, int32_t* reward);
+
+/*
+ * A batch of envs stepped in lockstep on thread_count worker threads (see class BatchEnv). The
+ * observations of the batch are contiguous, env i's at byte i * si_batch_observation_size; the
+ * observation, reward and done arrays are owned by the batch and overwritten by each reset and
+ * step. An env whose game ends in a step is reset within it. A batch may be used from any one 
+ * thread at a time, which needs no context of its own. Creating a batch returns null as creating
+ * an env does, or if either count is less than 1.
+ */
+si_batch* si_batch_create(int32_t env_count, int32_t observation_type, int32_t ticks_per_step, 
+                          int32_t thread_count);
+si_batch* si_batch_create_with(int32_t env_count, const si_env_options* options, int32_t thread_count);
+void si_batch_destroy(si_batch* batch);
+
+int32_t si_batch_env_count(const si_batch* batch);
+int32_t si_batch_observation_size(const si_batch* batch);
+
+void si_batch_reset(si_batch* batch, uint32_t seed);
+
+/* Takes an action per env; returns -1, stepping none, if any is invalid, else 0. */
+int32_t si_batch_step(si_batch* batch, const int32_t* actions);
+
+const void* si_batch_observations(const si_batch* batch);
+const int32_t* si_batch_rewards(const si_batch* batch);
+const uint8_t* si_batch_dones(const si_batch* batch);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,5 +1,6 @@
 #include "pixiretro.h"
 #include "spaceinvaders.h"
+#include "si_env.h"
 
 //===============================================================================================//
 // ##>SPACE INVADERS                                                                             //
@@ -25,20 +26,36 @@ bool SpaceInvaders::initialize(Engine* engine, int32_t windowWidth, int32_t wind
   for(int32_t i = BMK_CANNON0; i < BMK_COUNT; ++i)
     manifest.push_back({i, _bitmapNames[i], _worldScale}); 
 
+  if(pxr::startup) pxr::startup->beginPhase("bitmaps");
   pxr::assets->loadBitmaps(manifest);
+  if(pxr::startup) pxr::startup->endPhase();
 
   manifest.clear();
   manifest.push_back({fontKey, fontName, _worldScale});
+  if(pxr::startup) pxr::startup->beginPhase("fonts");
   pxr::assets->loadFonts(manifest);
+  if(pxr::startup) pxr::startup->endPhase();
 
   Mixer::Manifest_t mixmanifest{};
   for(int32_t i = SK_EXPLOSION; i < SK_COUNT; ++i)
     mixmanifest.push_back({i, _soundNames[i]});
 
+  if(pxr::startup) pxr::startup->beginPhase("hiscores");
   loadHiScores();
   updateHudHiScore();
+  if(pxr::startup) pxr::startup->endPhase();
 
+  if(pxr::startup) pxr::startup->beginPhase("sounds");
   pxr::mixer->loadSoundsWAV(mixmanifest);
+  if(pxr::startup) pxr::startup->endPhase();
+
+  mixmanifest.clear();
+  for(int32_t i = MK_THEME; i < MK_COUNT; ++i)
+    mixmanifest.push_back({i, _musicNames[i]});
+
+  if(pxr::startup) pxr::startup->beginPhase("music");
+  pxr::mixer->loadMusic(mixmanifest);
+  if(pxr::startup) pxr::startup->endPhase();
 
   _isHudVisible = false;
   _hud.initialize(&(pxr::assets->getFont(fontKey, _worldScale)), flashPeriod, phasePeriod);
@@ -69,15 +86,16 @@ bool SpaceInvaders::initialize(Engine* engine, int32_t windowWidth, int32_t wind
   std::unique_ptr<ApplicationState> scoreBoard = std::make_unique<HiScoreBoardState>(this);
   std::unique_ptr<ApplicationState> sos = std::make_unique<SosState>(this);
 
-  game->initialize(_worldSize, _worldScale);
-  menu->initialize(_worldSize, _worldScale);
-  splash->initialize(_worldSize, _worldScale);
-  scoreReg->initialize(_worldSize, _worldScale);
-  scoreBoard->initialize(_worldSize, _worldScale);
-  sos->initialize(_worldSize, _worldScale);
+  for(auto* state : {game.get(), menu.get(), splash.get(), scoreReg.get(), scoreBoard.get(), sos.get()}){
+    if(pxr::startup) pxr::startup->beginPhase(std::string{"state "} + state->getName());
+    state->initialize(_worldSize, _worldScale);
+    if(pxr::startup) pxr::startup->endPhase();
+  }
+
+  _gameState = static_cast<GameState*>(game.get());
 
   // a bodge! dont look! its really ugly! :) ... your still looking! I warned you, you'll regret it!
-  static_cast<SosState*>(sos.get())->_gameState = static_cast<GameState*>(game.get());
+  static_cast<SosState*>(sos.get())->_gameState = _gameState;
 
   addState(std::move(game));
   addState(std::move(menu));
@@ -468,9 +486,31 @@ void GameState::BeatBox::setBeatFreq(float freq_hz)
   _beatPeriod_s = 1 / _beatFreq_hz;
 }
 
+void GameState::BeatBox::pack(ByteWriter& writer) const
+{
+  writer.write(_nextBeat);
+  writer.write(_beatFreq_hz);
+  writer.write(_beatPeriod_s);
+  writer.write(_beatClock_s);
+  writer.write(_isPaused);
+}
+
+bool GameState::BeatBox::unpack(ByteReader& reader)
+{
+  return reader.read(_nextBeat) && reader.read(_beatFreq_hz) && reader.read(_beatPeriod_s) &&
+         reader.read(_beatClock_s) && reader.read(_isPaused) && 0 <= _nextBeat && _nextBeat < beatCount;
+}
+
 GameState::GameState(Application* app) : 
   ApplicationState{app}
-{}
+{
+  for(EntityStore* entities : {&_entities, &_snapshotLoad._entities}){
+    entities->registerComponent<Bomb>();
+    entities->registerComponent<BombBoom>();
+    entities->addArchetype<Bomb>();
+    entities->addArchetype<BombBoom>();
+  }
+}
 
 void GameState::initialize(Vector2i worldSize, int32_t worldScale)
 {
@@ -488,9 +528,35 @@ void GameState::initialize(Vector2i worldSize, int32_t worldScale)
   _worldSize = worldSize;
   _worldScale = worldScale;
 
+  // Generate a default file only if there is none; a file with errors is the user's to fix.
+  if(_config.load(Config::filename) != 0 && !std::filesystem::exists(Config::filename))
+    _config.write(Config::filename);
+
+  _gridWidth = _config.getIntValue(Config::KEY_GRID_WIDTH);
+  _gridHeight = _config.getIntValue(Config::KEY_GRID_HEIGHT);
+  _gridSize = _gridWidth * _gridHeight;
+
+  _alienXs.resize(_gridSize);
+  _alienYs.resize(_gridSize);
+  _alienClassIds.resize(_gridSize);
+  _alienAliveMasks.resize(_gridHeight);
+  _alienFrameMasks.resize(_gridHeight);
+
+  _maxBombs = _config.getIntValue(Config::KEY_MAX_BOMBS);
+
+  // A collision pass defers at most a destroy and a boom for each bomb.
+  for(EntityStore* entities : {&_entities, &_snapshotLoad._entities})
+    entities->reserveDeferred(2 * _maxBombs, _maxBombs * static_cast<int32_t>(sizeof(BombBoom)));
+
+  _scheduler = std::make_unique<Scheduler>(_config.getIntValue(Config::KEY_SYSTEM_WORKERS));
+  addSystems();
+
   _font = &(pxr::assets->getFont(SpaceInvaders::fontKey, _worldScale));
   _hud = &(static_cast<SpaceInvaders*>(_app)->getHud());
 
+  for(int32_t key = 0; key < SpaceInvaders::BMK_COUNT; ++key)
+    _bitmaps[key] = &(pxr::assets->getBitmap(key, _worldScale));
+
   _colorPalette = {     // index:
     colors::red,        // 0
     colors::green,      // 1
@@ -515,20 +581,30 @@ void GameState::initialize(Vector2i worldSize, int32_t worldScale)
   // note that the top row of aliens starts at 186px (row 0), thus the bottom row starts at
   // 130 (row 4).
   //
+  // Fleets larger than the base fleet are squeezed to fit the space of the base fleet, so the
+  // drop math holds for all fleet sizes.
+  //
 
   _alienShiftDisplacement = Vector2i{2, 0} * _worldScale;
   _alienDropDisplacement = Vector2i{0, -baseAlienDropDisplacement} * _worldScale;
   _alienSpawnDropDisplacement = Vector2i{0, -baseAlienSpawnDropDisplacement} * _worldScale;
   _alienInvasionHeight = baseAlienInvasionRowHeight * _worldScale;
 
-  _alienXSeperation = baseAlienDropDisplacement * _worldScale;
-  _alienYSeperation = baseAlienDropDisplacement * _worldScale;
+  int32_t xSeperation = std::min(baseAlienSeperation, (baseGridWidth * baseAlienSeperation) / _gridWidth);
+  int32_t ySeperation = baseAlienSeperation;
+  if(_gridHeight > 1)
+    ySeperation = std::min(ySeperation, ((baseGridHeight - 1) * baseAlienSeperation) / (_gridHeight - 1));
+  xSeperation = std::max(xSeperation, 1);
+  assert(ySeperation >= baseAlienHeight);
 
-  _aliensSpawnPosition._x = (_worldSize._x - (gridWidth * _alienXSeperation)) / 2;
+  _alienXSeperation = xSeperation * _worldScale;
+  _alienYSeperation = ySeperation * _worldScale;
+
+  _aliensSpawnPosition._x = (_worldSize._x - (_gridWidth * _alienXSeperation)) / 2;
   _aliensSpawnPosition._y = ((baseAlienTopRowHeight + (minSpawnDrops * baseAlienSpawnDropDisplacement))
-                             - ((gridHeight - 1) * baseAlienDropDisplacement)) * _worldScale; 
+                             - ((_gridHeight - 1) * ySeperation)) * _worldScale; 
 
-  //_worldSize._y - (gridHeight * _alienYSeperation) - 30;
+  //_worldSize._y - (_gridHeight * _alienYSeperation) - 30;
 
   _lastClassAlive = AlienClassId::SQUID;
 
@@ -552,6 +628,9 @@ void GameState::initialize(Vector2i worldSize, int32_t worldScale)
   // Theses cycles will produce exponentially increasing beat rates resulting in exponentially
   // increasing alien speed and firing.
   //
+  // The tables below are for the base fleet of 55 aliens; the beats and transitions are scaled
+  // to the actual fleet size below them, such that all fleet sizes move at the same rates.
+  //
   //                          ticks to      fleet moves    
   //                          move fleet    each sec
   //                          ----------    -----------
@@ -575,6 +654,23 @@ void GameState::initialize(Vector2i worldSize, int32_t worldScale)
   // note: the last element MUST == 0, else a segfault will happen when we select the next cycle.
   _cycleTransitions = {49, 42, 35, 28, 21, 14, 10, 7, 5, 4, 3, 2, 0};
 
+  // A tick cannot do less than 1 beat, so fleets too small to scale a cycle run it faster.
+  bool isBeatFloored {false};
+  for(auto& cycle : _cycles){
+    for(auto& beats : cycle){
+      if(beats == cycleEnd)
+        break;
+      int32_t scaled = (beats * _gridSize) / baseGridSize;
+      isBeatFloored |= scaled < 1;
+      beats = std::max(1, scaled);
+    }
+  }
+  if(isBeatFloored)
+    pxr::log->log(Log::WARN, logstr::warn_fleet_beats_floored, std::to_string(_gridSize));
+
+  for(auto& transition : _cycleTransitions)
+    transition = (transition * _gridSize) / baseGridSize;
+
   _alienClasses = {{
     {8  * _worldScale, 8 * _worldScale, 30, 1, {SpaceInvaders::BMK_SQUID0    , SpaceInvaders::BMK_SQUID1    }},
     {11 * _worldScale, 8 * _worldScale, 20, 4, {SpaceInvaders::BMK_CRAB0     , SpaceInvaders::BMK_CRAB1     }},
@@ -588,37 +684,23 @@ void GameState::initialize(Vector2i worldSize, int32_t worldScale)
     {{300, 350, 400}, 1000, 15 * _worldScale, 7 * _worldScale, 3, schrodingerPhasePeriodSeconds, true, SpaceInvaders::BMK_SCHRODINGER, SpaceInvaders::BMK_UFOBOOM}
   }};
 
-  _ufoSpawnY = 210.f * _worldScale;
-  _ufoSpeed = 40.f * _worldScale;     // to move fully across the world and off screen.
+  _ufoSpawnY = 210 * _worldScale;
+  _ufoSpeed = toSpeed(40.f * _worldScale);    // to move fully across the world and off screen.
   _ufoBoomScoreDuration = 0.5f;
   _ufoPhaseDuration = 0.8f;
 
   _formations = {{  // note formations look inverted here as array[0] is the bottom row, but they are not.
-    // formation 0
-    {{
-       {OCTOPUS,OCTOPUS,OCTOPUS,OCTOPUS,OCTOPUS,OCTOPUS,OCTOPUS,OCTOPUS,OCTOPUS,OCTOPUS,OCTOPUS},
-       {OCTOPUS,OCTOPUS,OCTOPUS,OCTOPUS,OCTOPUS,OCTOPUS,OCTOPUS,OCTOPUS,OCTOPUS,OCTOPUS,OCTOPUS},
-       {CRAB   ,CRAB   ,CRAB   ,CRAB   ,CRAB   ,CRAB   ,CRAB   ,CRAB   ,CRAB   ,CRAB   ,CRAB   },
-       {CRAB   ,CRAB   ,CRAB   ,CRAB   ,CRAB   ,CRAB   ,CRAB   ,CRAB   ,CRAB   ,CRAB   ,CRAB   },
-       {SQUID  ,SQUID  ,SQUID  ,SQUID  ,SQUID  ,SQUID  ,SQUID  ,SQUID  ,SQUID  ,SQUID  ,SQUID  }
-    }},
-    // formation 1
-    {{
-       {SQUID  ,SQUID  ,SQUID  ,SQUID  ,SQUID  ,SQUID  ,SQUID  ,SQUID  ,SQUID  ,SQUID  ,SQUID  },
-       {CRAB   ,CRAB   ,CRAB   ,CRAB   ,CRAB   ,CRAB   ,CRAB   ,CRAB   ,CRAB   ,CRAB   ,CRAB   },
-       {CRAB   ,CRAB   ,CRAB   ,CRAB   ,CRAB   ,CRAB   ,CRAB   ,CRAB   ,CRAB   ,CRAB   ,CRAB   },
-       {OCTOPUS,OCTOPUS,OCTOPUS,OCTOPUS,OCTOPUS,OCTOPUS,OCTOPUS,OCTOPUS,OCTOPUS,OCTOPUS,OCTOPUS},
-       {OCTOPUS,OCTOPUS,OCTOPUS,OCTOPUS,OCTOPUS,OCTOPUS,OCTOPUS,OCTOPUS,OCTOPUS,OCTOPUS,OCTOPUS}
-    }}
+    {OCTOPUS, OCTOPUS, CRAB, CRAB, SQUID},  // formation 0
+    {SQUID, CRAB, CRAB, OCTOPUS, OCTOPUS}   // formation 1
   }};
 
   _bombIntervalDeviation = 0.5f; // Maximum 50% deviation from base.
   _bombIntervals = {80, 80, 100, 120, 140, 180, 240, 300, 400, 500, 650, 800, 1100};
 
   _bombClasses = {{
-    {3 * _worldScale, 6 * _worldScale, -80.f * _worldScale, 0, 20, 0, {SpaceInvaders::BMK_CROSS0, SpaceInvaders::BMK_CROSS1, SpaceInvaders::BMK_CROSS2, SpaceInvaders::BMK_CROSS3}},
-    {3 * _worldScale, 7 * _worldScale, -120.f * _worldScale, 4, 20, 10, {SpaceInvaders::BMK_ZIGZAG0, SpaceInvaders::BMK_ZIGZAG1, SpaceInvaders::BMK_ZIGZAG2, SpaceInvaders::BMK_ZIGZAG3}},
-    {3 * _worldScale, 7 * _worldScale, -100.f * _worldScale, 5, 20, 4, {SpaceInvaders::BMK_ZAGZIG0, SpaceInvaders::BMK_ZAGZIG1, SpaceInvaders::BMK_ZAGZIG2, SpaceInvaders::BMK_ZAGZIG3}}
+    {3 * _worldScale, 6 * _worldScale, toSpeed(-80.f * _worldScale), 0, 20, 0, {SpaceInvaders::BMK_CROSS0, SpaceInvaders::BMK_CROSS1, SpaceInvaders::BMK_CROSS2, SpaceInvaders::BMK_CROSS3}},
+    {3 * _worldScale, 7 * _worldScale, toSpeed(-120.f * _worldScale), 4, 20, 10, {SpaceInvaders::BMK_ZIGZAG0, SpaceInvaders::BMK_ZIGZAG1, SpaceInvaders::BMK_ZIGZAG2, SpaceInvaders::BMK_ZIGZAG3}},
+    {3 * _worldScale, 7 * _worldScale, toSpeed(-100.f * _worldScale), 5, 20, 4, {SpaceInvaders::BMK_ZAGZIG0, SpaceInvaders::BMK_ZAGZIG1, SpaceInvaders::BMK_ZAGZIG2, SpaceInvaders::BMK_ZAGZIG3}}
   }};
 
   _bombBoomKeys = {{SpaceInvaders::BMK_BOMBBOOMBOTTOM, SpaceInvaders::BMK_BOMBBOOMMIDAIR}};
@@ -626,12 +708,25 @@ void GameState::initialize(Vector2i worldSize, int32_t worldScale)
   _bombBoomHeight = 8 * _worldScale;
   _bombBoomDuration = 0.4f;
 
-  _cannon._spawnPosition = Vector2f{_worldLeftBorderX, baseAlienInvasionRowHeight * _worldScale};
-  _cannon._speed = 50.f * _worldScale;
+  // Bombs hitting the hitbar replace the bar under the boom with alternating on/off stripes. 
+  // The stripes alternate every world pixel and begin on or off with the parity of the hit.
+  _hitbarHeight = 1 * _worldScale;
+  _hitbarDamageMask = std::make_unique<Bitmap>(pxr::assets->makeBlockBitmap(_bombBoomWidth, _hitbarHeight));
+  for(int32_t parity = 0; parity < 2; ++parity){
+    std::string stripes {};
+    for(int32_t i = 0; i < _bombBoomWidth; ++i)
+      stripes += ((parity + (i / _worldScale)) % 2) ? '1' : '0';
+    std::vector<std::string> rows(_hitbarHeight, stripes);
+    _hitbarStripeMasks[parity] = std::make_unique<Bitmap>(pxr::assets->makeBitmap(std::move(rows)));
+  }
+
+  _cannon._spawnPosition = Vector2x{Vector2i{_worldLeftBorderX, baseAlienInvasionRowHeight * _worldScale}};
+  _cannon._speed = toSpeed(50.f * _worldScale);
   _cannon._width = 13 * _worldScale;
   _cannon._height = 8 * _worldScale;
   _cannon._boomFrameDuration = 0.2f;
   _cannon._boomDuration = _cannon._boomFrameDuration * 5;
+  _cannon._boomFrame = 0;
   _cannon._cannonKey = SpaceInvaders::BMK_CANNON0;
   _cannon._boomKeys = {{SpaceInvaders::BMK_CANNONBOOM0, SpaceInvaders::BMK_CANNONBOOM1, SpaceInvaders::BMK_CANNONBOOM2}};
   _cannon._colorIndex = 0;
@@ -639,14 +734,21 @@ void GameState::initialize(Vector2i worldSize, int32_t worldScale)
   _laser._width = 1 * _worldScale;
   _laser._height = 6 * _worldScale;
   _laser._colorIndex = 6;
-  _laser._speed = 300.f * _worldScale;
+  _laser._speed = toSpeed(300.f * _worldScale);
   _laser._bitmapKey = SpaceInvaders::BMK_LASER0;
 
   _bunkerColorIndex = 0;
   _bunkerSpawnX = 32 * _worldScale;
   _bunkerSpawnY = 48 * _worldScale;
-  _bunkerSpawnGapX = 45 * _worldScale;
-  _bunkerSpawnCount = 4;
+  _bunkerSpawnCount = _config.getIntValue(Config::KEY_BUNKER_SPAWN_COUNT);
+
+  // More than the base 4 bunkers are squeezed into the span of the base 4.
+  static constexpr int32_t baseBunkerSpawnGapX {45};
+  static constexpr int32_t baseBunkerSpawnCount {4};
+  int32_t bunkerSpawnGapX = baseBunkerSpawnGapX;
+  if(_bunkerSpawnCount > baseBunkerSpawnCount)
+    bunkerSpawnGapX = ((baseBunkerSpawnCount - 1) * baseBunkerSpawnGapX) / (_bunkerSpawnCount - 1);
+  _bunkerSpawnGapX = bunkerSpawnGapX * _worldScale;
   _bunkerWidth = 22 * _worldScale;
   _bunkerHeight = 16 * _worldScale;
   _bunkerDeleteThreshold = 20 * _worldScale;
@@ -680,6 +782,8 @@ void GameState::startNextLevel()
   if(_levelIndex >= levelCount)
     _levelIndex = levelCount - 1;
 
+  _timers.clear();
+
   _activeCycle = spawnCycle;
   _activeBeat = cycleStart;
   _beatBox.pause();
@@ -692,45 +796,33 @@ void GameState::startNextLevel()
   _isAliensSpawning = true;
   _isAliensFrozen = false;
   _isAliensAboveInvasionRow = false;
+  _haveAliensInvaded = false;
 
   // Reset aliens.
-  for(int32_t col = 0; col < gridWidth; ++col){
-    for(int32_t row = 0; row < gridHeight; ++row){
-      Alien& alien = _grid[row][col];
-
-      alien._classId = _formations[0][row][col];
-
-      alien._position._x = _aliensSpawnPosition._x + (col * _alienXSeperation);
-      alien._position._y = _aliensSpawnPosition._y + (row * _alienYSeperation);
-
-      alien._row = row;
-      alien._col = col;
-
-      alien._frame = false;
-      alien._isAlive = true;
+  const Formation& formation = _formations[0];
+  for(int32_t row = 0; row < _gridHeight; ++row){
+    AlienClassId classId = formation[(row * baseGridHeight) / _gridHeight];
+    for(int32_t col = 0; col < _gridWidth; ++col){
+      int32_t alien = toAlienIndex(row, col);
+      _alienClassIds[alien] = classId;
+      _alienXs[alien] = _aliensSpawnPosition._x + (col * _alienXSeperation);
+      _alienYs[alien] = _aliensSpawnPosition._y + (row * _alienYSeperation);
     }
   }
 
-  std::fill(_columnPops.begin(), _columnPops.end(), gridHeight);
-  std::fill(_rowPops.begin(), _rowPops.end(), gridWidth);
-  _alienPopulation = gridSize;
+  uint64_t fullRowMask = (_gridWidth == 64) ? ~uint64_t{0} : toColumnBit(_gridWidth) - 1;
+  std::fill(_alienAliveMasks.begin(), _alienAliveMasks.end(), fullRowMask);
+  std::fill(_alienFrameMasks.begin(), _alienFrameMasks.end(), 0);
+  _alienBoomer = nullAlien;
+  _alienMorpher = nullAlien;
 
   _isUfoBooming = false;
   _isUfoScoring = false;
-  _ufo._isAlive = false;
-  _tillUfo = pxr::randUniformSignedInt(tillUfoMin, tillUfoMax);
+  _ufo = {SAUCER, {}, false, false};
   _ufoCounter = 0;
   _canUfosSpawn = true;
 
-  // Reset bombs.
-  for(auto& bomb : _bombs)
-    bomb._isAlive = false;
-
-  _bombCount = 0;
-
-  // Reset bomb booms.
-  for(auto& boom : _bombBooms)
-    boom._isAlive = false;
+  _entities.clear();
 
   _laser._isAlive = false;
   _shotCounter = 0;
@@ -741,18 +833,24 @@ void GameState::startNextLevel()
 
   _bombClock = _bombIntervals[_activeCycle];
 
-  // Create fresh (undamaged) hitbar.
-  _hitbar = std::make_unique<Hitbar>(
-      pxr::assets->getBitmap(SpaceInvaders::BMK_HITBAR, _worldScale), 
-      _worldSize._x,
-      1 * _worldScale,
-      16 * _worldScale, 
-      1
-  );
+  // Create fresh (undamaged) hitbar, or restore the bitmap of the last in its storage.
+  if(_hitbar)
+    _hitbar->_bitmap = *_bitmaps[SpaceInvaders::BMK_HITBAR];
+  else{
+    _hitbar = std::make_unique<Hitbar>(
+        *_bitmaps[SpaceInvaders::BMK_HITBAR], 
+        _worldSize._x,
+        _hitbarHeight,
+        16 * _worldScale, 
+        1
+    );
+  }
 
   // Create fresh bunkers.
+  for(auto& bunker : _bunkers)
+    _spareBunkers.push_back(std::move(bunker));
   _bunkers.clear();
-  Vector2f position {_bunkerSpawnX, _bunkerSpawnY};
+  Vector2i position {_bunkerSpawnX, _bunkerSpawnY};
   for(int i = 0; i < _bunkerSpawnCount; ++i){
     spawnBunker(position, SpaceInvaders::BMK_BUNKER);
     position._x += _bunkerSpawnGapX;
@@ -788,7 +886,7 @@ void GameState::updateBeatFreq()
   // hence note that the fequency of the beating equals the frequency of full fleet movements.
   //
   //                    v-- the fixed frame rate set in the engine.
-  float beatFreq_hz = (60.f / ((gridSize / beatsPerCycle) * ticksPerCycle)) * beatFreqScale;
+  float beatFreq_hz = (60.f / ((_gridSize / beatsPerCycle) * ticksPerCycle)) * beatFreqScale;
   //                                                  base rate a little intense --^
 
   _beatBox.setBeatFreq(beatFreq_hz);
@@ -797,7 +895,8 @@ void GameState::updateBeatFreq()
 void GameState::updateActiveCycle()
 {
   _activeCycle = 0;
-  while(_alienPopulation < _cycleTransitions[_activeCycle]){
+  int32_t population = getAlienPopulation();
+  while(population < _cycleTransitions[_activeCycle]){
     ++_activeCycle;
 
     // should never happen unless we have set, in _cycleTransitions, for the last cycle
@@ -823,6 +922,7 @@ void GameState::endSpawning()
   _activeCycle = 0;
   updateBeatFreq();
   _beatBox.unpause();
+  scheduleUfoSpawn();
 
   static_cast<SpaceInvaders*>(_app)->showTopHud();
 }
@@ -848,45 +948,48 @@ void GameState::spawnCannon(bool takeLife)
 
 void GameState::spawnBoom(Vector2i position, BombHit hit, int32_t colorIndex)
 {
-  auto search = std::find_if_not(_bombBooms.begin(), _bombBooms.end(), isBombBoomAlive);
-
-  // If this asserts then expand the booms array until it does not.
-  assert(search != _bombBooms.end());
+  // Booms are cosmetic so if the max is reached the boom is simply not shown. Booms spawned
+  // earlier in the same query are still deferred so count towards the max.
+  if(_entities.count<BombBoom>() + _entities.countDeferred<BombBoom>() >= _maxBombs)
+    return;
 
-  (*search)._hit = hit;
-  (*search)._colorIndex = colorIndex;
-  (*search)._position = position;
-  (*search)._boomClock = _bombBoomDuration;
-  (*search)._isAlive = true;
+  // Booms spawn from within the bomb queries so are always deferred.
+  auto boom = _entities.deferCreate(BombBoom{hit, position, colorIndex});
+  _timers.schedule(toTicks(_bombBoomDuration), TIMER_BOMB_BOOM_END, boom);
 }
 
-void GameState::spawnBomb(Vector2f position, BombClassId classId)
+void GameState::spawnBomb(Vector2x position, BombClassId classId)
 {
-  // If this condition does occur then increase the max bombs until it doesn't.
-  assert(_bombCount != maxBombs);
+  // The max bombs is a config value, so if it is reached the alien simply does not fire.
+  if(_entities.count<Bomb>() >= _maxBombs)
+    return;
 
-  // Find a 'dead' bomb instance to use.
-  Bomb* bomb {nullptr};
-  for(auto& b : _bombs)
-    if(!b._isAlive)
-      bomb = &b;
+  _entities.create(Bomb{classId, position, _bombClasses[classId]._frameInterval, 0});
+}
 
-  // If this occurs my bomb counts are off.
-  assert(bomb != nullptr);
+void GameState::spawnBunker(Vector2i position, Assets::Key_t bitmapKey)
+{
+  _bunkers.push_back(makeBunker(position, bitmapKey));
+}
 
-  bomb->_classId = classId;
-  bomb->_position = position;
-  bomb->_frame = 0;
-  bomb->_isAlive = true;
-  bomb->_frameClock = _bombClasses[classId]._frameInterval;
+std::unique_ptr<GameState::Bunker> GameState::makeBunker(Vector2i position, Assets::Key_t bitmapKey)
+{
+  const Bitmap& bitmap = *_bitmaps[bitmapKey];
+  if(_spareBunkers.empty())
+    return std::make_unique<Bunker>(bitmap, position);
 
-  ++_bombCount;
+  // Reusing a spare copies the bitmap into its storage.
+  std::unique_ptr<Bunker> bunker = std::move(_spareBunkers.back());
+  _spareBunkers.pop_back();
+  bunker->_bitmap = bitmap;
+  bunker->_position = position;
+  return bunker;
 }
 
-void GameState::spawnBunker(Vector2f position, Assets::Key_t bitmapKey)
+void GameState::deleteBunker(int32_t bunker)
 {
-  const Bitmap& bitmap = pxr::assets->getBitmap(bitmapKey, _worldScale);
-  _bunkers.emplace_back(std::make_unique<Bunker>(bitmap, position));
+  _spareBunkers.push_back(std::move(_bunkers[bunker]));
+  _bunkers.erase(_bunkers.begin() + bunker);
 }
 
 void GameState::spawnUfo(UfoClassId classId)
@@ -894,30 +997,36 @@ void GameState::spawnUfo(UfoClassId classId)
   _ufo._classId = classId;
   _ufo._isAlive = true;
   _ufoDirection = (randUniformSignedInt(0, 1) == 0) ? 1 : -1;
-  _ufo._position._x = (_ufoDirection == 1) ? 0 : _worldSize._x;
-  _ufo._position._y = _ufoSpawnY;
+  _ufo._position._x = Fixed{(_ufoDirection == 1) ? 0 : _worldSize._x};
+  _ufo._position._y = Fixed{_ufoSpawnY};
   _ufo._phase = true;
   _ufoSfxChannel = mixer->playSound(SpaceInvaders::SK_UFO_HIGH_PITCH, 1000);
+
+  const UfoClass& uc = _ufoClasses[classId];
+  if(uc._isPhaser){
+    restartTimer(TIMER_UFO_PHASE, toTicks(uc._phasePeriodSeconds));
+  }
+}
+
+void GameState::scheduleUfoSpawn()
+{
+  restartTimer(TIMER_UFO_SPAWN, pxr::randUniformSignedInt(tillUfoMin, tillUfoMax));
 }
 
-void GameState::morphAlien(Alien& alien)
-  // predicate: alien->_col != gridWidth - 1
+void GameState::morphAlien(int32_t alien)
+  // predicate: alien is not in the last column.
 {
-  static_cast<SpaceInvaders*>(_app)->addScore(_alienClasses[alien._classId]._scoreValue);
+  static_cast<SpaceInvaders*>(_app)->addScore(_alienClasses[_alienClassIds[alien]]._scoreValue);
 
-  alien._classId = CUTTLETWIN;
-  _alienMorpher = &alien;
-  _alienMorphClock = _alienMorphDuration;
+  _alienClassIds[alien] = CUTTLETWIN;
+  _alienMorpher = alien;
+  restartTimer(TIMER_ALIEN_MORPH_END, toTicks(_alienMorphDuration));
   _isAliensFrozen = true;
   _isAliensMorphing = true;
 
-  Alien& neighbour = _grid[alien._row][alien._col + 1];
-  if(neighbour._isAlive){
-    neighbour._isAlive = false;
-    --(_columnPops[neighbour._col]);
-    --(_rowPops[neighbour._row]);
-    --_alienPopulation;
-  }
+  // The twin takes the space of the neighbour to the right.
+  int32_t neighbourCol = (alien % _gridWidth) + 1;
+  _alienAliveMasks[alien / _gridWidth] &= ~toColumnBit(neighbourCol);
 
   mixer->playSound(SpaceInvaders::SK_INVADER_MORPHED);
 }
@@ -925,9 +1034,9 @@ void GameState::morphAlien(Alien& alien)
 void GameState::boomCannon()
 {
   _cannon._moveDirection = 0;
-  _cannon._boomClock = _cannon._boomDuration;
   _cannon._boomFrame = 0;
-  _cannon._boomFrameClock = _cannon._boomFrameDuration;
+  restartTimer(TIMER_CANNON_BOOM_END, toTicks(_cannon._boomDuration));
+  restartTimer(TIMER_CANNON_BOOM_FRAME, toTicks(_cannon._boomFrameDuration));
   _cannon._isBooming = true;
   _cannon._isAlive = false;
 
@@ -938,20 +1047,22 @@ void GameState::boomCannon()
   mixer->playSound(SpaceInvaders::SK_EXPLOSION);
 }
 
-void GameState::boomBomb(Bomb& bomb, bool makeBoom, Vector2i boomPosition, BombHit hit)
+void GameState::boomBomb(EntityStore::Entity_t bomb, bool makeBoom, Vector2i boomPosition, BombHit hit)
 {
-  --_bombCount;
-  bomb._isAlive = false;
+  BombClassId classId = _entities.get<Bomb>(bomb)._classId;
+
+  _entities.deferDestroy(bomb);
 
   if(makeBoom)
-    spawnBoom(boomPosition, hit, _bombClasses[bomb._classId]._colorIndex);
+    spawnBoom(boomPosition, hit, _bombClasses[classId]._colorIndex);
 }
 
 void GameState::boomUfo()
 {
   _ufo._isAlive = false;
   _isUfoBooming = true;
-  _ufoBoomScoreClock = 0.f;
+  restartTimer(TIMER_UFO_BOOM_SCORE, toTicks(_ufoBoomScoreDuration));
+  scheduleUfoSpawn();
 
   const UfoClass& uc = _ufoClasses[_ufo._classId];
 
@@ -967,21 +1078,19 @@ void GameState::boomUfo()
   _ufoSfxChannel = mixer->playSound(SpaceInvaders::SK_UFO_LOW_PITCH);
 }
 
-void GameState::boomAlien(Alien& alien)
+void GameState::boomAlien(int32_t alien)
 {
-  static_cast<SpaceInvaders*>(_app)->addScore(_alienClasses[alien._classId]._scoreValue);
+  static_cast<SpaceInvaders*>(_app)->addScore(_alienClasses[_alienClassIds[alien]]._scoreValue);
 
-  alien._isAlive = false;
-  _alienBoomer = &alien;
-  _alienBoomClock = _alienBoomDuration;
+  _alienAliveMasks[alien / _gridWidth] &= ~toColumnBit(alien % _gridWidth);
+  _alienBoomer = alien;
+  restartTimer(TIMER_ALIEN_BOOM_END, toTicks(_alienBoomDuration));
   _isAliensFrozen = true;
   _isAliensBooming = true;
-  --(_columnPops[alien._col]);
-  --(_rowPops[alien._row]);
-  --_alienPopulation;
-  if(_alienPopulation <= 0)
-    _lastClassAlive = alien._classId;
-  if(_alienPopulation <= 8)
+  int32_t population = getAlienPopulation();
+  if(population <= 0)
+    _lastClassAlive = _alienClassIds[alien];
+  if(population <= 8)
     _canUfosSpawn = false;
   updateActiveCycle();
 
@@ -994,8 +1103,8 @@ void GameState::boomLaser(bool makeBoom, BombHit hit)
 
   if(makeBoom){
     Vector2i position {};
-    position._x = _laser._position._x - ((_bombBoomWidth - _laser._width) / 2);
-    position._y = _laser._position._y;
+    position._x = _laser._position._x.toInt() - ((_bombBoomWidth - _laser._width) / 2);
+    position._y = _laser._position._y.toInt();
 
     spawnBoom(position, hit, _laser._colorIndex);
   }
@@ -1003,84 +1112,20 @@ void GameState::boomLaser(bool makeBoom, BombHit hit)
 
 void GameState::boomBunker(Bunker& bunker, Vector2i pixelHit)
 {
-  Vector2i aPosition {};
-  Vector2i bPosition {};
-
-  const Bitmap& aBitmap {bunker._bitmap};
-  const Bitmap& bBitmap {pxr::assets->getBitmap(SpaceInvaders::BMK_BOMBBOOMMIDAIR, _worldScale)};
+  const Bitmap& mask {*_bitmaps[SpaceInvaders::BMK_BOMBBOOMMIDAIR]};
 
-  aPosition._x = bunker._position._x;
-  aPosition._y = bunker._position._y;
+  Vector2i offset {pixelHit._x - (_bombBoomWidth / 2), pixelHit._y - (_bombBoomHeight / 2)};
 
-  bPosition._x = bunker._position._x + pixelHit._x - (_bombBoomWidth / 2);
-  bPosition._y = bunker._position._y + pixelHit._y - (_bombBoomHeight / 2);
-
-  const Collision& c = testCollision(aPosition, aBitmap, bPosition, bBitmap, true);
+  [[maybe_unused]] int32_t erased = bunker._bitmap.stamp(mask, offset, Bitmap::STAMP_AND_NOT);
 
   // If this asserts then the mask used to blit off damage is not intersecting any pixels
   // on the bitmap, the result is that no change is made. This creates the situation in which
   // parts of the bunker cannot be destroyed. Thus if this happens redesign the damage mask.
-  assert(c._isCollision);
-
-  for(auto& pixel : c._aPixels)
-    bunker._bitmap.setBit(pixel._y, pixel._x, 0, false);
-
-  bunker._bitmap.regenerateBytes();
-}
-
-
-void GameState::doUfoSpawning()
-{
-  if(_ufo._isAlive)
-    return;
-
-  if(_isAliensSpawning || _isAliensDropping)
-    return;
-
-  if(_isGameOver || _isVictory || _isRoundIntro)
-    return;
-
-  if(_alienPopulation <= 8)
-    return;
-
-  --_tillUfo;
-  if(_tillUfo <= 0){
-    if(pxr::randUniformSignedInt(0, schrodingerSpawnChance) == 0)
-     spawnUfo(SCHRODINGER);
-    else
-      spawnUfo(SAUCER);
-    _tillUfo = pxr::randUniformSignedInt(tillUfoMin, tillUfoMax);
-  }
+  assert(erased != 0);
 }
 
-void GameState::doAlienMorphing(float dt)
-  // predicate: _alienMorpher->_col != gridWidth - 1
-{
-  if(!_isAliensMorphing)
-    return;
-
-  if(_alienPopulation == 0)
-    return;
-
-  _alienMorphClock -= dt;
-  if(_alienMorphClock > 0)
-    return;
-
-  _alienMorpher->_classId = CUTTLE;
-
-  Alien& neighbour = _grid[_alienMorpher->_row][_alienMorpher->_col + 1];
-  neighbour._classId = CUTTLE;
-  neighbour._isAlive = true;
-  ++(_columnPops[neighbour._col]);
-  ++(_rowPops[neighbour._row]);
-  ++_alienPopulation;
 
-  _isAliensMorphing = false;
-  _isAliensFrozen = false;
-  _alienMorpher = nullptr;
-}
-
-void GameState::doCannonMoving(float dt)
+void GameState::doCannonMoving()
 {
   if(!_cannon._isAlive)
     return;
@@ -1100,33 +1145,14 @@ void GameState::doCannonMoving(float dt)
     _cannon._moveDirection = 0;
   }
 
-  _cannon._position._x += _cannon._speed * _cannon._moveDirection * dt;
+  _cannon._position._x += _cannon._speed * _cannon._moveDirection;
   _cannon._position._x = std::clamp(
       _cannon._position._x, 
-      static_cast<float>(_worldLeftBorderX), 
-      static_cast<float>(_worldRightBorderX - _cannon._width)
+      Fixed{_worldLeftBorderX}, 
+      Fixed{_worldRightBorderX - _cannon._width}
   );
 }
 
-void GameState::doCannonBooming(float dt)
-{
-  if(!_cannon._isBooming)
-    return;
-
-  _cannon._boomClock -= dt;
-  if(_cannon._boomClock <= 0){
-    _cannon._isBooming = false;
-    spawnCannon(true);
-    return;
-  }
-
-  _cannon._boomFrameClock -= dt;
-  if(_cannon._boomFrameClock <= 0){
-    _cannon._boomFrame = pxr::wrap(++_cannon._boomFrame, 0, cannonBoomFramesCount - 1);
-    _cannon._boomFrameClock = _cannon._boomFrameDuration;
-  }
-}
-
 void GameState::doCannonFiring()
 {
   if(!_cannon._isAlive)
@@ -1139,10 +1165,11 @@ void GameState::doCannonFiring()
     return;
 
   if(pxr::input->isKeyDown(Input::KEY_SPACE)){
-    Vector2f position = _cannon._position;
-    position._x += _cannon._width / 2;
-    position._y += _cannon._height;
+    Vector2x position = _cannon._position;
+    position._x += Fixed{_cannon._width / 2};
+    position._y += Fixed{_cannon._height};
     _laser._position = position;
+    _laser._lastPosition = position;
     _laser._isAlive = true;
     mixer->playSound(SpaceInvaders::SK_SHOOT);
     ++_shotCounter;
@@ -1175,20 +1202,22 @@ void GameState::doAlienMoving(int32_t beats)
   if(_isAliensFrozen)
     return;
 
-  if(_alienPopulation == 0)
+  if(getAlienPopulation() == 0)
     return;
 
   for(int i = 0; i < beats; ++i){
-    Alien& alien = _grid[_nextMover._row][_nextMover._col];
+    int32_t alien = toAlienIndex(_nextMover._row, _nextMover._col);
 
-    if(_isAliensDropping){
-      alien._position += _isAliensSpawning ? _alienSpawnDropDisplacement : _alienDropDisplacement;
-    }
-    else{
-      alien._position += _alienShiftDisplacement * _alienMoveDirection;
-    }
+    Vector2i displacement {};
+    if(_isAliensDropping)
+      displacement = _isAliensSpawning ? _alienSpawnDropDisplacement : _alienDropDisplacement;
+    else
+      displacement = _alienShiftDisplacement * _alienMoveDirection;
+
+    _alienXs[alien] += displacement._x;
+    _alienYs[alien] += displacement._y;
 
-    alien._frame = !alien._frame;
+    _alienFrameMasks[_nextMover._row] ^= toColumnBit(_nextMover._col);
 
     bool looped = incrementGridIndex(_nextMover);
 
@@ -1214,55 +1243,36 @@ void GameState::doAlienMoving(int32_t beats)
   }
 }
 
-void GameState::doBombMoving(int32_t beats, float dt)
+void GameState::doBombMoving(int32_t beats)
 {
-  for(auto& bomb : _bombs){
-    if(!bomb._isAlive)
-      continue;
-
+  _entities.each<Bomb>([this, beats](EntityStore::Entity_t, Bomb& bomb){
     const BombClass& bombClass = _bombClasses[bomb._classId];
 
-    bomb._position._y += bombClass._speed * dt;
+    bomb._position._y += bombClass._speed;
 
     bomb._frameClock -= beats;
     if(bomb._frameClock <= 0){
       bomb._frame = pxr::wrap(++bomb._frame, 0, bombFramesCount - 1);
       bomb._frameClock = bombClass._frameInterval;
     }
-  }
+  });
 }
 
-void GameState::doLaserMoving(float dt)
+void GameState::doLaserMoving()
 {
   if(!_laser._isAlive)
     return;
 
-  _laser._position._y += _laser._speed * dt;
+  _laser._lastPosition = _laser._position;
+  _laser._position._y += _laser._speed;
 }
 
-void GameState::doUfoMoving(float dt)
+void GameState::doUfoMoving()
 {
   if(!_ufo._isAlive)
     return;
 
-  _ufo._position._x += _ufoSpeed * _ufoDirection * dt;
-}
-
-void GameState::doUfoPhasing(float dt)
-{
-  if(!_ufo._isAlive) 
-    return;
-
-  const UfoClass& uc = _ufoClasses[_ufo._classId];
-
-  if(!uc._isPhaser)
-    return;
-
-  _ufo._phaseClockSeconds += dt;
-  if(_ufo._phaseClockSeconds >= uc._phasePeriodSeconds){
-    _ufo._phase = !_ufo._phase;
-    _ufo._phaseClockSeconds = 0.f;
-  }
+  _ufo._position._x += _ufoSpeed * _ufoDirection;
 }
 
 void GameState::doAlienBombing(int32_t beats)
@@ -1277,7 +1287,7 @@ void GameState::doAlienBombing(int32_t beats)
   if(_isAliensSpawning)
     return;
 
-  if(_alienPopulation == 0)
+  if(getAlienPopulation() == 0)
     return;
   
   _bombClock -= beats;
@@ -1285,95 +1295,41 @@ void GameState::doAlienBombing(int32_t beats)
     return;
 
   // Select the column to bomb from, taking into account unpopulated columns.
-  int32_t populatedCount = gridWidth - std::count(_columnPops.begin(), _columnPops.end(), 0);
+  uint64_t populatedColumns = getPopulatedColumnsMask();
+  int32_t populatedCount = std::popcount(populatedColumns);
 
   // This condition should of already been detected as a level win.
   assert(populatedCount != 0);
 
-  int32_t colShift = randUniformSignedInt(1, gridWidth) % populatedCount;
-  int32_t col {-1};
-  do {
-    ++col;
-    while(_columnPops[col] == 0) 
-      ++col;
-  }
-  while(--colShift >= 0);
+  // Pick the colShift'th populated column (from the left) by clearing the lower set bits.
+  int32_t colShift = randUniformSignedInt(1, _gridWidth) % populatedCount;
+  while(--colShift >= 0)
+    populatedColumns &= populatedColumns - 1;
+  int32_t col = std::countr_zero(populatedColumns);
 
-  // Find the alien that will do the bombing.
-  Alien* alien {nullptr};
-  for(int32_t row = 0; row < gridHeight; ++row){
-    if(_grid[row][col]._isAlive){
-      alien = &_grid[row][col];
-      break;
-    }
-  }
+  // Find the alien that will do the bombing; the lowest alive in the column.
+  int32_t row {0};
+  while(!(_alienAliveMasks[row] & toColumnBit(col)))
+    ++row;
+
+  assert(row < _gridHeight); // The column selection should ensure this never happens.
 
-  assert(alien != nullptr); // The column selection should ensure this never happens.
+  int32_t alien = toAlienIndex(row, col);
   
-  const AlienClass& alienClass = _alienClasses[alien->_classId];
+  const AlienClass& alienClass = _alienClasses[_alienClassIds[alien]];
 
   BombClassId classId = static_cast<BombClassId>(randUniformSignedInt(CROSS, ZAGZIG));
   const BombClass& bombClass = _bombClasses[classId]; 
 
-  Vector2f position {};
-  position._x += alien->_position._x + (alienClass._width * 0.5f);
-  position._y += alien->_position._y - bombClass._height;
+  Vector2x position {};
+  position._x = Fixed{_alienXs[alien]} + (Fixed{alienClass._width} / 2);
+  position._y = Fixed{_alienYs[alien] - bombClass._height};
 
   spawnBomb(position, classId);
 
   _bombClock = _bombIntervals[_activeCycle];
 }
 
-void GameState::doAlienBooming(float dt)
-{
-  if(!_isAliensBooming)
-    return;
-
-  _alienBoomClock -= dt;
-  if(_alienBoomClock <= 0.f){
-    _alienBoomer = nullptr;
-    _isAliensFrozen = false;
-    _isAliensBooming = false;
-  }
-}
-
-void GameState::doUfoBoomScoring(float dt)
-{
-  if(!(_isUfoBooming || _isUfoScoring))
-    return;
-
-  _ufoBoomScoreClock += dt;
-  if(_ufoBoomScoreClock >= _ufoBoomScoreDuration){
-    if(_isUfoBooming){
-      const UfoClass& uc = _ufoClasses[_ufo._classId];
-      _uidUfoScoringText = _hud->addTextLabel({
-        Vector2i(_ufo._position._x, _ufo._position._y),
-        _colorPalette[uc._colorIndex],
-        std::to_string(_ufoLastScoreGiven)
-      });
-      _isUfoBooming = false;
-      _isUfoScoring = true;
-    }
-    else{
-      _hud->removeTextLabel(_uidUfoScoringText);
-      _isUfoScoring = false;
-    }
-    _ufoBoomScoreClock = 0.f;
-  }
-}
-
-void GameState::doBombBoomBooming(float dt)
-{
-  for(auto& boom : _bombBooms){
-    if(!boom._isAlive)
-      continue;
-
-    boom._boomClock -= dt;
-    if(boom._boomClock <= 0.f)
-      boom._isAlive = false;
-  }
-}
-
 void GameState::doUfoReinforcing(float dt)
 {
   // TODO
@@ -1384,46 +1340,40 @@ void GameState::doCollisionsUfoBorders()
   if(!_ufo._isAlive)
     return;
 
-  if((_ufoDirection == -1 && _ufo._position._x < 0) ||
-     (_ufoDirection == 1  && _ufo._position._x > _worldSize._x))
+  if((_ufoDirection == -1 && _ufo._position._x < Fixed{0}) ||
+     (_ufoDirection == 1  && _ufo._position._x > Fixed{_worldSize._x}))
   {
     _ufo._isAlive = false;
     mixer->stopChannel(_ufoSfxChannel);
+    scheduleUfoSpawn();
   }
 }
 
 void GameState::doCollisionsBombsHitbar()
 {
-  for(auto& bomb : _bombs){
-    if(!bomb._isAlive)
-      continue;
-
-    if(bomb._position._y > _hitbar->_positionY)
-      continue;
+  _entities.eachReverse<Bomb>([this](EntityStore::Entity_t entity, const Bomb& bomb){
+    if(bomb._position._y > Fixed{_hitbar->_positionY})
+      return;
 
     BombClass& bc = _bombClasses[bomb._classId];
 
-    int32_t bithit = bomb._position._x - ((_bombBoomWidth - bc._width) / 2);
+    int32_t bithit = bomb._position._x.toInt() - ((_bombBoomWidth - bc._width) / 2);
     
     // Apply damage to the bar.
-    for(int32_t i = 0; i < _bombBoomWidth; ++i){
-      bool bitval = (bithit + i / _worldScale) % 2;
-      for(int32_t j = 0; j < _hitbar->_height; ++j)
-        _hitbar->_bitmap.setBit(j, bithit + i, bitval, false);
-    }
-    _hitbar->_bitmap.regenerateBytes();
+    Vector2i offset {bithit, 0};
+    _hitbar->_bitmap.stamp(*_hitbarDamageMask, offset, Bitmap::STAMP_AND_NOT);
+    _hitbar->_bitmap.stamp(*_hitbarStripeMasks[bithit & 1], offset, Bitmap::STAMP_OR);
 
     Vector2i boomPosition {bithit, _hitbar->_positionY + _hitbar->_height};
-    boomBomb(bomb, true, boomPosition, BOMBHIT_BOTTOM);
-  }
+    boomBomb(entity, true, boomPosition, BOMBHIT_BOTTOM);
+  });
+  _entities.flush();
 }
 
 void GameState::boomAllBombs()
 {
-  for(auto& bomb : _bombs){
-    if(!bomb._isAlive) continue;
-    boomBomb(bomb, false);
-  }
+  _entities.eachReverse<Bomb>([this](EntityStore::Entity_t entity, const Bomb&){boomBomb(entity, false);});
+  _entities.flush();
 }
 
 void GameState::doCollisionsBombsCannon()
@@ -1434,7 +1384,7 @@ void GameState::doCollisionsBombsCannon()
   if(_cannon._isBooming)
     return;
 
-  if(_bombCount == 0)
+  if(_entities.count<Bomb>() == 0)
     return;
 
   if(_isAliensAboveInvasionRow)
@@ -1446,156 +1396,142 @@ void GameState::doCollisionsBombsCannon()
   const Bitmap* aBitmap {nullptr};
   const Bitmap* bBitmap {nullptr};
 
-  aPosition._x = _cannon._position._x;
-  aPosition._y = _cannon._position._y;
+  aPosition = _cannon._position.toVector2i();
 
-  aBitmap = &(pxr::assets->getBitmap(_cannon._cannonKey, _worldScale));
+  aBitmap = _bitmaps[_cannon._cannonKey];
 
-  for(auto& bomb : _bombs){
-    if(!bomb._isAlive)
-      continue;
-  
-    bPosition._x = bomb._position._x;
-    bPosition._y = bomb._position._y;
+  _entities.eachReverse<Bomb>([&](EntityStore::Entity_t entity, const Bomb& bomb){
+    bPosition = bomb._position.toVector2i();
 
     BombClass& bc = _bombClasses[bomb._classId];
 
-    bBitmap = &(pxr::assets->getBitmap(bc._bitmapKeys[bomb._frame], _worldScale));
+    bBitmap = _bitmaps[bc._bitmapKeys[bomb._frame]];
 
     const Collision& c = testCollision(aPosition, *aBitmap, bPosition, *bBitmap, false);
 
     if(c._isCollision){
       boomCannon();
-      boomBomb(bomb);
+      boomBomb(entity);
     }
-  }
+  });
+  _entities.flush();
 }
 
-void GameState::doCollisionsBombsLaser()
+void GameState::sweepLaser(const Bitmap& bitmap, Vector2i position, int32_t targetDrop,
+                           LaserTarget target, int32_t index, LaserHit& hit)
 {
-  if(!_laser._isAlive)
-    return;
-
-  if(_bombCount == 0)
-    return;
-
-  Vector2i aPosition {};
-  Vector2i bPosition {};
-
-  const Bitmap* aBitmap {nullptr};
-  const Bitmap* bBitmap {nullptr};
-
-  aPosition._x = _laser._position._x;
-  aPosition._y = _laser._position._y;
-
-  aBitmap = &(pxr::assets->getBitmap(_laser._bitmapKey, _worldScale));
-
-  for(auto& bomb : _bombs){
-    if(!bomb._isAlive)
-      continue;
+  // The laser is treated as a solid column swept from its last to its current position. A 
+  // target which dropped during the tick is tested at its current position by extending the
+  // sweep down by the drop, i.e. the sweep is in the target's frame of reference.
   
-    bPosition._x = bomb._position._x;
-    bPosition._y = bomb._position._y;
+  const Bitmap& laserBitmap = *_bitmaps[_laser._bitmapKey];
 
-    BombClass& bc = _bombClasses[bomb._classId];
+  int32_t x = _laser._position._x.toInt();
+  int32_t yMin = _laser._lastPosition._y.toInt() - targetDrop;
+  int32_t yMax = _laser._position._y.toInt() + laserBitmap.getHeight() - 1;
 
-    bBitmap = &(pxr::assets->getBitmap(bc._bitmapKeys[bomb._frame], _worldScale));
+  ColumnSweep sweep = testColumnSweep(x, laserBitmap.getWidth(), yMin, yMax, position, bitmap);
+  if(!sweep._isHit)
+    return;
 
-    const Collision& c = testCollision(aPosition, *aBitmap, bPosition, *bBitmap, false);
+  // The time of the hit is when the laser's tip reached the pixel hit.
+  int32_t tipStart = yMin + laserBitmap.getHeight() - 1;
+  int32_t travel = yMax - tipStart;
+  float time = 0.f;
+  if(travel > 0)
+    time = std::clamp(static_cast<float>(sweep._screenY - tipStart) / travel, 0.f, 1.f);
 
-    if(c._isCollision){
-      boomLaser(true);
-      if(randUniformSignedInt(0, bc._laserSurvivalChance) != 0) boomBomb(bomb);
-    }
-  }
+  // Ties go to the target tested first.
+  if(hit._target != LASERTARGET_NONE && time >= hit._time)
+    return;
+
+  hit = {target, time, index, sweep._pixel};
 }
 
-void GameState::doCollisionsLaserAliens()
+void GameState::doCollisionsLaser()
 {
   if(!_laser._isAlive)
     return;
 
-  if(_isAliensSpawning)
-    return;
-
-  if(_isAliensFrozen)
-    return;
-
-  if(_alienPopulation == 0)
-    return;
-
-  Vector2i aPosition {}; 
-  Vector2i bPosition {};
-
-  const Bitmap* aBitmap {nullptr};
-  const Bitmap* bBitmap {nullptr};
+  // Find the earliest hit of all potential targets.
+  LaserHit hit {LASERTARGET_NONE, 0.f, 0, {0, 0}};
 
-  aPosition._x = _laser._position._x;
-  aPosition._y = _laser._position._y;
+  _entities.each<Bomb>([this, &hit](EntityStore::Entity_t entity, const Bomb& bomb){
+    const BombClass& bc = _bombClasses[bomb._classId];
+    Vector2i position = bomb._position.toVector2i();
+    int32_t drop = (bomb._position._y - bc._speed).toInt() - position._y;
+    sweepLaser(*_bitmaps[bc._bitmapKeys[bomb._frame]], position, drop, LASERTARGET_BOMB, entity, hit);
+  });
 
-  aBitmap = &(pxr::assets->getBitmap(_laser._bitmapKey, _worldScale));
+  if(!_isAliensSpawning && !_isAliensFrozen){
+    for(int32_t row = 0; row < _gridHeight; ++row){
+      for(uint64_t alive = _alienAliveMasks[row]; alive != 0; alive &= alive - 1){
+        int32_t col = std::countr_zero(alive);
+        int32_t alien = toAlienIndex(row, col);
+        const AlienClass& ac = _alienClasses[_alienClassIds[alien]];
+        const Bitmap& bitmap = *_bitmaps[ac._bitmapKeys[(_alienFrameMasks[row] >> col) & 1]];
+        sweepLaser(bitmap, {_alienXs[alien], _alienYs[alien]}, 0, LASERTARGET_ALIEN, alien, hit);
+      }
+    }
+  }
 
-  for(auto& row : _grid){
-    for(auto& alien : row){
-      if(!alien._isAlive)
-        continue;
+  for(int32_t i = 0; i < static_cast<int32_t>(_bunkers.size()); ++i){
+    const Bunker& bunker = *_bunkers[i];
+    sweepLaser(bunker._bitmap, bunker._position, 0, LASERTARGET_BUNKER, i, hit);
+  }
 
-      const AlienClass& ac = _alienClasses[alien._classId];
+  if(_ufo._isAlive && _ufo._phase){
+    const UfoClass& uc = _ufoClasses[_ufo._classId];
+    sweepLaser(*_bitmaps[uc._shipKey], _ufo._position.toVector2i(), 0, LASERTARGET_UFO, 0, hit);
+  }
 
-      bPosition = alien._position; 
-      bBitmap = &(pxr::assets->getBitmap(ac._bitmapKeys[alien._frame], _worldScale));
+  switch(hit._target){
+    case LASERTARGET_NONE:
+      break;
 
-      const Collision& c = testCollision(aPosition, *aBitmap, bPosition, *bBitmap, false);
+    case LASERTARGET_BOMB:
+      {
+        const BombClass& bc = _bombClasses[_entities.get<Bomb>(hit._index)._classId];
+        boomLaser(true);
+        if(randUniformSignedInt(0, bc._laserSurvivalChance) != 0) boomBomb(hit._index);
+      }
+      break;
 
-      if(c._isCollision){
-        if(alien._classId == CUTTLETWIN){
-          _alienMorpher = nullptr;
+    case LASERTARGET_ALIEN:
+      {
+        int32_t alien = hit._index;
+        AlienClassId classId = _alienClassIds[alien];
+        if(classId == CUTTLETWIN){
+          _alienMorpher = nullAlien;
           _isAliensMorphing = false;
+          cancelTimer(TIMER_ALIEN_MORPH_END);
         }
-        if(_levels[_levelIndex]._isCuttlesOn && alien._classId == CRAB && alien._col != gridWidth - 1)
+        if(_levels[_levelIndex]._isCuttlesOn && classId == CRAB && (alien % _gridWidth) != _gridWidth - 1)
           morphAlien(alien);
         else
           boomAlien(alien);
 
         boomLaser(false);
-        return;
       }
-    }
-  }
-}
-
-void GameState::doCollisionsLaserUfo()
-{
-  if(!_laser._isAlive)
-    return;
-
-  if(!_ufo._isAlive)
-    return;
-
-  if(!_ufo._phase)
-    return;
-
-  Vector2i aPosition {}; 
-  Vector2i bPosition {};
-
-  const Bitmap* aBitmap {nullptr};
-  const Bitmap* bBitmap {nullptr};
-
-  aPosition._x = _laser._position._x;
-  aPosition._y = _laser._position._y;
-  bPosition._x = _ufo._position._x;
-  bPosition._y = _ufo._position._y;
-
-  const UfoClass& uc = _ufoClasses[_ufo._classId];
-  bBitmap = &(pxr::assets->getBitmap(uc._shipKey, _worldScale));
-  aBitmap = &(pxr::assets->getBitmap(_laser._bitmapKey, _worldScale));
+      break;
 
-  const Collision& c = testCollision(aPosition, *aBitmap, bPosition, *bBitmap, false);
+    case LASERTARGET_BUNKER:
+      {
+        Bunker& bunker = *_bunkers[hit._index];
+        boomLaser(false);
+        boomBunker(bunker, hit._pixel);
+        if(bunker._bitmap.isApproxEmpty(_bunkerDeleteThreshold))
+          deleteBunker(hit._index);
+      }
+      break;
 
-  if(c._isCollision){
-    boomLaser(false);
-    boomUfo();
+    case LASERTARGET_UFO:
+      boomLaser(false);
+      boomUfo();
+      break;
   }
+
+  _entities.flush();
 }
 
 void GameState::doCollisionsLaserSky()
@@ -1603,14 +1539,15 @@ void GameState::doCollisionsLaserSky()
   if(!_laser._isAlive)
     return;
 
-  if(_laser._position._y + _laser._height < _worldTopBorderY)
+  if(_laser._position._y + Fixed{_laser._height} < Fixed{_worldTopBorderY})
     return;
 
   _laser._isAlive = false;
   Vector2i position {};
-  position._x = _laser._position._x - ((_bombBoomWidth - _laser._width) / 2);
-  position._y = _laser._position._y;
+  position._x = _laser._position._x.toInt() - ((_bombBoomWidth - _laser._width) / 2);
+  position._y = _laser._position._y.toInt();
   spawnBoom(position, BOMBHIT_MIDAIR, _laser._colorIndex);
+  _entities.flush();
 }
 
 bool GameState::doCollisionsAliensBorders()
@@ -1621,40 +1558,28 @@ bool GameState::doCollisionsAliensBorders()
   if(_isAliensFrozen)
     return false;
 
-  if(_alienPopulation == 0)
+  if(getAlienPopulation() == 0)
     return false;
 
+  // Only called at the end of a move pass, when all aliens in a column share an x position, 
+  // thus only the extreme populated columns need testing.
+  uint64_t populatedColumns = getPopulatedColumnsMask();
+
   switch(_alienMoveDirection){
 
     // If moving left test against left border.
     case -1: 
-      for(int32_t col = 0; col < gridWidth; ++col){
-        for(int32_t row = 0; row < gridHeight; ++row){
-          Alien& alien = _grid[row][col];
-
-          if(!alien._isAlive)
-            continue;
-
-          if(alien._position._x <= _worldLeftBorderX)
-            return true;
-        }
+      {
+        int32_t col = std::countr_zero(populatedColumns);
+        return _alienXs[toAlienIndex(0, col)] <= _worldLeftBorderX;
       }
-      break;
 
     // If moving right test against right border.
     case 1:
-      for(int32_t col = gridWidth - 1; col > 0; --col){
-        for(int32_t row = 0; row < gridHeight; ++row){
-          Alien& alien = _grid[row][col];
-
-          if(!alien._isAlive)
-            continue;
-
-          if(alien._position._x + _alienXSeperation >= _worldRightBorderX)
-            return true;
-        }
+      {
+        int32_t col = 63 - std::countl_zero(populatedColumns);
+        return _alienXs[toAlienIndex(0, col)] + _alienXSeperation >= _worldRightBorderX;
       }
-      break;
 
     default:
       assert(0); // should never happen.
@@ -1665,7 +1590,7 @@ bool GameState::doCollisionsAliensBorders()
 
 void GameState::doCollisionsBunkersBombs()
 {
-  if(_bombCount <= 0)
+  if(_entities.count<Bomb>() == 0)
     return;
 
   if(_bunkers.size() <= 0)
@@ -1677,102 +1602,64 @@ void GameState::doCollisionsBunkersBombs()
   const Bitmap* aBitmap {nullptr};
   const Bitmap* bBitmap {nullptr};
 
-  for(auto& bomb : _bombs){
-    if(!bomb._isAlive)
-      continue;
+  // Only the first hit found is resolved each tick.
+  bool isHit {false};
+  _entities.eachReverse<Bomb>([&](EntityStore::Entity_t entity, const Bomb& bomb){
+    if(isHit)
+      return;
 
-    aPosition._y = bomb._position._y;
+    aPosition = bomb._position.toVector2i();
 
     if(aPosition._y < _bunkerSpawnY)
-      continue;
+      return;
 
     if(aPosition._y > _bunkerSpawnY + _bunkerHeight)
-      continue;
-
-    aPosition._x = bomb._position._x;
+      return;
 
     const BombClass& bc = _bombClasses[bomb._classId];
-    aBitmap = &(pxr::assets->getBitmap(bc._bitmapKeys[bomb._frame], _worldScale));
+    aBitmap = _bitmaps[bc._bitmapKeys[bomb._frame]];
 
     for(auto iter = _bunkers.begin(); iter != _bunkers.end(); ++iter){
       Bunker& bunker = *(*iter);
 
-      bPosition._x = bunker._position._x;
-      bPosition._y = bunker._position._y;
+      bPosition = bunker._position;
 
       bBitmap = &bunker._bitmap;
 
       const Collision& c = testCollision(aPosition, *aBitmap, bPosition, *bBitmap, false);
 
       if(c._isCollision){
-        boomBomb(bomb);
+        boomBomb(entity);
         boomBunker(bunker, c._bPixels.front());
         if(bunker._bitmap.isApproxEmpty(_bunkerDeleteThreshold))
-          _bunkers.erase(iter);
+          deleteBunker(static_cast<int32_t>(iter - _bunkers.begin()));
+        isHit = true;
         return;
       }
     }
-  }
+  });
+  _entities.flush();
 }
 
-void GameState::doCollisionsBunkersLaser()
+void GameState::doCollisionsBunkersAliens()
 {
-  if(!_laser._isAlive)
+  if(_isAliensSpawning)
+    return;
+
+  if(_isAliensFrozen)
     return;
 
   if(_bunkers.size() == 0)
     return;
 
-  Vector2i aPosition {};
-  Vector2i bPosition {};
-
-  const Bitmap* aBitmap {nullptr};
-  const Bitmap* bBitmap {nullptr};
-
-  aPosition._x = _laser._position._x;
-  aPosition._y = _laser._position._y;
-
-  aBitmap = &(pxr::assets->getBitmap(_laser._bitmapKey, _worldScale));
-
-  for(auto iter = _bunkers.begin(); iter != _bunkers.end(); ++iter){
-    Bunker& bunker = *(*iter);
-
-    bPosition._x = bunker._position._x;
-    bPosition._y = bunker._position._y;
-
-    bBitmap = &(bunker._bitmap);
-
-    const Collision& c = testCollision(aPosition, *aBitmap, bPosition, *bBitmap, false);
-    
-    if(c._isCollision){
-      boomLaser(false);
-      boomBunker(bunker, c._bPixels.front());
-      if(bunker._bitmap.isApproxEmpty(_bunkerDeleteThreshold))
-        _bunkers.erase(iter);
-      return;
-    }
-  }
-}
-
-void GameState::doCollisionsBunkersAliens()
-{
-  if(_isAliensSpawning)
-    return;
-
-  if(_isAliensFrozen)
-    return;
-
-  if(_bunkers.size() == 0)
-    return;
-
-  if(_alienPopulation == 0)
+  if(getAlienPopulation() == 0)
     return;
 
   int32_t bottomRow {0};
-  while(_rowPops[bottomRow] == 0)
+  while(_alienAliveMasks[bottomRow] == 0)
     ++bottomRow;
 
-  if(_grid[bottomRow][0]._position._y > _bunkerSpawnY + _bunkerHeight)
+  if(_alienYs[toAlienIndex(bottomRow, 0)] > _bunkerSpawnY + _bunkerHeight)
     return;
 
   Vector2i aPosition {};
@@ -1781,22 +1668,21 @@ void GameState::doCollisionsBunkersAliens()
   const Bitmap* aBitmap {nullptr};
   const Bitmap* bBitmap {nullptr};
 
-  for(const auto& alien : _grid[bottomRow]){
-    if(!alien._isAlive)
-      continue;
+  for(uint64_t alive = _alienAliveMasks[bottomRow]; alive != 0; alive &= alive - 1){
+    int32_t col = std::countr_zero(alive);
+    int32_t alien = toAlienIndex(bottomRow, col);
 
-    aPosition._x = alien._position._x;
-    aPosition._y = alien._position._y;
+    aPosition._x = _alienXs[alien];
+    aPosition._y = _alienYs[alien];
 
-    const AlienClass& ac = _alienClasses[alien._classId];
-    Assets::Key_t bitmapKey = ac._bitmapKeys[alien._frame];
-    aBitmap = &(pxr::assets->getBitmap(bitmapKey, _worldScale));
+    const AlienClass& ac = _alienClasses[_alienClassIds[alien]];
+    Assets::Key_t bitmapKey = ac._bitmapKeys[(_alienFrameMasks[bottomRow] >> col) & 1];
+    aBitmap = _bitmaps[bitmapKey];
 
     for(auto iter = _bunkers.begin(); iter != _bunkers.end(); ++iter){
       Bunker& bunker = *(*iter);
 
-      bPosition._x = bunker._position._x;
-      bPosition._y = bunker._position._y;
+      bPosition = bunker._position;
 
       bBitmap = &(bunker._bitmap);
 
@@ -1807,7 +1693,7 @@ void GameState::doCollisionsBunkersAliens()
                                c._bOverlap._ymax - 1, c._bOverlap._xmax - 1, false);
 
         if(bunker._bitmap.isApproxEmpty(_bunkerDeleteThreshold))
-          _bunkers.erase(iter);
+          deleteBunker(static_cast<int32_t>(iter - _bunkers.begin()));
 
         return;
       }
@@ -1815,6 +1701,31 @@ void GameState::doCollisionsBunkersAliens()
   }
 }
 
+void GameState::addSystems()
+{
+  // The systems are added in the order they ran in serially; systems that conflict keep that
+  // order, so a tick has the same result however many workers run it. The movers of the bombs,
+  // laser and ufo are independent of each other and of the fleet. The collision passes touch
+  // most of the game state so are run as barriers.
+
+  _scheduler->addSystem(0, RES_BOMBS, [this]{doBombMoving(_tickBeats);});
+  _scheduler->addSystem(0, RES_LASER, [this]{doLaserMoving();});
+  _scheduler->addSystem(RES_GAME, RES_ALIENS | RES_CANNON | RES_TIMERS | RES_GAME | RES_CONTEXT, 
+                        [this]{doAlienMoving(_tickBeats);});
+  _scheduler->addSystem(RES_ALIENS | RES_GAME, RES_BOMBS | RES_CONTEXT, 
+                        [this]{doAlienBombing(_tickBeats);});
+  _scheduler->addSystem(RES_GAME, RES_CANNON | RES_CONTEXT, [this]{doCannonMoving();});
+  _scheduler->addSystem(0, RES_UFO, [this]{doUfoMoving();});
+  _scheduler->addSystem(RES_CANNON | RES_GAME, RES_LASER | RES_CONTEXT, [this]{doCannonFiring();});
+  _scheduler->addSystem(RES_ALL, RES_ALL, [this]{doCollisionsUfoBorders();});
+  _scheduler->addSystem(RES_ALL, RES_ALL, [this]{doCollisionsBombsHitbar();});
+  _scheduler->addSystem(RES_ALL, RES_ALL, [this]{doCollisionsBombsCannon();});
+  _scheduler->addSystem(RES_ALL, RES_ALL, [this]{doCollisionsLaser();});
+  _scheduler->addSystem(RES_ALL, RES_ALL, [this]{doCollisionsBunkersBombs();});
+  _scheduler->addSystem(RES_ALL, RES_ALL, [this]{doCollisionsBunkersAliens();});
+  _scheduler->addSystem(RES_ALL, RES_ALL, [this]{doCollisionsLaserSky();});
+}
+
 bool GameState::incrementGridIndex(GridIndex& index)
 {
   // Increments index from left-to-right along the columns, moving up a row and back to the left
@@ -1823,10 +1734,10 @@ bool GameState::incrementGridIndex(GridIndex& index)
   // a loop.
   
   ++index._col;
-  if(index._col >= gridWidth){
+  if(index._col >= _gridWidth){
     index._col = 0;
     ++index._row;
-    if(index._row >= gridHeight){
+    if(index._row >= _gridHeight){
       index._row = 0;
       return true;
     }
@@ -1834,6 +1745,22 @@ bool GameState::incrementGridIndex(GridIndex& index)
   return false;
 }
 
+int32_t GameState::getAlienPopulation() const
+{
+  int32_t population {0};
+  for(uint64_t alive : _alienAliveMasks)
+    population += std::popcount(alive);
+  return population;
+}
+
+uint64_t GameState::getPopulatedColumnsMask() const
+{
+  uint64_t populated {0};
+  for(uint64_t alive : _alienAliveMasks)
+    populated |= alive;
+  return populated;
+}
+
 void GameState::addHudMsg(const char* msg, const Color3f& color)
 {
   int32_t msgWidth = _font->calculateStringWidth(msg);
@@ -1861,7 +1788,7 @@ void GameState::doInvasionTest()
   if(_isGameOver)
     return;
 
-  if(_alienPopulation == 0)
+  if(getAlienPopulation() == 0)
     return;
 
   if(_isAliensFrozen)
@@ -1874,11 +1801,13 @@ void GameState::doInvasionTest()
   if(_isAliensDropping)
     return;
 
-  int32_t minY {std::numeric_limits<int32_t>::max()};
-  for(auto& row : _grid)
-    for(auto& alien : row)
-      if(alien._isAlive)
-        minY = std::min(minY, alien._position._y);
+  // Not dropping, so all aliens in a row share a y position and the lowest is in the lowest 
+  // populated row.
+  int32_t bottomRow {0};
+  while(_alienAliveMasks[bottomRow] == 0)
+    ++bottomRow;
+
+  int32_t minY = _alienYs[toAlienIndex(bottomRow, 0)];
 
   if(minY == _alienInvasionHeight)
     startGameOver();
@@ -1887,7 +1816,7 @@ void GameState::doInvasionTest()
   }
 }
 
-void GameState::startRoundIntro()
+void GameState::addRoundIntroMsg()
 {
   int32_t round = static_cast<SpaceInvaders*>(_app)->getRound();
   std::string msg {};
@@ -1895,20 +1824,13 @@ void GameState::startRoundIntro()
   msg += " ";
   msg += std::to_string(round);
   addHudMsg(msg.c_str(), colors::red);
-  _msgClockSeconds = 0.f;
-  _isRoundIntro = true;
 }
 
-void GameState::doRoundIntro(float dt)
+void GameState::startRoundIntro()
 {
-  if(!_isRoundIntro)
-    return;
-
-  _msgClockSeconds += dt;
-  if(_msgClockSeconds >= msgPeriodSeconds){
-    removeHudMsg();
-    _isRoundIntro = false;
-  }
+  addRoundIntroMsg();
+  restartTimer(TIMER_MSG_END, toTicks(msgPeriodSeconds));
+  _isRoundIntro = true;
 }
 
 void GameState::startGameOver()
@@ -1924,33 +1846,27 @@ void GameState::startGameOver()
 
   addHudMsg(msgGameOver, colors::red);
 
-  _msgClockSeconds = 0.f;
+  restartTimer(TIMER_MSG_END, toTicks(msgPeriodSeconds));
   _isGameOver = true;
 }
 
-void GameState::doGameOver(float dt)
+void GameState::endGameOver()
 {
-  if(!_isGameOver)
-    return;
-
   assert(!_isVictory);
   assert(!_isRoundIntro);
 
-  _msgClockSeconds += dt;
-  if(_msgClockSeconds >= msgPeriodSeconds){
-    SpaceInvaders* si = static_cast<SpaceInvaders*>(_app);
-    si->stopScoreHudFlash();
-    removeHudMsg();
-    if(si->isHiScore(si->getScore()))
-      _app->switchState(HiScoreRegState::name);
-    else 
-      _app->switchState(HiScoreBoardState::name);
-  }
+  SpaceInvaders* si = static_cast<SpaceInvaders*>(_app);
+  si->stopScoreHudFlash();
+  removeHudMsg();
+  if(si->isHiScore(si->getScore()))
+    _app->switchState(HiScoreRegState::name);
+  else 
+    _app->switchState(HiScoreBoardState::name);
 }
 
 void GameState::doVictoryTest()
 {
-  if(!_isVictory && _alienPopulation == 0){
+  if(!_isVictory && getAlienPopulation() == 0){
     _beatBox.pause();
     if(_ufo._isAlive)
       return;
@@ -1970,57 +1886,141 @@ void GameState::startVictory()
 
   boomAllBombs();
 
-  _msgClockSeconds = 0.f;
+  restartTimer(TIMER_MSG_END, toTicks(msgPeriodSeconds));
   _isVictory = true;
 }
 
-void GameState::doVictory(float dt)
+void GameState::endVictory()
 {
-  if(!_isVictory)
-    return;
-
   assert(!_isGameOver);
   assert(!_isRoundIntro);
 
-  _msgClockSeconds += dt;
-  if(_msgClockSeconds > msgPeriodSeconds){
-    SpaceInvaders* si = static_cast<SpaceInvaders*>(_app);
-    si->addRound(1);
-    si->stopScoreHudFlash();
-    removeHudMsg();
-    _app->switchState(SosState::name);
+  SpaceInvaders* si = static_cast<SpaceInvaders*>(_app);
+  si->addRound(1);
+  si->stopScoreHudFlash();
+  removeHudMsg();
+  _app->switchState(SosState::name);
+}
+
+void GameState::onTimer(TimerWheel::EventId_t event, int32_t data)
+{
+  switch(event){
+    case TIMER_MSG_END:
+      if(_isRoundIntro){
+        removeHudMsg();
+        _isRoundIntro = false;
+      }
+      else if(_isGameOver)
+        endGameOver();
+      else if(_isVictory)
+        endVictory();
+      break;
+
+    case TIMER_ALIEN_BOOM_END:
+      _alienBoomer = nullAlien;
+      _isAliensFrozen = false;
+      _isAliensBooming = false;
+      break;
+
+    case TIMER_ALIEN_MORPH_END:
+      // predicate: _alienMorpher is not in the last column.
+      {
+        if(!_isAliensMorphing || getAlienPopulation() == 0)
+          break;
+
+        _alienClassIds[_alienMorpher] = CUTTLE;
+
+        int32_t neighbour = _alienMorpher + 1;
+        _alienClassIds[neighbour] = CUTTLE;
+        _alienAliveMasks[neighbour / _gridWidth] |= toColumnBit(neighbour % _gridWidth);
+
+        _isAliensMorphing = false;
+        _isAliensFrozen = false;
+        _alienMorpher = nullAlien;
+      }
+      break;
+
+    case TIMER_CANNON_BOOM_END:
+      _cannon._isBooming = false;
+      cancelTimer(TIMER_CANNON_BOOM_FRAME);
+      spawnCannon(true);
+      break;
+
+    case TIMER_CANNON_BOOM_FRAME:
+      if(!_cannon._isBooming)
+        break;
+      _cannon._boomFrame = pxr::wrap(++_cannon._boomFrame, 0, cannonBoomFramesCount - 1);
+      restartTimer(TIMER_CANNON_BOOM_FRAME, toTicks(_cannon._boomFrameDuration));
+      break;
+
+    case TIMER_UFO_SPAWN:
+      // The spawn timer is not rearmed once ufos can no longer spawn this level; startNextLevel
+      // clears the wheel and endSpawning arms it again. Nor while a ufo is alive, as it rearms
+      // the timer when it leaves. A morphing twin hides its neighbour until the morph ends, so
+      // the neighbour still counts to the population.
+      if(_ufo._isAlive || _isGameOver || _isVictory || getAlienPopulation() + (_isAliensMorphing ? 1 : 0) <= 8)
+        break;
+
+      // Ufos wait for the fleet to finish dropping, the round intro and morphs.
+      if(_isAliensSpawning || _isAliensDropping || _isRoundIntro || getAlienPopulation() <= 8){
+        restartTimer(TIMER_UFO_SPAWN, 1);
+        break;
+      }
+
+      if(pxr::randUniformSignedInt(0, schrodingerSpawnChance) == 0)
+        spawnUfo(SCHRODINGER);
+      else
+        spawnUfo(SAUCER);
+      break;
+
+    case TIMER_UFO_PHASE:
+      if(!_ufo._isAlive)
+        break;
+      _ufo._phase = !_ufo._phase;
+      restartTimer(TIMER_UFO_PHASE, toTicks(_ufoClasses[_ufo._classId]._phasePeriodSeconds));
+      break;
+
+    case TIMER_UFO_BOOM_SCORE:
+      if(_isUfoBooming){
+        const UfoClass& uc = _ufoClasses[_ufo._classId];
+        _uidUfoScoringText = _hud->addTextLabel({
+          _ufo._position.toVector2i(),
+          _colorPalette[uc._colorIndex],
+          std::to_string(_ufoLastScoreGiven)
+        });
+        _isUfoBooming = false;
+        _isUfoScoring = true;
+        restartTimer(TIMER_UFO_BOOM_SCORE, toTicks(_ufoBoomScoreDuration));
+      }
+      else if(_isUfoScoring){
+        _hud->removeTextLabel(_uidUfoScoringText);
+        _isUfoScoring = false;
+      }
+      break;
+
+    case TIMER_BOMB_BOOM_END:
+      _entities.destroy(data);
+      break;
   }
 }
 
+void GameState::restartTimer(TimerEvent event, int32_t delayTicks)
+{
+  assert(event != TIMER_BOMB_BOOM_END);
+  _timers.cancel(_timerHandles[event]);
+  _timerHandles[event] = _timers.schedule(delayTicks, event);
+}
+
+void GameState::cancelTimer(TimerEvent event)
+{
+  assert(event != TIMER_BOMB_BOOM_END);
+  _timers.cancel(_timerHandles[event]);
+}
+
 void GameState::onUpdate(double now, float dt)
 {
-  int32_t beats = _cycles[_activeCycle][_activeBeat]; 
-
-  doRoundIntro(dt);
-  doAlienMorphing(dt);
-  doBombMoving(beats, dt);
-  doLaserMoving(dt);
-  doAlienMoving(beats);
-  doAlienBombing(beats);
-  doCannonMoving(dt);
-  doUfoMoving(dt);
-  doUfoPhasing(dt);
-  doUfoSpawning();
-  doCannonBooming(dt);
-  doAlienBooming(dt);
-  doBombBoomBooming(dt);
-  doUfoBoomScoring(dt);
-  doCannonFiring();
-  doCollisionsUfoBorders();
-  doCollisionsBombsHitbar();
-  doCollisionsBombsCannon();
-  doCollisionsBombsLaser();
-  doCollisionsLaserAliens();
-  doCollisionsBunkersBombs();
-  doCollisionsBunkersLaser();
-  doCollisionsBunkersAliens();
-  doCollisionsLaserUfo();
-  doCollisionsLaserSky();
+  _tickBeats = _cycles[_activeCycle][_activeBeat]; 
+  _scheduler->run();
 
 
   //================================================================================
@@ -2028,57 +2028,465 @@ void GameState::onUpdate(double now, float dt)
   if(pxr::input->isKeyPressed(Input::KEY_b))
     boomCannon();
 
+  if(pxr::input->isKeyPressed(Input::KEY_s)){
+    ByteWriter writer {};
+    saveSnapshot(writer);
+    _quickSnapshot = writer.getBytes();
+  }
+
+  if(pxr::input->isKeyPressed(Input::KEY_l) && !_quickSnapshot.empty()){
+    ByteReader reader {_quickSnapshot.data(), _quickSnapshot.size()};
+    loadSnapshot(reader);
+    return;
+  }
+
   if(pxr::input->isKeyPressed(Input::KEY_a)){
-    for(auto& row : _grid){
-      for(auto& alien : row){
-        if(alien._isAlive){
-          boomAlien(alien);
-          goto BOOMED;
-        }
+    for(int32_t row = 0; row < _gridHeight; ++row){
+      if(_alienAliveMasks[row] != 0){
+        boomAlien(toAlienIndex(row, std::countr_zero(_alienAliveMasks[row])));
+        break;
       }
     }
   }
-  BOOMED:
 
   //================================================================================
 
   doVictoryTest();
-  doVictory(dt);
   doInvasionTest();
-  doGameOver(dt);
+  _timers.advance([this](TimerWheel::EventId_t event, int32_t data){onTimer(event, data);});
   updateActiveCycleBeat();
   _beatBox.doBeats(dt);
 }
 
+void GameState::saveSnapshot(ByteWriter& writer) const
+{
+  // Header; identifies the config the snapshot is valid for.
+  writer.write(snapshotMagic);
+  writer.write(snapshotVersion);
+  writer.write(_worldScale);
+  writer.write(_gridWidth);
+  writer.write(_gridHeight);
+  writer.write(_maxBombs);
+  writer.write(_bunkerSpawnCount);
+
+  for(int32_t section = 0; section < SNAPSHOT_SECTION_COUNT; ++section)
+    packSnapshotSection(static_cast<SnapshotSection>(section), writer);
+}
+
+void GameState::hashSnapshotSections(std::span<uint64_t> hashes) const
+{
+  assert(static_cast<int32_t>(hashes.size()) == SNAPSHOT_SECTION_COUNT);
+
+  thread_local ByteWriter writer {};
+  for(int32_t section = 0; section < SNAPSHOT_SECTION_COUNT; ++section){
+    writer.clear();
+    packSnapshotSection(static_cast<SnapshotSection>(section), writer);
+    hashes[section] = hashState(writer.getBytes().data(), writer.getBytes().size());
+  }
+}
+
+const char* GameState::getSnapshotSectionName(SnapshotSection section)
+{
+  switch(section){
+    case SNAPSHOT_PLAYER: return "player";
+    case SNAPSHOT_TIMING: return "timing";
+    case SNAPSHOT_ALIENS: return "aliens";
+    case SNAPSHOT_UFO: return "ufo";
+    case SNAPSHOT_BOMBS: return "bombs";
+    case SNAPSHOT_CANNON: return "cannon";
+    case SNAPSHOT_DEFENCES: return "defences";
+    case SNAPSHOT_PHASE: return "phase";
+    default: return "unknown";
+  }
+}
+
+void GameState::packSnapshotSection(SnapshotSection section, ByteWriter& writer) const
+{
+  // The structs with padding are written a field at a time so snapshots are canonical.
+  SpaceInvaders* si = static_cast<SpaceInvaders*>(_app);
+  switch(section){
+    case SNAPSHOT_PLAYER:
+      writer.write(si->getScore());
+      writer.write(si->getLives());
+      writer.write(si->getRound());
+      writer.write(pxr::randGenerator.getState());
+      break;
+    case SNAPSHOT_TIMING:
+      _timers.pack(writer);
+      for(const auto& handle : _timerHandles)
+        writer.writeEach(handle._node, handle._generation);
+      _beatBox.pack(writer);
+      writer.write(_levelIndex);
+      writer.write(_activeCycle);
+      writer.write(_activeBeat);
+      break;
+    case SNAPSHOT_ALIENS:
+      writer.writeBytes(_alienXs.data(), _alienXs.size() * sizeof(int32_t));
+      writer.writeBytes(_alienYs.data(), _alienYs.size() * sizeof(int32_t));
+      writer.writeBytes(_alienClassIds.data(), _alienClassIds.size() * sizeof(AlienClassId));
+      writer.writeBytes(_alienAliveMasks.data(), _alienAliveMasks.size() * sizeof(uint64_t));
+      writer.writeBytes(_alienFrameMasks.data(), _alienFrameMasks.size() * sizeof(uint64_t));
+      writer.write(_alienMoveDirection);
+      writer.write(_dropsDone);
+      writer.write(_nextMover);
+      writer.write(_alienBoomer);
+      writer.write(_alienMorpher);
+      writer.write(_isAliensMorphing);
+      writer.write(_isAliensBooming);
+      writer.write(_isAliensSpawning);
+      writer.write(_isAliensDropping);
+      writer.write(_isAliensFrozen);
+      writer.write(_isAliensAboveInvasionRow);
+      writer.write(_haveAliensInvaded);
+      writer.write(_lastClassAlive);
+      break;
+    case SNAPSHOT_UFO:
+      writer.writeEach(_ufo._classId, _ufo._position, _ufo._phase, _ufo._isAlive);
+      writer.write(_ufoDirection);
+      writer.write(_ufoCounter);
+      writer.write(_ufoLastScoreGiven);
+      writer.write(_isUfoBooming);
+      writer.write(_isUfoScoring);
+      writer.write(_canUfosSpawn);
+      break;
+    case SNAPSHOT_BOMBS:
+      writer.write(_bombClock);
+      _entities.pack(writer);
+      break;
+    case SNAPSHOT_CANNON:
+      writer.writeEach(_laser._position, _laser._lastPosition, _laser._width, _laser._height, 
+                       _laser._colorIndex, _laser._speed, _laser._isAlive, _laser._bitmapKey);
+      writer.write(_shotCounter);
+      writer.writeEach(_cannon._spawnPosition, _cannon._position, _cannon._colorIndex, _cannon._width,
+                       _cannon._height, _cannon._moveDirection, _cannon._speed, _cannon._boomDuration, 
+                       _cannon._boomFrameDuration, _cannon._boomFrame, _cannon._isBooming, 
+                       _cannon._isAlive, _cannon._cannonKey, _cannon._boomKeys);
+      break;
+    case SNAPSHOT_DEFENCES:
+      _hitbar->_bitmap.pack(writer);
+      writer.write(static_cast<int32_t>(_bunkers.size()));
+      for(const auto& bunker : _bunkers){
+        writer.write(bunker->_position);
+        bunker->_bitmap.pack(writer);
+      }
+      break;
+    case SNAPSHOT_PHASE:
+      writer.write(_isRoundIntro);
+      writer.write(_isGameOver);
+      writer.write(_isVictory);
+      break;
+    default:
+      assert(0);
+  }
+}
+
+bool GameState::loadSnapshot(ByteReader& reader)
+{
+  uint32_t magic {0}, version {0};
+  int32_t worldScale {0}, gridWidth {0}, gridHeight {0}, maxBombs {0}, bunkerSpawnCount {0};
+  if(!reader.read(magic) || !reader.read(version) || !reader.read(worldScale) || 
+     !reader.read(gridWidth) || !reader.read(gridHeight) || !reader.read(maxBombs) || 
+     !reader.read(bunkerSpawnCount))
+    return false;
+
+  if(magic != snapshotMagic || version != snapshotVersion || worldScale != _worldScale || 
+     gridWidth != _gridWidth || gridHeight != _gridHeight || maxBombs != _maxBombs || 
+     bunkerSpawnCount != _bunkerSpawnCount)
+    return false;
+
+  // Nothing is changed until the whole snapshot has been decoded and validated.
+  if(!decodeSnapshot(reader, _snapshotLoad) || !isSnapshotValid(_snapshotLoad)){
+    pxr::log->log(Log::WARN, logstr::warn_malformed_snapshot);
+    return false;
+  }
+
+  applySnapshot(_snapshotLoad);
+  return true;
+}
+
+bool GameState::decodeSnapshot(ByteReader& reader, SnapshotLoad& load)
+{
+  load._alienXs.resize(_gridSize);
+  load._alienYs.resize(_gridSize);
+  load._alienClassIds.resize(_gridSize);
+  load._alienAliveMasks.resize(_gridHeight);
+  load._alienFrameMasks.resize(_gridHeight);
+
+  if(!load._hitbarBitmap)
+    load._hitbarBitmap = std::make_unique<Bitmap>(*_bitmaps[SpaceInvaders::BMK_HITBAR]);
+
+  bool isValid = reader.read(load._score) && reader.read(load._lives) && reader.read(load._round) && 
+                 reader.read(load._randState);
+
+  isValid = isValid && load._timers.unpack(reader);
+  for(auto& handle : load._timerHandles)
+    isValid = isValid && reader.readEach(handle._node, handle._generation);
+  isValid = isValid && load._beatBox.unpack(reader);
+
+  isValid = isValid &&
+    reader.read(load._levelIndex) && reader.read(load._activeCycle) && reader.read(load._activeBeat) &&
+    reader.readBytes(load._alienXs.data(), load._alienXs.size() * sizeof(int32_t)) &&
+    reader.readBytes(load._alienYs.data(), load._alienYs.size() * sizeof(int32_t)) &&
+    reader.readBytes(load._alienClassIds.data(), load._alienClassIds.size() * sizeof(AlienClassId)) &&
+    reader.readBytes(load._alienAliveMasks.data(), load._alienAliveMasks.size() * sizeof(uint64_t)) &&
+    reader.readBytes(load._alienFrameMasks.data(), load._alienFrameMasks.size() * sizeof(uint64_t)) &&
+    reader.read(load._alienMoveDirection) && reader.read(load._dropsDone) && 
+    reader.read(load._nextMover) && reader.read(load._alienBoomer) && reader.read(load._alienMorpher) && 
+    reader.read(load._isAliensMorphing) && reader.read(load._isAliensBooming) && 
+    reader.read(load._isAliensSpawning) && reader.read(load._isAliensDropping) && 
+    reader.read(load._isAliensFrozen) && reader.read(load._isAliensAboveInvasionRow) && 
+    reader.read(load._haveAliensInvaded) && reader.read(load._lastClassAlive);
+
+  isValid = isValid &&
+    reader.readEach(load._ufo._classId, load._ufo._position, load._ufo._phase, load._ufo._isAlive) && 
+    reader.read(load._ufoDirection) && reader.read(load._ufoCounter) && 
+    reader.read(load._ufoLastScoreGiven) && reader.read(load._isUfoBooming) && 
+    reader.read(load._isUfoScoring) && reader.read(load._canUfosSpawn);
+
+  isValid = isValid &&
+    reader.read(load._bombClock) && load._entities.unpack(reader) &&
+    reader.readEach(load._laser._position, load._laser._lastPosition, load._laser._width, 
+                    load._laser._height, load._laser._colorIndex, load._laser._speed, 
+                    load._laser._isAlive, load._laser._bitmapKey) && 
+    reader.read(load._shotCounter) && 
+    reader.readEach(load._cannon._spawnPosition, load._cannon._position, load._cannon._colorIndex, 
+                    load._cannon._width, load._cannon._height, load._cannon._moveDirection, 
+                    load._cannon._speed, load._cannon._boomDuration, load._cannon._boomFrameDuration, 
+                    load._cannon._boomFrame, load._cannon._isBooming, load._cannon._isAlive, 
+                    load._cannon._cannonKey, load._cannon._boomKeys) && 
+    load._hitbarBitmap->unpack(reader);
+
+  isValid = isValid && reader.read(load._bunkerCount) && 0 <= load._bunkerCount && 
+            load._bunkerCount <= _bunkerSpawnCount;
+  if(!isValid)
+    return false;
+
+  while(static_cast<int32_t>(load._bunkers.size()) > load._bunkerCount){
+    _spareBunkers.push_back(std::move(load._bunkers.back()));
+    load._bunkers.pop_back();
+  }
+  while(static_cast<int32_t>(load._bunkers.size()) < load._bunkerCount)
+    load._bunkers.push_back(makeBunker({}, SpaceInvaders::BMK_BUNKER));
+  for(int32_t i = 0; isValid && i < load._bunkerCount; ++i)
+    isValid = reader.read(load._bunkers[i]->_position) && load._bunkers[i]->_bitmap.unpack(reader);
+
+  return isValid && reader.read(load._isRoundIntro) && reader.read(load._isGameOver) && 
+         reader.read(load._isVictory);
+}
+
+bool GameState::isSnapshotValid(SnapshotLoad& load)
+{
+  auto isInRange = [](auto value, int32_t count){
+    return 0 <= static_cast<int32_t>(value) && static_cast<int32_t>(value) < count;
+  };
+  auto isBitmapKey = [&isInRange](Assets::Key_t key){return isInRange(key, SpaceInvaders::BMK_COUNT);};
+
+  // Player and timing.
+  if(!isInRange(load._lives, SpaceInvaders::maxPlayerLives + 1) || load._round < 0 ||
+     !isInRange(load._levelIndex, levelCount) || !isInRange(load._activeCycle, cycleCount) ||
+     !isInRange(load._activeBeat, cycleLength))
+    return false;
+
+  // Aliens; the boomer and morpher are indexed whenever set, not only whilst booming/morphing.
+  uint64_t fullRowMask = (_gridWidth == 64) ? ~uint64_t{0} : toColumnBit(_gridWidth) - 1;
+  for(int32_t row = 0; row < _gridHeight; ++row)
+    if((load._alienAliveMasks[row] | load._alienFrameMasks[row]) & ~fullRowMask)
+      return false;
+  for(AlienClassId classId : load._alienClassIds)
+    if(!isInRange(classId, alienClassCount))
+      return false;
+  if(!isInRange(load._nextMover._row, _gridHeight) || !isInRange(load._nextMover._col, _gridWidth) ||
+     !(load._alienBoomer == nullAlien || isInRange(load._alienBoomer, _gridSize)) ||
+     !(load._alienMorpher == nullAlien || (isInRange(load._alienMorpher, _gridSize) && 
+       (load._alienMorpher % _gridWidth) < _gridWidth - 1)) ||
+     (load._isAliensBooming && load._alienBoomer == nullAlien) ||
+     (load._isAliensMorphing && load._alienMorpher == nullAlien) ||
+     !isInRange(load._lastClassAlive, alienClassCount))
+    return false;
+
+  // Ufo, laser and cannon.
+  if(!isInRange(load._ufo._classId, ufoClassCount) ||
+     !isBitmapKey(load._laser._bitmapKey) || !isInRange(load._laser._colorIndex, paletteSize) ||
+     !isBitmapKey(load._cannon._cannonKey) || !isInRange(load._cannon._colorIndex, paletteSize) ||
+     !isInRange(load._cannon._boomFrame, cannonBoomFramesCount))
+    return false;
+  for(Assets::Key_t key : load._cannon._boomKeys)
+    if(!isBitmapKey(key))
+      return false;
+
+  // Bombs and booms.
+  bool isValid {true};
+  load._entities.each<Bomb>([&](EntityStore::Entity_t, const Bomb& bomb){
+    isValid = isValid && isInRange(bomb._classId, bombClassCount) && isInRange(bomb._frame, bombFramesCount);
+  });
+  load._entities.each<BombBoom>([&](EntityStore::Entity_t, const BombBoom& boom){
+    isValid = isValid && (boom._hit == BOMBHIT_BOTTOM || boom._hit == BOMBHIT_MIDAIR) && 
+              isInRange(boom._colorIndex, paletteSize);
+  });
+  if(!isValid)
+    return false;
+
+  // Timers; each boom end destroys its boom so must name a distinct live boom.
+  load._boomTimerEntities.clear();
+  load._timers.forEach([&](const TimerWheel::Timer& timer){
+    if(!isInRange(timer._event, TIMER_COUNT))
+      isValid = false;
+    else if(timer._event == TIMER_BOMB_BOOM_END){
+      if(load._entities.isAlive(timer._data) && load._entities.hasComponent<BombBoom>(timer._data))
+        load._boomTimerEntities.push_back(timer._data);
+      else
+        isValid = false;
+    }
+  });
+  std::sort(load._boomTimerEntities.begin(), load._boomTimerEntities.end());
+  if(!isValid || std::adjacent_find(load._boomTimerEntities.begin(), load._boomTimerEntities.end()) != 
+     load._boomTimerEntities.end())
+    return false;
+
+  for(int32_t event = 0; event < TIMER_COUNT; ++event){
+    const TimerWheel::Handle& handle = load._timerHandles[event];
+    if(load._timers.isPending(handle) && load._timers.getTimer(handle)._event != event)
+      return false;
+  }
+
+  return true;
+}
+
+void GameState::applySnapshot(SnapshotLoad& load)
+{
+  SpaceInvaders* si = static_cast<SpaceInvaders*>(_app);
+
+  // Tear down the HUD messages and sounds of the current state; rebuilt for the loaded state.
+  if(_isRoundIntro || _isGameOver || _isVictory)
+    removeHudMsg();
+  if(_isUfoScoring)
+    _hud->removeTextLabel(_uidUfoScoringText);
+  if(_ufo._isAlive)
+    mixer->stopChannel(_ufoSfxChannel);
+  si->stopScoreHudFlash();
+
+  std::swap(_timers, load._timers);
+  _timerHandles = load._timerHandles;
+  _beatBox = load._beatBox;
+  _levelIndex = load._levelIndex;
+  _activeCycle = load._activeCycle;
+  _activeBeat = load._activeBeat;
+
+  std::swap(_alienXs, load._alienXs);
+  std::swap(_alienYs, load._alienYs);
+  std::swap(_alienClassIds, load._alienClassIds);
+  std::swap(_alienAliveMasks, load._alienAliveMasks);
+  std::swap(_alienFrameMasks, load._alienFrameMasks);
+  _alienMoveDirection = load._alienMoveDirection;
+  _dropsDone = load._dropsDone;
+  _nextMover = load._nextMover;
+  _alienBoomer = load._alienBoomer;
+  _alienMorpher = load._alienMorpher;
+  _isAliensMorphing = load._isAliensMorphing;
+  _isAliensBooming = load._isAliensBooming;
+  _isAliensSpawning = load._isAliensSpawning;
+  _isAliensDropping = load._isAliensDropping;
+  _isAliensFrozen = load._isAliensFrozen;
+  _isAliensAboveInvasionRow = load._isAliensAboveInvasionRow;
+  _haveAliensInvaded = load._haveAliensInvaded;
+  _lastClassAlive = load._lastClassAlive;
+
+  _ufo = load._ufo;
+  _ufoDirection = load._ufoDirection;
+  _ufoCounter = load._ufoCounter;
+  _ufoLastScoreGiven = load._ufoLastScoreGiven;
+  _isUfoBooming = load._isUfoBooming;
+  _isUfoScoring = load._isUfoScoring;
+  _canUfosSpawn = load._canUfosSpawn;
+
+  _bombClock = load._bombClock;
+  std::swap(_entities, load._entities);
+
+  _laser = load._laser;
+  _shotCounter = load._shotCounter;
+  _cannon = load._cannon;
+
+  std::swap(_hitbar->_bitmap, *load._hitbarBitmap);
+  std::swap(_bunkers, load._bunkers);
+  for(auto& bunker : load._bunkers)
+    _spareBunkers.push_back(std::move(bunker));
+  load._bunkers.clear();
+
+  _isRoundIntro = load._isRoundIntro;
+  _isGameOver = load._isGameOver;
+  _isVictory = load._isVictory;
+
+  si->setScore(load._score);
+  si->setLives(load._lives);
+  si->setRound(load._round);
+  pxr::randGenerator.setState(load._randState);
+
+  rebuildHud();
+}
+
+void GameState::rebuildHud()
+{
+  SpaceInvaders* si = static_cast<SpaceInvaders*>(_app);
+
+  if(_isAliensSpawning)
+    si->hideTopHud();
+  else
+    si->showTopHud();
+
+  if(_isRoundIntro)
+    addRoundIntroMsg();
+  else if(_isGameOver){
+    addHudMsg(msgGameOver, colors::red);
+    si->startScoreHudFlash();
+  }
+  else if(_isVictory){
+    addHudMsg(msgVictory, colors::green);
+    si->startScoreHudFlash();
+  }
+
+  if(_isUfoScoring){
+    const UfoClass& uc = _ufoClasses[_ufo._classId];
+    _uidUfoScoringText = _hud->addTextLabel({
+      _ufo._position.toVector2i(),
+      _colorPalette[uc._colorIndex],
+      std::to_string(_ufoLastScoreGiven)
+    });
+  }
+
+  if(_ufo._isAlive && !_isGameOver && !_isVictory)
+    _ufoSfxChannel = mixer->playSound(SpaceInvaders::SK_UFO_HIGH_PITCH, 1000);
+}
+
 void GameState::drawGrid()
 {
   if(_isRoundIntro) 
     return;
 
-  for(const auto& row : _grid){
-    for(const auto& alien : row){
-      if(alien._isAlive){
-        const AlienClass& ac = _alienClasses[alien._classId];
+  for(int32_t row = 0; row < _gridHeight; ++row){
+    for(uint64_t alive = _alienAliveMasks[row]; alive != 0; alive &= alive - 1){
+      int32_t col = std::countr_zero(alive);
+      int32_t alien = toAlienIndex(row, col);
 
-        Vector2f position(alien._position._x, alien._position._y);
-        Assets::Key_t bitmapKey = ac._bitmapKeys[alien._frame];
-        Color3f& color = _colorPalette[ac._colorIndex];
+      const AlienClass& ac = _alienClasses[_alienClassIds[alien]];
 
-        renderer->blitBitmap(position, pxr::assets->getBitmap(bitmapKey, _worldScale), color);
-      }
+      Vector2f position(_alienXs[alien], _alienYs[alien]);
+      Assets::Key_t bitmapKey = ac._bitmapKeys[(_alienFrameMasks[row] >> col) & 1];
+      Color3f& color = _colorPalette[ac._colorIndex];
+
+      renderer->blitBitmap(position, *_bitmaps[bitmapKey], color);
     }
   }
 
   if(_isAliensBooming){
-    assert(_alienBoomer != nullptr);
+    assert(_alienBoomer != nullAlien);
 
-    const AlienClass& ac = _alienClasses[_alienBoomer->_classId];
+    const AlienClass& ac = _alienClasses[_alienClassIds[_alienBoomer]];
 
-    Vector2f position(_alienBoomer->_position._x, _alienBoomer->_position._y);
+    Vector2f position(_alienXs[_alienBoomer], _alienYs[_alienBoomer]);
     Assets::Key_t bitmapKey = SpaceInvaders::BMK_ALIENBOOM;
     Color3f& color = _colorPalette[ac._colorIndex];
 
-    renderer->blitBitmap(position, pxr::assets->getBitmap(bitmapKey, _worldScale), color);
+    renderer->blitBitmap(position, *_bitmaps[bitmapKey], color);
   }
 }
 
@@ -2099,8 +2507,8 @@ void GameState::drawUfo()
   }
 
   renderer->blitBitmap(
-      _ufo._position, 
-      pxr::assets->getBitmap(bitmapKey, _worldScale), 
+      _ufo._position.toVector2f(), 
+      *_bitmaps[bitmapKey], 
       _colorPalette[uc._colorIndex]
   );
 }
@@ -2120,33 +2528,27 @@ void GameState::drawCannon()
 
   Color3f& color = _colorPalette[_cannon._colorIndex];
 
-  renderer->blitBitmap(_cannon._position, pxr::assets->getBitmap(bitmapKey, _worldScale), color);
+  renderer->blitBitmap(_cannon._position.toVector2f(), *_bitmaps[bitmapKey], color);
 }
 
 void GameState::drawBombs()
 {
-  for(auto& bomb : _bombs){
-    if(!bomb._isAlive)
-      continue;
-
+  _entities.each<Bomb>([this](EntityStore::Entity_t, const Bomb& bomb){
     const BombClass& bc = _bombClasses[bomb._classId];
     Assets::Key_t bitmapKey = bc._bitmapKeys[bomb._frame];
     Color3f& color = _colorPalette[bc._colorIndex];
-    renderer->blitBitmap(bomb._position, pxr::assets->getBitmap(bitmapKey, _worldScale), color);
-  }
+    renderer->blitBitmap(bomb._position.toVector2f(), *_bitmaps[bitmapKey], color);
+  });
 }
 
 void GameState::drawBombBooms()
 {
-  for(auto& boom : _bombBooms){
-    if(!boom._isAlive)
-      continue;
-
+  _entities.each<BombBoom>([this](EntityStore::Entity_t, const BombBoom& boom){
     Assets::Key_t bitmapKey = _bombBoomKeys[boom._hit];
     Color3f& color = _colorPalette[boom._colorIndex];
     Vector2f position = Vector2f(boom._position._x, boom._position._y);
-    renderer->blitBitmap(position, pxr::assets->getBitmap(bitmapKey, _worldScale), color);
-  }
+    renderer->blitBitmap(position, *_bitmaps[bitmapKey], color);
+  });
 }
 
 void GameState::drawLaser()
@@ -2154,7 +2556,7 @@ void GameState::drawLaser()
   if(!_laser._isAlive)
     return;
 
-  renderer->blitBitmap(_laser._position, pxr::assets->getBitmap(_laser._bitmapKey, _worldScale), _colorPalette[_laser._colorIndex]);
+  renderer->blitBitmap(_laser._position.toVector2f(), *_bitmaps[_laser._bitmapKey], _colorPalette[_laser._colorIndex]);
 }
 
 void GameState::drawHitbar()
@@ -2186,6 +2588,126 @@ void GameState::onEnter()
   startNextLevel();
 }
 
+template<typename Draw>
+void GameState::drawObservationSprites(Draw draw)
+{
+  // Draws as onDraw, calling draw(bitmap, position, colorIndex) for each sprite.
+
+  if(!_isRoundIntro){
+    for(int32_t row = 0; row < _gridHeight; ++row){
+      for(uint64_t alive = _alienAliveMasks[row]; alive != 0; alive &= alive - 1){
+        int32_t col = std::countr_zero(alive);
+        int32_t alien = toAlienIndex(row, col);
+        const AlienClass& ac = _alienClasses[_alienClassIds[alien]];
+        Assets::Key_t bitmapKey = ac._bitmapKeys[(_alienFrameMasks[row] >> col) & 1];
+        draw(*_bitmaps[bitmapKey], Vector2i{_alienXs[alien], _alienYs[alien]}, ac._colorIndex);
+      }
+    }
+    if(_isAliensBooming){
+      const AlienClass& ac = _alienClasses[_alienClassIds[_alienBoomer]];
+      Vector2i position {_alienXs[_alienBoomer], _alienYs[_alienBoomer]};
+      draw(*_bitmaps[SpaceInvaders::BMK_ALIENBOOM], position, ac._colorIndex);
+    }
+  }
+
+  if((_ufo._isAlive && _ufo._phase) || _isUfoBooming){
+    const UfoClass& uc = _ufoClasses[_ufo._classId];
+    Assets::Key_t bitmapKey = _ufo._isAlive ? uc._shipKey : uc._boomKey;
+    draw(*_bitmaps[bitmapKey], _ufo._position.toVector2i(), uc._colorIndex);
+  }
+
+  if(_cannon._isBooming || _cannon._isAlive){
+    Assets::Key_t bitmapKey = _cannon._isBooming ? _cannon._boomKeys[_cannon._boomFrame] : _cannon._cannonKey;
+    draw(*_bitmaps[bitmapKey], _cannon._position.toVector2i(), _cannon._colorIndex);
+  }
+
+  _entities.each<Bomb>([this, &draw](EntityStore::Entity_t, const Bomb& bomb){
+    const BombClass& bc = _bombClasses[bomb._classId];
+    draw(*_bitmaps[bc._bitmapKeys[bomb._frame]], bomb._position.toVector2i(), bc._colorIndex);
+  });
+
+  _entities.each<BombBoom>([this, &draw](EntityStore::Entity_t, const BombBoom& boom){
+    draw(*_bitmaps[_bombBoomKeys[boom._hit]], boom._position, boom._colorIndex);
+  });
+
+  if(_laser._isAlive)
+    draw(*_bitmaps[_laser._bitmapKey], _laser._position.toVector2i(), _laser._colorIndex);
+
+  for(const auto& bunker : _bunkers)
+    draw(bunker->_bitmap, bunker->_position, _bunkerColorIndex);
+
+  draw(_hitbar->_bitmap, Vector2i{0, _hitbar->_positionY}, _hitbar->_colorIndex);
+}
+
+void GameState::drawObservation(Bitmap& frame)
+{
+  assert(frame.getWidth() == _worldSize._x && frame.getHeight() == _worldSize._y);
+
+  frame.clear();
+  drawObservationSprites([&frame](const Bitmap& bitmap, Vector2i position, int32_t){
+    frame.stamp(bitmap, position, Bitmap::STAMP_OR);
+  });
+}
+
+void GameState::drawObservationPlanes(std::span<Bitmap> planes)
+{
+  assert(static_cast<int32_t>(planes.size()) == paletteSize);
+
+  for(auto& plane : planes)
+    plane.clear();
+  drawObservationSprites([planes](const Bitmap& bitmap, Vector2i position, int32_t colorIndex){
+    planes[colorIndex].stamp(bitmap, position, Bitmap::STAMP_OR);
+  });
+}
+
+void GameState::getPaletteGrays(std::span<uint8_t> grays) const
+{
+  assert(static_cast<int32_t>(grays.size()) == paletteSize);
+
+  for(int32_t i = 0; i < paletteSize; ++i)
+    grays[i] = _colorPalette[i].getGray();
+}
+
+void GameState::writeFeatures(std::span<float> features)
+{
+  assert(static_cast<int32_t>(features.size()) == getFeatureCount());
+
+  float toUnitX = 1.f / _worldSize._x;
+  float toUnitY = 1.f / _worldSize._y;
+
+  features[0] = _cannon._position._x.toFloat() * toUnitX;
+  features[1] = _cannon._isAlive;
+  features[2] = _laser._position._x.toFloat() * toUnitX;
+  features[3] = _laser._position._y.toFloat() * toUnitY;
+  features[4] = _laser._isAlive;
+  features[5] = _ufo._position._x.toFloat() * toUnitX;
+  features[6] = _ufo._isAlive;
+  features[7] = static_cast<float>(static_cast<SpaceInvaders*>(_app)->getLives()) / SpaceInvaders::maxPlayerLives;
+
+  float* alienFeatures = features.data() + featureHeaderCount;
+  for(int32_t row = 0; row < _gridHeight; ++row){
+    for(int32_t col = 0; col < _gridWidth; ++col){
+      int32_t alien = toAlienIndex(row, col);
+      alienFeatures[0] = (_alienAliveMasks[row] & toColumnBit(col)) != 0;
+      alienFeatures[1] = _alienXs[alien] * toUnitX;
+      alienFeatures[2] = _alienYs[alien] * toUnitY;
+      alienFeatures += 3;
+    }
+  }
+
+  std::span<float> bombFeatures = features.subspan(featureHeaderCount + (3 * _gridSize));
+  std::fill(bombFeatures.begin(), bombFeatures.end(), 0.f);
+  int32_t slot {0};
+  _entities.each<Bomb>([&](EntityStore::Entity_t, const Bomb& bomb){
+    if(slot == _maxBombs)
+      return;
+    bombFeatures[(3 * slot) + 0] = 1.f;
+    bombFeatures[(3 * slot) + 1] = bomb._position._x.toFloat() * toUnitX;
+    bombFeatures[(3 * slot) + 2] = bomb._position._y.toFloat() * toUnitY;
+    ++slot;
+  });
+}
+
 //===============================================================================================//
 // ##>SOS STATE                                                                                  //
 //===============================================================================================//
@@ -2410,6 +2932,7 @@ void MenuState::onUpdate(double now, float dt)
   if(pxr::input->isKeyPressed(Input::KEY_ENTER)){
     depopulateHud();
     si->hideHud();
+    pxr::mixer->fadeOutMusic(musicFadeOutTime_ms);
     _app->switchState(GameState::name);
   }
   if(pxr::input->isKeyPressed(Input::KEY_s)){
@@ -2432,6 +2955,10 @@ void MenuState::onEnter()
   si->hideLivesHud();
   si->showTopHud();
   si->resetGameStats();
+
+  // The theme keeps playing whilst viewing the score board so only restart it if it stopped.
+  if(!pxr::mixer->isMusicPlaying())
+    pxr::mixer->playMusic(SpaceInvaders::MK_THEME, Mixer::loopForever, musicFadeInTime_ms);
 }
 
 void MenuState::populateHud()
@@ -2849,3 +3376,901 @@ bool HiScoreBoardState::newScoreIsTop()
 {
   return _scoreBoard[_scoreBoard.size() - 1] == &_newScore;
 }
+
+//===============================================================================================//
+// ##>ENVIRONMENT                                                                                //
+//===============================================================================================//
+
+Env::Env(const Options& options) :
+  _app{std::make_unique<SpaceInvaders>()},
+  _game{nullptr},
+  _options{options},
+  _frame{SpaceInvaders::baseWorldSize._x, SpaceInvaders::baseWorldSize._y},
+  _planes{},
+  _grays{},
+  _observation{},
+  _stack{1, 0},
+  _startSnapshot{},
+  _random{},
+  _tick{0},
+  _score{0},
+  _isDone{false}
+{
+  assert(_options._ticksPerStep >= 1);
+  assert(_options._stackCount >= 1);
+  assert(_options._poolFactor == 1 || _options._poolFactor == 2 || _options._poolFactor == 4 || 
+         _options._poolFactor == 8);
+
+  std::swap(_random, pxr::randGenerator);
+
+  // One pixel larger than the world so the world scale is 1.
+  _app->initialize(nullptr, SpaceInvaders::baseWorldSize._x + 1, SpaceInvaders::baseWorldSize._y + 1);
+  _app->switchState(GameState::name);
+  _game = &_app->getGameState();
+
+  ByteWriter writer {};
+  _game->saveSnapshot(writer);
+  _startSnapshot = writer.getBytes();
+
+  std::swap(_random, pxr::randGenerator);
+
+  if(_options._observationType == OBSERVATION_GRAY){
+    for(int32_t i = 0; i < _game->getPaletteSize(); ++i)
+      _planes.emplace_back(_frame.getWidth(), _frame.getHeight());
+    _grays.resize(_game->getPaletteSize());
+    _game->getPaletteGrays(_grays);
+  }
+
+  _observation.resize(getSingleObservationSize());
+  _stack = FrameStack{_options._stackCount, getSingleObservationSize()};
+
+  observe(true);
+}
+
+Env::Env(ObservationType observationType, int32_t ticksPerStep) :
+  Env{Options{._observationType = observationType, ._ticksPerStep = ticksPerStep}}
+{}
+
+Vector2i Env::getFrameSize() const
+{
+  int32_t factor = _options._poolFactor;
+  return {Bitmap::getPooledSize(_frame.getWidth(), factor), Bitmap::getPooledSize(_frame.getHeight(), factor)};
+}
+
+int32_t Env::getSingleObservationSize() const
+{
+  Vector2i frameSize = getFrameSize();
+  switch(_options._observationType){
+    case OBSERVATION_FRAME: 
+      return ((frameSize._x + 7) / 8) * frameSize._y;
+    case OBSERVATION_FEATURES: 
+      return _game->getFeatureCount() * static_cast<int32_t>(sizeof(float));
+    case OBSERVATION_GRAY: 
+      return frameSize._x * frameSize._y;
+  }
+  assert(0);
+  return 0;
+}
+
+std::span<const uint8_t> Env::reset(xorwow::result_type seed)
+{
+  std::swap(_random, pxr::randGenerator);
+
+  ByteReader reader {_startSnapshot.data(), _startSnapshot.size()};
+  bool isLoaded = _game->loadSnapshot(reader);
+  assert(isLoaded);
+  pxr::randGenerator.seed(seed);
+
+  std::swap(_random, pxr::randGenerator);
+
+  _tick = 0;
+  _score = _app->getScore();
+  _isDone = false;
+  observe(true);
+  return getObservation();
+}
+
+Env::Step Env::step(int32_t action)
+{
+  assert(0 <= action && action < ACTION_COUNT);
+
+  if(_isDone)
+    return {getObservation(), 0, true};
+
+  bool isLeft = action == ACTION_LEFT || action == ACTION_LEFT_FIRE;
+  bool isRight = action == ACTION_RIGHT || action == ACTION_RIGHT_FIRE;
+  bool isFire = action == ACTION_FIRE || action == ACTION_LEFT_FIRE || action == ACTION_RIGHT_FIRE;
+
+  std::swap(_random, pxr::randGenerator);
+
+  for(int32_t i = 0; i < _options._ticksPerStep && !_isDone; ++i){
+    pxr::input->setKeyState(Input::KEY_LEFT, isLeft);
+    pxr::input->setKeyState(Input::KEY_RIGHT, isRight);
+    pxr::input->setKeyState(Input::KEY_SPACE, isFire);
+
+    _app->onUpdate(_tick * tickDt, tickDt);
+    pxr::input->onUpdate();
+    ++_tick;
+
+    if(_app->getActiveStateName() == SosState::name)
+      _app->switchState(GameState::name);
+
+    _isDone = _game->isGameOver();
+  }
+
+  std::swap(_random, pxr::randGenerator);
+
+  int32_t score = _app->getScore();
+  int32_t reward = score - _score;
+  _score = score;
+  observe(false);
+  return {getObservation(), reward, _isDone};
+}
+
+std::unique_ptr<Env> Env::clone() const
+{
+  auto env = std::make_unique<Env>(_options);
+
+  ByteWriter writer {};
+  xorwow contextRandom = std::exchange(pxr::randGenerator, _random);
+  _game->saveSnapshot(writer);
+  pxr::randGenerator = env->_random;
+  ByteReader reader {writer.getBytes().data(), writer.getBytes().size()};
+  bool isLoaded = env->_game->loadSnapshot(reader);
+  assert(isLoaded);
+  env->_random = std::exchange(pxr::randGenerator, contextRandom);
+
+  env->_tick = _tick;
+  env->_score = _score;
+  env->_isDone = _isDone;
+  env->_observation = _observation;
+  env->_stack = _stack;
+  return env;
+}
+
+void Env::observe(bool isReset)
+{
+  switch(_options._observationType){
+    case OBSERVATION_FRAME: 
+      _game->drawObservation(_frame);
+      _frame.poolBits(_options._poolFactor, _observation);
+      break;
+    case OBSERVATION_FEATURES: {
+      float* features = reinterpret_cast<float*>(_observation.data());
+      _game->writeFeatures({features, _observation.size() / sizeof(float)});
+      break;
+    }
+    case OBSERVATION_GRAY: 
+      _game->drawObservationPlanes(_planes);
+      Bitmap::poolGray(_planes, _grays, _options._poolFactor, _observation);
+      break;
+  }
+
+  if(isReset)
+    _stack.fill(_observation);
+  else
+    _stack.push(_observation);
+}
+
+BatchEnv::BatchEnv(std::shared_ptr<Log> sharedLog, std::shared_ptr<Assets> sealedAssets, int32_t envCount,
+                   const Env::Options& options, int32_t threadCount) :
+  _options{options},
+  _envCount{envCount},
+  _observationSize{0},
+  _workers(std::clamp(threadCount, 1, std::max(envCount, 1))),
+  _seedStreams(envCount),
+  _actions(envCount, Env::ACTION_NOOP),
+  _observations{},
+  _rewards(envCount, 0),
+  _dones(envCount, 0),
+  _command{COMMAND_CREATE},
+  _commandGeneration{0},
+  _pendingWorkers{0}
+{
+  assert(envCount >= 1);
+
+  int32_t workerCount = static_cast<int32_t>(_workers.size());
+  for(int32_t i = 0; i < workerCount; ++i){
+    _workers[i]._firstEnv = (i * envCount) / workerCount;
+    _workers[i]._envCount = (((i + 1) * envCount) / workerCount) - _workers[i]._firstEnv;
+  }
+
+  // The workers create their envs on starting, which is waited on as a command.
+  _pendingWorkers = workerCount;
+  for(int32_t i = 0; i < workerCount; ++i)
+    _workers[i]._thread = std::thread{&BatchEnv::workerLoop, this, i, sharedLog, sealedAssets};
+  {
+    std::unique_lock<std::mutex> lock {_commandMutex};
+    _finishCondition.wait(lock, [this]{return _pendingWorkers == 0;});
+  }
+
+  _observationSize = _workers[0]._envs[0]->getObservationSize();
+  _observations.resize(static_cast<size_t>(_observationSize) * envCount);
+
+  reset(0);
+}
+
+BatchEnv::BatchEnv(std::shared_ptr<Log> sharedLog, std::shared_ptr<Assets> sealedAssets, int32_t envCount,
+                   Env::ObservationType observationType, int32_t ticksPerStep, int32_t threadCount) :
+  BatchEnv{
+    std::move(sharedLog), 
+    std::move(sealedAssets), 
+    envCount, 
+    Env::Options{._observationType = observationType, ._ticksPerStep = ticksPerStep}, 
+    threadCount
+  }
+{}
+
+BatchEnv::~BatchEnv()
+{
+  runCommand(COMMAND_STOP);
+  for(auto& worker : _workers)
+    worker._thread.join();
+}
+
+void BatchEnv::reset(xorwow::result_type seed)
+{
+  xorwow root {seed};
+  for(auto& stream : _seedStreams)
+    stream = root.split();
+  runCommand(COMMAND_RESET);
+}
+
+void BatchEnv::step(std::span<const int32_t> actions)
+{
+  assert(static_cast<int32_t>(actions.size()) == _envCount);
+  std::copy(actions.begin(), actions.end(), _actions.begin());
+  runCommand(COMMAND_STEP);
+}
+
+void BatchEnv::runCommand(Command command)
+{
+  std::unique_lock<std::mutex> lock {_commandMutex};
+  _command = command;
+  _pendingWorkers = static_cast<int32_t>(_workers.size());
+  ++_commandGeneration;
+  _commandCondition.notify_all();
+  if(command != COMMAND_STOP)
+    _finishCondition.wait(lock, [this]{return _pendingWorkers == 0;});
+}
+
+void BatchEnv::finishCommand()
+{
+  std::lock_guard<std::mutex> lock {_commandMutex};
+  if(--_pendingWorkers == 0)
+    _finishCondition.notify_one();
+}
+
+void BatchEnv::workerLoop(int32_t worker, std::shared_ptr<Log> log, std::shared_ptr<Assets> assets)
+{
+  Context context {std::move(log), std::move(assets), 0};
+
+  Worker& self = _workers[worker];
+  for(int32_t i = 0; i < self._envCount; ++i)
+    self._envs.push_back(std::make_unique<Env>(_options));
+  finishCommand();
+
+  uint64_t seenGeneration {0};
+  while(true){
+    Command command {};
+    {
+      std::unique_lock<std::mutex> lock {_commandMutex};
+      _commandCondition.wait(lock, [&]{return _commandGeneration != seenGeneration;});
+      seenGeneration = _commandGeneration;
+      command = _command;
+    }
+
+    if(command == COMMAND_STOP)
+      break;
+
+    for(int32_t i = 0; i < self._envCount; ++i){
+      Env& env = *self._envs[i];
+      int32_t index = self._firstEnv + i;
+      if(command == COMMAND_RESET){
+        resetEnv(env, index);
+        _rewards[index] = 0;
+        _dones[index] = false;
+      }
+      else{
+        Env::Step step = env.step(_actions[index]);
+        _rewards[index] = step._reward;
+        _dones[index] = step._isDone;
+        if(step._isDone)
+          resetEnv(env, index);
+      }
+      writeObservation(env, index);
+    }
+
+    finishCommand();
+  }
+
+  // The envs must be destroyed before the context they run in.
+  self._envs.clear();
+}
+
+void BatchEnv::resetEnv(Env& env, int32_t index)
+{
+  env.reset(_seedStreams[index]());
+}
+
+void BatchEnv::writeObservation(const Env& env, int32_t index)
+{
+  std::span<const uint8_t> observation = env.getObservation();
+  std::copy(observation.begin(), observation.end(), _observations.begin() + (static_cast<size_t>(index) * _observationSize));
+}
+
+//
+// The C interface gives each thread a headless context when it first creates an env, unless it
+// already has one (e.g. it runs the engine). The contexts, and those of batch workers, share a
+// log and the assets, which are loaded once by a prototype instance and then sealed, as for the
+// simulation runner. The prototype runs on a thread of its own as the calling thread may 
+// already have a context.
+//
+
+static std::shared_ptr<Log> envLog;
+static std::shared_ptr<Assets> envAssets;
+static std::once_flag envAssetsFlag;
+static thread_local std::unique_ptr<Context> envContext;
+
+static void requireEnvAssets()
+{
+  std::call_once(envAssetsFlag, []{
+    envLog = std::make_shared<Log>();
+    envAssets = std::make_shared<Assets>();
+    std::thread loader {[]{
+      Context context {envLog, envAssets, 0};
+      SpaceInvaders prototype {};
+      prototype.initialize(nullptr, SpaceInvaders::baseWorldSize._x + 1, SpaceInvaders::baseWorldSize._y + 1);
+    }};
+    loader.join();
+    envAssets->seal();
+  });
+}
+
+static void requireEnvContext()
+{
+  if(pxr::input != nullptr)
+    return;
+
+  requireEnvAssets();
+  envContext = std::make_unique<Context>(envLog, envAssets, 0);
+}
+
+static Env* toEnv(si_env* env) {return reinterpret_cast<Env*>(env);}
+static const Env* toEnv(const si_env* env) {return reinterpret_cast<const Env*>(env);}
+static si_env* toHandle(Env* env) {return reinterpret_cast<si_env*>(env);}
+static BatchEnv* toBatch(si_batch* batch) {return reinterpret_cast<BatchEnv*>(batch);}
+static const BatchEnv* toBatch(const si_batch* batch) {return reinterpret_cast<const BatchEnv*>(batch);}
+
+static void copyObservation(const Env* env, void* observation)
+{
+  if(observation != nullptr)
+    std::memcpy(observation, env->getObservation().data(), env->getObservation().size());
+}
+
+static_assert(static_cast<int>(SI_ACTION_COUNT) == static_cast<int>(Env::ACTION_COUNT));
+static_assert(static_cast<int>(SI_OBSERVATION_FRAME) == static_cast<int>(Env::OBSERVATION_FRAME));
+static_assert(static_cast<int>(SI_OBSERVATION_FEATURES) == static_cast<int>(Env::OBSERVATION_FEATURES));
+static_assert(static_cast<int>(SI_OBSERVATION_GRAY) == static_cast<int>(Env::OBSERVATION_GRAY));
+
+static bool toOptions(const si_env_options& options, Env::Options& out)
+{
+  if(options.observation_type < SI_OBSERVATION_FRAME || options.observation_type > SI_OBSERVATION_GRAY)
+    return false;
+  if(options.ticks_per_step < 1 || options.stack_count < 1)
+    return false;
+  int32_t factor = options.pool_factor;
+  if(factor != 1 && factor != 2 && factor != 4 && factor != 8)
+    return false;
+
+  out._observationType = static_cast<Env::ObservationType>(options.observation_type);
+  out._ticksPerStep = options.ticks_per_step;
+  out._poolFactor = factor;
+  out._stackCount = options.stack_count;
+  return true;
+}
+
+extern "C" int32_t si_env_abi_version(void)
+{
+  return SI_ENV_ABI_VERSION;
+}
+
+extern "C" si_env* si_env_create(int32_t observation_type, int32_t ticks_per_step)
+{
+  si_env_options options {observation_type, ticks_per_step, 1, 1};
+  return si_env_create_with(&options);
+}
+
+extern "C" si_env* si_env_create_with(const si_env_options* options)
+{
+  Env::Options envOptions {};
+  if(options == nullptr || !toOptions(*options, envOptions))
+    return nullptr;
+
+  requireEnvContext();
+  return toHandle(new Env{envOptions});
+}
+
+extern "C" si_env* si_env_clone(const si_env* env)
+{
+  return toHandle(toEnv(env)->clone().release());
+}
+
+extern "C" void si_env_destroy(si_env* env)
+{
+  delete toEnv(env);
+}
+
+extern "C" int32_t si_env_observation_size(const si_env* env)
+{
+  return toEnv(env)->getObservationSize();
+}
+
+extern "C" int32_t si_env_frame_width(const si_env* env)
+{
+  return toEnv(env)->getFrameSize()._x;
+}
+
+extern "C" int32_t si_env_frame_height(const si_env* env)
+{
+  return toEnv(env)->getFrameSize()._y;
+}
+
+extern "C" void si_env_reset(si_env* env, uint32_t seed, void* observation)
+{
+  toEnv(env)->reset(seed);
+  copyObservation(toEnv(env), observation);
+}
+
+extern "C" int32_t si_env_step(si_env* env, int32_t action, void* observation, int32_t* reward)
+{
+  if(action < 0 || action >= SI_ACTION_COUNT)
+    return -1;
+
+  Env::Step step = toEnv(env)->step(action);
+  copyObservation(toEnv(env), observation);
+  if(reward != nullptr)
+    *reward = step._reward;
+  return step._isDone ? 1 : 0;
+}
+
+extern "C" si_batch* si_batch_create(int32_t env_count, int32_t observation_type, int32_t ticks_per_step, 
+                                     int32_t thread_count)
+{
+  si_env_options options {observation_type, ticks_per_step, 1, 1};
+  return si_batch_create_with(env_count, &options, thread_count);
+}
+
+extern "C" si_batch* si_batch_create_with(int32_t env_count, const si_env_options* options, int32_t thread_count)
+{
+  Env::Options envOptions {};
+  if(options == nullptr || !toOptions(*options, envOptions))
+    return nullptr;
+  if(env_count < 1 || thread_count < 1)
+    return nullptr;
+
+  requireEnvAssets();
+  BatchEnv* batch = new BatchEnv{envLog, envAssets, env_count, envOptions, thread_count};
+  return reinterpret_cast<si_batch*>(batch);
+}
+
+extern "C" void si_batch_destroy(si_batch* batch)
+{
+  delete toBatch(batch);
+}
+
+extern "C" int32_t si_batch_env_count(const si_batch* batch)
+{
+  return toBatch(batch)->getEnvCount();
+}
+
+extern "C" int32_t si_batch_observation_size(const si_batch* batch)
+{
+  return toBatch(batch)->getObservationSize();
+}
+
+extern "C" void si_batch_reset(si_batch* batch, uint32_t seed)
+{
+  toBatch(batch)->reset(seed);
+}
+
+extern "C" int32_t si_batch_step(si_batch* batch, const int32_t* actions)
+{
+  int32_t envCount = toBatch(batch)->getEnvCount();
+  for(int32_t i = 0; i < envCount; ++i)
+    if(actions[i] < 0 || actions[i] >= SI_ACTION_COUNT)
+      return -1;
+
+  toBatch(batch)->step({actions, static_cast<size_t>(envCount)});
+  return 0;
+}
+
+extern "C" const void* si_batch_observations(const si_batch* batch)
+{
+  return toBatch(batch)->getObservations().data();
+}
+
+extern "C" const int32_t* si_batch_rewards(const si_batch* batch)
+{
+  return toBatch(batch)->getRewards().data();
+}
+
+extern "C" const uint8_t* si_batch_dones(const si_batch* batch)
+{
+  return toBatch(batch)->getDones().data();
+}
+
+//===============================================================================================//
+// ##>RECORDING                                                                                  //
+//===============================================================================================//
+
+uint8_t SessionRecording::readKeys()
+{
+  uint8_t keys {0};
+  if(pxr::input->isKeyDown(Input::KEY_LEFT)) keys |= KEYBIT_LEFT;
+  if(pxr::input->isKeyDown(Input::KEY_RIGHT)) keys |= KEYBIT_RIGHT;
+  if(pxr::input->isKeyDown(Input::KEY_SPACE)) keys |= KEYBIT_FIRE;
+  return keys;
+}
+
+void SessionRecording::applyKeys(uint8_t keys)
+{
+  pxr::input->setKeyState(Input::KEY_LEFT, keys & KEYBIT_LEFT);
+  pxr::input->setKeyState(Input::KEY_RIGHT, keys & KEYBIT_RIGHT);
+  pxr::input->setKeyState(Input::KEY_SPACE, keys & KEYBIT_FIRE);
+}
+
+void SessionRecording::hashSession(SpaceInvaders& app, SectionHashes& hashes)
+{
+  if(app.getActiveStateName() == GameState::name){
+    app.getGameState().hashSnapshotSections(hashes);
+    return;
+  }
+
+  ByteWriter writer {};
+  std::string state = app.getActiveStateName();
+  writer.writeBytes(state.data(), state.size());
+  writer.writeEach(app.getScore(), app.getLives(), app.getRound(), pxr::randGenerator.getState());
+  hashes.fill(0);
+  hashes[GameState::SNAPSHOT_PLAYER] = hashState(writer.getBytes().data(), writer.getBytes().size());
+}
+
+static void writeToFile(std::ofstream& file, const ByteWriter& writer)
+{
+  const std::vector<uint8_t>& bytes = writer.getBytes();
+  file.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+}
+
+static bool readFromFile(std::ifstream& file, uint64_t offset, size_t size, std::vector<uint8_t>& bytes)
+{
+  bytes.resize(size);
+  file.seekg(offset);
+  file.read(reinterpret_cast<char*>(bytes.data()), size);
+  return static_cast<bool>(file);
+}
+
+SessionRecorder::SessionRecorder(const std::string& path, int32_t keyframeSeconds, bool isHashing) :
+  _path{path},
+  _file{path, std::ios_base::out | std::ios_base::trunc | std::ios_base::binary},
+  _hashFile{},
+  _isHashing{isHashing},
+  _keyframeTicks{std::max(1, keyframeSeconds * ticksPerSecond)},
+  _tickCount{0},
+  _nextKeyframeTick{0},
+  _previousKeys{0},
+  _index{},
+  _isFinished{false}
+{
+  if(!_file){
+    pxr::log->log(Log::WARN, logstr::warn_cannot_open_recording, _path);
+    return;
+  }
+
+  ByteWriter writer {};
+  writer.write(fileMagic);
+  writer.write(fileVersion);
+  writer.write(ticksPerSecond);
+  writer.write(_keyframeTicks);
+  writeToFile(_file, writer);
+
+  if(!_isHashing)
+    return;
+
+  _hashFile.open(getHashesPath(_path), std::ios_base::out | std::ios_base::trunc | std::ios_base::binary);
+  if(!_hashFile){
+    pxr::log->log(Log::WARN, logstr::warn_cannot_open_recording, getHashesPath(_path));
+    return;
+  }
+
+  ByteWriter hashesHeader {};
+  hashesHeader.writeEach(hashesMagic, hashesVersion, hashSectionCount);
+  writeToFile(_hashFile, hashesHeader);
+}
+
+SessionRecorder::~SessionRecorder()
+{
+  if(!_isFinished)
+    finish();
+}
+
+void SessionRecorder::recordTick(SpaceInvaders& app)
+{
+  if(_isFinished || !_file)
+    return;
+
+  bool isInPlay = app.getActiveStateName() == GameState::name && !app.getGameState().isGameOver();
+  if(_tickCount >= _nextKeyframeTick && isInPlay)
+    writeKeyframe(app);
+
+  assert(!_index.empty());
+
+  uint8_t keys = readKeys();
+  _file.put(static_cast<char>(keys));
+  _previousKeys = keys;
+  ++_tickCount;
+}
+
+void SessionRecorder::recordHashes(SpaceInvaders& app)
+{
+  if(_isFinished || !_isHashing || !_hashFile)
+    return;
+
+  SectionHashes hashes {};
+  hashSession(app, hashes);
+  _hashFile.write(reinterpret_cast<const char*>(hashes.data()), sizeof(hashes));
+}
+
+void SessionRecorder::writeKeyframe(SpaceInvaders& app)
+{
+  ByteWriter snapshot {};
+  app.getGameState().saveSnapshot(snapshot);
+  ByteWriter compressed {};
+  compressRuns(snapshot.getBytes(), compressed);
+
+  ByteWriter writer {};
+  writer.write(_tickCount);
+  writer.write(_previousKeys);
+  writer.write(static_cast<uint32_t>(snapshot.getBytes().size()));
+  writer.write(static_cast<uint32_t>(compressed.getBytes().size()));
+  writer.writeBytes(compressed.getBytes().data(), compressed.getBytes().size());
+
+  _index.push_back({_tickCount, static_cast<uint64_t>(_file.tellp())});
+  writeToFile(_file, writer);
+  _nextKeyframeTick = _tickCount + _keyframeTicks;
+}
+
+bool SessionRecorder::finish()
+{
+  if(_isFinished)
+    return isGood();
+  _isFinished = true;
+
+  if(!_file)
+    return false;
+
+  ByteWriter writer {};
+  uint64_t indexOffset = static_cast<uint64_t>(_file.tellp());
+  for(const auto& entry : _index){
+    writer.write(entry._tick);
+    writer.write(entry._offset);
+  }
+  writer.write(indexOffset);
+  writer.write(static_cast<int32_t>(_index.size()));
+  writer.write(_tickCount);
+  writer.write(fileMagic);
+  writeToFile(_file, writer);
+  _file.close();
+  if(_isHashing)
+    _hashFile.close();
+
+  if(!isGood())
+    pxr::log->log(Log::WARN, logstr::warn_cannot_open_recording, _path);
+  return isGood();
+}
+
+SessionReplay::SessionReplay(const std::string& path) :
+  _path{path},
+  _file{path, std::ios_base::in | std::ios_base::binary},
+  _header{},
+  _footer{},
+  _index{},
+  _app{std::make_unique<SpaceInvaders>()},
+  _blockBytes{},
+  _snapshot{},
+  _blockKeys{},
+  _blockTick{0},
+  _blockPreviousKeys{0},
+  _block{-1},
+  _keyframeTick{0},
+  _tick{0},
+  _isGood{false}
+{
+  // One pixel larger than the world so the world scale is 1, as recorded.
+  _app->initialize(nullptr, SpaceInvaders::baseWorldSize._x + 1, SpaceInvaders::baseWorldSize._y + 1);
+  _app->switchState(GameState::name);
+
+  if(!_file){
+    pxr::log->log(Log::WARN, logstr::warn_cannot_open_recording, _path);
+    return;
+  }
+
+  std::vector<uint8_t> bytes {};
+  _file.seekg(0, std::ios_base::end);
+  uint64_t fileSize = static_cast<uint64_t>(_file.tellg());
+  if(fileSize < headerSize + footerSize || !readFromFile(_file, 0, headerSize, bytes)){
+    fail();
+    return;
+  }
+
+  ByteReader header {bytes.data(), bytes.size()};
+  header.read(_header._magic);
+  header.read(_header._version);
+  header.read(_header._ticksPerSecond);
+  header.read(_header._keyframeTicks);
+  if(_header._magic != fileMagic || _header._version != fileVersion || _header._ticksPerSecond != ticksPerSecond){
+    fail();
+    return;
+  }
+
+  if(!readFromFile(_file, fileSize - footerSize, footerSize, bytes)){
+    fail();
+    return;
+  }
+
+  ByteReader footer {bytes.data(), bytes.size()};
+  footer.read(_footer._indexOffset);
+  footer.read(_footer._keyframeCount);
+  footer.read(_footer._tickCount);
+  footer.read(_footer._magic);
+  bool isValid = _footer._magic == fileMagic && _footer._keyframeCount >= 1 && _footer._tickCount >= 0 &&
+                 _footer._indexOffset >= headerSize &&
+                 _footer._indexOffset + (_footer._keyframeCount * indexEntrySize) + footerSize == fileSize;
+  if(!isValid || !readFromFile(_file, _footer._indexOffset, _footer._keyframeCount * indexEntrySize, bytes)){
+    fail();
+    return;
+  }
+
+  // The keyframes must start the recording and be in tick and file order.
+  ByteReader index {bytes.data(), bytes.size()};
+  _index.resize(_footer._keyframeCount);
+  for(int32_t i = 0; i < _footer._keyframeCount; ++i){
+    IndexEntry& entry = _index[i];
+    index.read(entry._tick);
+    index.read(entry._offset);
+    bool isOrdered = (i == 0) ? (entry._tick == 0 && entry._offset == headerSize) : 
+                     (entry._tick > _index[i - 1]._tick && entry._offset > _index[i - 1]._offset);
+    if(!isOrdered || entry._tick > _footer._tickCount || entry._offset >= _footer._indexOffset){
+      fail();
+      return;
+    }
+  }
+
+  _isGood = true;
+  seek(0);
+}
+
+bool SessionReplay::seek(int64_t tick)
+{
+  if(!_isGood || tick < 0 || tick > _footer._tickCount)
+    return false;
+
+  // Steps on from where the replay is if the tick is ahead of it in the same block, which is
+  // never more work than restoring the block's keyframe.
+  auto next = std::upper_bound(_index.begin(), _index.end(), tick, [](int64_t t, const IndexEntry& entry){
+    return t < entry._tick;
+  });
+  int32_t block = static_cast<int32_t>(next - _index.begin()) - 1;
+  if(block != _block || tick < _tick)
+    if(!readBlock(block) || !restoreKeyframe())
+      return fail();
+
+  while(_tick < tick)
+    if(!step())
+      return false;
+  return true;
+}
+
+bool SessionReplay::step()
+{
+  if(!_isGood || _tick >= _footer._tickCount)
+    return false;
+
+  // The state at the start of the next block is that of its keyframe, so it need not be restored.
+  if(_tick - _blockTick == static_cast<int64_t>(_blockKeys.size()))
+    if(!readBlock(_block + 1))
+      return fail();
+
+  applyKeys(_blockKeys[_tick - _blockTick]);
+  _app->onUpdate(_tick * tickDt, tickDt);
+  pxr::input->onUpdate();
+  ++_tick;
+  return true;
+}
+
+bool SessionReplay::readBlock(int32_t block)
+{
+  if(block < 0 || block >= _footer._keyframeCount)
+    return false;
+
+  bool isLast = block == _footer._keyframeCount - 1;
+  uint64_t offset = _index[block]._offset;
+  uint64_t endOffset = isLast ? _footer._indexOffset : _index[block + 1]._offset;
+  int64_t endTick = isLast ? _footer._tickCount : _index[block + 1]._tick;
+  if(!readFromFile(_file, offset, endOffset - offset, _blockBytes))
+    return false;
+
+  ByteReader reader {_blockBytes.data(), _blockBytes.size()};
+  int64_t tick {0};
+  uint32_t snapshotSize {0}, compressedSize {0};
+  if(!reader.read(tick) || !reader.read(_blockPreviousKeys) || !reader.read(snapshotSize) || !reader.read(compressedSize))
+    return false;
+  if(tick != _index[block]._tick || compressedSize > reader.getRemaining() ||
+     reader.getRemaining() - compressedSize != static_cast<uint64_t>(endTick - tick))
+    return false;
+
+  // Bound the size before allocating, as no compressed size could decompress to more.
+  if(snapshotSize > maxSnapshotSize || snapshotSize > compressedSize * maxRunExpansion)
+    return false;
+
+  const uint8_t* compressed = _blockBytes.data() + keyframeHeaderSize;
+  _snapshot.resize(snapshotSize);
+  if(!decompressRuns({compressed, compressedSize}, _snapshot))
+    return false;
+
+  _blockKeys = {compressed + compressedSize, static_cast<size_t>(endTick - tick)};
+  _blockTick = tick;
+  _block = block;
+  return true;
+}
+
+bool SessionReplay::restoreKeyframe()
+{
+  if(_app->getActiveStateName() != GameState::name)
+    _app->switchState(GameState::name);
+
+  ByteReader reader {_snapshot.data(), _snapshot.size()};
+  if(!_app->getGameState().loadSnapshot(reader))
+    return false;
+
+  // Settle the keys of the tick before so those held on across the keyframe are not pressed.
+  applyKeys(_blockPreviousKeys);
+  pxr::input->onUpdate();
+
+  _keyframeTick = _blockTick;
+  _tick = _blockTick;
+  return true;
+}
+
+bool SessionReplay::fail()
+{
+  pxr::log->log(Log::WARN, logstr::warn_malformed_recording, _path);
+  _isGood = false;
+  return false;
+}
+
+SessionHashes::SessionHashes(const std::string& path) :
+  _hashes{},
+  _isGood{false}
+{
+  std::ifstream file {path, std::ios_base::in | std::ios_base::binary};
+  if(!file){
+    pxr::log->log(Log::WARN, logstr::warn_cannot_open_recording, path);
+    return;
+  }
+
+  std::vector<uint8_t> bytes {std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{}};
+  ByteReader reader {bytes.data(), bytes.size()};
+  uint32_t magic {0}, version {0};
+  int32_t sectionCount {0};
+  bool isValid = reader.readEach(magic, version, sectionCount) && magic == hashesMagic && 
+                 version == hashesVersion && sectionCount == hashSectionCount && 
+                 reader.getRemaining() % sizeof(SectionHashes) == 0;
+  if(!isValid){
+    pxr::log->log(Log::WARN, logstr::warn_malformed_recording, path);
+    return;
+  }
+
+  _hashes.resize(reader.getRemaining() / sizeof(SectionHashes));
+  reader.readBytes(_hashes.data(), _hashes.size() * sizeof(SectionHashes));
+  _isGood = true;
+}
@@ -5,6 +5,8 @@
 
 using namespace pxr;
 
+class GameState;
+
 //===============================================================================================//
 // ##>SPACE INVADERS                                                                             //
 //===============================================================================================//
@@ -54,6 +56,15 @@ public:
     "fastinvader2", "fastinvader3", "fastinvader4", "scorebeep", "topscore", "sos"
   };
 
+  enum MusicKey : Mixer::Key_t
+  {
+    MK_THEME, MK_COUNT
+  };
+
+  static constexpr std::array<Mixer::Name_t, MK_COUNT> _musicNames {
+    "spaceinvaders1"
+  };
+
   static constexpr int maxPlayerLives {4};
   static constexpr int maxLivesHudCannons {maxPlayerLives - 1};
 
@@ -148,6 +159,7 @@ public:
   void onDraw(double now, float dt);
 
   HUD& getHud() {return _hud;}
+  GameState& getGameState() {return *_gameState;}
   void hideHud(){_isHudVisible = false;}   // faster way to hide entire hud.
   void showHud(){_isHudVisible = true;}
   bool isHudVisible() const {return _isHudVisible;}
@@ -207,6 +219,7 @@ private:
   int32_t _worldScale;
 
   HUD _hud;
+  GameState* _gameState;
   HUD::uid_t _uidScoreText;
   HUD::uid_t _uidScoreValue;
   HUD::uid_t _uidHiScoreText;
@@ -417,8 +430,90 @@ public:
   void onEnter();
   std::string getName(){return name;}
 
+  //
+  // Snapshots capture the complete simulation state of a level in progress, including the 
+  // player's score, lives and round and the random number generator state, so play resumes
+  // from a loaded snapshot exactly as it continued from the save. A snapshot only loads into a
+  // game state initialized with the same world scale and config as the one which saved it.
+  // Snapshots are decoded and validated in full before any state is changed; loading fails,
+  // returning false and leaving the state untouched, if the config differs or the snapshot is
+  // malformed, including any value out of the range the game relies on.
+  //
+  void saveSnapshot(ByteWriter& writer) const;
+  bool loadSnapshot(ByteReader& reader);
+
+  //
+  // A snapshot after its header is its sections in order. Hashing the sections separately 
+  // tells which parts of the state differ when two runs diverge (see SessionRecorder).
+  //
+  enum SnapshotSection
+  {
+    SNAPSHOT_PLAYER, SNAPSHOT_TIMING, SNAPSHOT_ALIENS, SNAPSHOT_UFO, SNAPSHOT_BOMBS, 
+    SNAPSHOT_CANNON, SNAPSHOT_DEFENCES, SNAPSHOT_PHASE, SNAPSHOT_SECTION_COUNT
+  };
+
+  void hashSnapshotSections(std::span<uint64_t> hashes) const;
+  static const char* getSnapshotSectionName(SnapshotSection section);
+
+  bool isGameOver() const {return _isGameOver;}
+
+  //
+  // Observations of play for agents (see Env). The frame is the playfield drawn into a world
+  // sized bitmap, as onDraw draws it less the color. The planes are the playfield drawn into a
+  // world sized bitmap per palette color, the grays being the palette's. The features are, in
+  // order, the cannon x and is alive, the laser x, y and is alive, the ufo x and is alive, the
+  // lives left, then for each alien in grid order is alive, x and y, and for each of maxBombs 
+  // bomb slots is present, x and y. Positions are normalised to the world size and flags are 
+  // 0 or 1.
+  //
+  void drawObservation(Bitmap& frame);
+  void drawObservationPlanes(std::span<Bitmap> planes);
+  int32_t getPaletteSize() const {return paletteSize;}
+  void getPaletteGrays(std::span<uint8_t> grays) const;
+  int32_t getFeatureCount() const {return featureHeaderCount + (3 * _gridSize) + (3 * _maxBombs);}
+  void writeFeatures(std::span<float> features);
+
+private:
+  static constexpr int32_t baseGridWidth {11};   // The fleet size the base game data is tuned for.
+  static constexpr int32_t baseGridHeight {5};
+  static constexpr int32_t baseGridSize {baseGridWidth * baseGridHeight};
+  static constexpr int32_t baseAlienSeperation {14};
+  static constexpr int32_t baseAlienHeight {8};
+  // Rows are squeezed into the span of the base rows but no closer than the height of an alien.
+  static constexpr int32_t maxGridHeight {1 + (((baseGridHeight - 1) * baseAlienSeperation) / baseAlienHeight)};
+
 public:
 
+  //
+  // The fleet dimensions and entity caps. The defaults reproduce the arcade game; larger values
+  // are intended for stress testing. The alien spacing, bunker spacing, cycle tables and 
+  // formations are derived from these values on initialize. The grid height is limited to the
+  // most rows that fit without overlapping.
+  //
+  class Config final : public Dataset
+  {
+  public:
+    static constexpr const char* filename = "game.config";
+
+    enum Key
+    {
+      KEY_GRID_WIDTH,
+      KEY_GRID_HEIGHT,
+      KEY_MAX_BOMBS,
+      KEY_BUNKER_SPAWN_COUNT,
+      KEY_SYSTEM_WORKERS
+    };
+
+    Config() : Dataset({
+      //    key                    name               default  min    max
+      {KEY_GRID_WIDTH,         "gridWidth",         {11},    {1},   {64}  },
+      {KEY_GRID_HEIGHT,        "gridHeight",        {5},     {1},   {maxGridHeight}},
+      {KEY_MAX_BOMBS,          "maxBombs",          {20},    {1},   {1000}},
+      {KEY_BUNKER_SPAWN_COUNT, "bunkerSpawnCount",  {4},     {0},   {32}  },
+      {KEY_SYSTEM_WORKERS,     "systemWorkers",     {0},     {0},   {64}  }
+    }){}
+  };
+
   class BeatBox
   {
   public:
@@ -432,6 +527,8 @@ public:
     void unpause(){_isPaused = false;}
     void togglePause(){_isPaused = !_isPaused;}
     bool isPaused() const {return _isPaused;}
+    void pack(ByteWriter& writer) const;
+    bool unpack(ByteReader& reader);
   private:
     std::array<Mixer::Key_t, beatCount> _beats;
     int _nextBeat;
@@ -447,7 +544,7 @@ public:
     int32_t _col;
   };
 
-  enum AlienClassId { SQUID, CRAB, OCTOPUS, CUTTLE, CUTTLETWIN };
+  enum AlienClassId : int32_t { SQUID, CRAB, OCTOPUS, CUTTLE, CUTTLETWIN };
 
   static constexpr int32_t alienFramesCount {2};
   struct AlienClass
@@ -459,17 +556,7 @@ public:
     std::array<Assets::Key_t, alienFramesCount> _bitmapKeys;
   };
 
-  struct Alien
-  {
-    AlienClassId _classId;
-    Vector2i _position;
-    int32_t _row;
-    int32_t _col;
-    bool _frame;
-    bool _isAlive;
-  };
-
-  enum UfoClassId { SAUCER, SCHRODINGER };
+  enum UfoClassId : int32_t { SAUCER, SCHRODINGER };
 
   struct UfoClass
   {
@@ -488,20 +575,19 @@ public:
   struct Ufo
   {
     UfoClassId _classId;
-    Vector2f _position;
-    float _phaseClockSeconds;
+    Vector2x _position;
     bool _phase;                // true==on/visible, false==off/invisible
     bool _isAlive;
   };
 
-  enum BombClassId { CROSS, ZIGZAG, ZAGZIG }; // zigzag is the wiggle!
+  enum BombClassId : int32_t { CROSS, ZIGZAG, ZAGZIG }; // zigzag is the wiggle!
 
   static constexpr int32_t bombFramesCount {4};
   struct BombClass
   {
     int32_t _width;
     int32_t _height;
-    float _speed;                                             // Unit: pixels per second.
+    Fixed _speed;                                             // Unit: pixels per tick.
     int32_t _colorIndex;
     int32_t _frameInterval;                                   // Beats between draw frames.
     int32_t _laserSurvivalChance;                             // one in this chance to survive.
@@ -511,30 +597,28 @@ public:
   struct Bomb
   {
     BombClassId _classId;
-    Vector2f _position;
+    Vector2x _position;
     int32_t _frameClock;       // unit: Cycle beats.
     int32_t _frame;            // Constraint: value=[0, 4).
-    bool _isAlive;
   };
 
-  enum BombHit { BOMBHIT_BOTTOM, BOMBHIT_MIDAIR };
+  enum BombHit : int32_t { BOMBHIT_BOTTOM, BOMBHIT_MIDAIR };
 
   struct BombBoom
   {
     BombHit _hit;
     Vector2i _position;
     int32_t _colorIndex;
-    float _boomClock;     // Unit: seconds. 
-    bool _isAlive;
   };
 
   struct Laser
   {
-    Vector2f _position;
+    Vector2x _position;
+    Vector2x _lastPosition;   // Position in the previous tick; collisions sweep from here.
     int32_t _width;
     int32_t _height;
     int32_t _colorIndex;
-    float _speed;             // Unit: pixels per second.
+    Fixed _speed;             // Unit: pixels per tick.
     bool _isAlive;
     Assets::Key_t _bitmapKey;
   };
@@ -542,18 +626,16 @@ public:
   static constexpr int32_t cannonBoomFramesCount {3};
   struct Cannon
   {
-    Vector2f _spawnPosition;
-    Vector2f _position;
+    Vector2x _spawnPosition;
+    Vector2x _position;
     int32_t _colorIndex;
     int32_t _width;
     int32_t _height;
     int32_t _moveDirection;          // -1 == left, 0 == still, +1 == right.
-    float _speed;                    // Unit: pixels per second.
+    Fixed _speed;                    // Unit: pixels per tick.
     float _boomDuration;             // Unit: seconds - total length of boom animation.
-    float _boomClock;                // Unit: seconds.
     float _boomFrameDuration;        // Unit: seconds - how many beats per frame.
     int32_t _boomFrame;              // Current boom animation frame.
-    float _boomFrameClock;           // Unit: seconds.
     bool _isBooming;
     bool _isAlive;
     Assets::Key_t _cannonKey;
@@ -574,10 +656,40 @@ public:
 
   struct Bunker
   {
-    Bunker(const Bitmap& b, Vector2f p) : _bitmap{b}, _position{p}{}
+    Bunker(const Bitmap& b, Vector2i p) : _bitmap{b}, _position{p}{}
 
     Bitmap _bitmap;
-    Vector2f _position;
+    Vector2i _position;
+  };
+
+  enum LaserTarget { LASERTARGET_NONE, LASERTARGET_BOMB, LASERTARGET_ALIEN, LASERTARGET_BUNKER, LASERTARGET_UFO };
+
+  struct LaserHit
+  {
+    LaserTarget _target;
+    float _time;              // Fraction of the tick elapsed when the hit occurred, [0, 1].
+    int32_t _index;           // Bomb entity, alien index or bunker index of the target hit.
+    Vector2i _pixel;          // The pixel hit w.r.t the target's bitmap.
+  };
+
+  //
+  // The countdown clocks of the game (boom animations, messages, ufo spawns etc) are timers on
+  // a timer wheel which call onTimer when they fall due. The data of a timer is the entity of
+  // the boom for TIMER_BOMB_BOOM_END and unused for all other events. Every other event has at
+  // most one timer at a time, whose handle is kept so restarting it is constant time.
+  //
+  enum TimerEvent
+  {
+    TIMER_MSG_END,
+    TIMER_ALIEN_BOOM_END,
+    TIMER_ALIEN_MORPH_END,
+    TIMER_CANNON_BOOM_END,
+    TIMER_CANNON_BOOM_FRAME,
+    TIMER_UFO_SPAWN,
+    TIMER_UFO_PHASE,
+    TIMER_UFO_BOOM_SCORE,
+    TIMER_BOMB_BOOM_END,
+    TIMER_COUNT
   };
 
   struct Level
@@ -596,54 +708,56 @@ private:
   void addHudMsg(const char* endMsg, const Color3f& color);
   void removeHudMsg();
   void startRoundIntro();
-  void doRoundIntro(float dt);
+  void addRoundIntroMsg();
+  void rebuildHud();
   void doInvasionTest();
   void startGameOver();
-  void doGameOver(float dt);
+  void endGameOver();
   void doVictoryTest();
   void startVictory();
-  void doVictory(float dt);
+  void endVictory();
+  void onTimer(TimerWheel::EventId_t event, int32_t data);
+  void restartTimer(TimerEvent event, int32_t delayTicks);
+  void cancelTimer(TimerEvent event);
+  void scheduleUfoSpawn();
   void endSpawning();
   void spawnCannon(bool takeLife);
-  void spawnBomb(Vector2f position, BombClassId classId);
+  void spawnBomb(Vector2x position, BombClassId classId);
   void spawnBoom(Vector2i position, BombHit hit, int32_t colorIndex); 
-  void spawnBunker(Vector2f position, Assets::Key_t bitmapKey);
+  void spawnBunker(Vector2i position, Assets::Key_t bitmapKey);
+  std::unique_ptr<Bunker> makeBunker(Vector2i position, Assets::Key_t bitmapKey);
+  void deleteBunker(int32_t bunker);
   void spawnUfo(UfoClassId classId);
-  void morphAlien(Alien& alien);
+  void morphAlien(int32_t alien);
   void boomCannon();
-  void boomBomb(Bomb& bomb, bool makeBoom = false, Vector2i boomPosition = {}, BombHit hit = BOMBHIT_MIDAIR);
+  void boomBomb(EntityStore::Entity_t bomb, bool makeBoom = false, Vector2i boomPosition = {}, BombHit hit = BOMBHIT_MIDAIR);
   void boomAllBombs();
   void boomUfo();
-  void boomAlien(Alien& alien);
+  void boomAlien(int32_t alien);
   void boomLaser(bool makeBoom, BombHit hit = BOMBHIT_MIDAIR);
+  void sweepLaser(const Bitmap& bitmap, Vector2i position, int32_t targetDrop, 
+                  LaserTarget target, int32_t index, LaserHit& hit);
   void boomBunker(Bunker& bunker, Vector2i hitPixel);
-  void doUfoSpawning();
-  void doAlienMorphing(float dt);
-  void doCannonMoving(float dt);
-  void doCannonBooming(float dt);
+  void doCannonMoving();
   void doCannonFiring();
   void doAlienMoving(int32_t beats);
-  void doBombMoving(int32_t beats, float dt);
-  void doLaserMoving(float dt);
-  void doUfoMoving(float dt);
-  void doUfoPhasing(float dt);
+  void doBombMoving(int32_t beats);
+  void doLaserMoving();
+  void doUfoMoving();
   void doAlienBombing(int32_t beats);
-  void doAlienBooming(float dt);
-  void doUfoBoomScoring(float dt);
-  void doBombBoomBooming(float dt);
   void doUfoReinforcing(float dt);
   void doCollisionsUfoBorders();
   void doCollisionsBombsHitbar();
   void doCollisionsBombsCannon();
-  void doCollisionsBombsLaser();
-  void doCollisionsLaserAliens();
-  void doCollisionsLaserUfo();
+  void doCollisionsLaser();
   void doCollisionsLaserSky();
   bool doCollisionsAliensBorders();
   void doCollisionsBunkersBombs();
-  void doCollisionsBunkersLaser();
   void doCollisionsBunkersAliens();
+  void addSystems();
   bool incrementGridIndex(GridIndex& index);
+  int32_t getAlienPopulation() const;
+  uint64_t getPopulatedColumnsMask() const;
   void drawGrid();
   void drawUfo();
   void drawCannon();
@@ -653,14 +767,21 @@ private:
   void drawHitbar();
   void drawBunkers();
 
-  // Predicates.
-  static bool isBombAlive(const Bomb& bomb) {return bomb._isAlive;}
-  static bool isBombBoomAlive(const BombBoom& boom) {return boom._isAlive;}
+  static constexpr int32_t featureHeaderCount {8};
+  void packSnapshotSection(SnapshotSection section, ByteWriter& writer) const;
+  struct SnapshotLoad;
+  bool decodeSnapshot(ByteReader& reader, SnapshotLoad& load);
+  bool isSnapshotValid(SnapshotLoad& load);
+  void applySnapshot(SnapshotLoad& load);
+  template<typename Draw> void drawObservationSprites(Draw draw);
 
 private:
   const Font* _font;
   HUD* _hud;
 
+  // Bitmaps resolved at the world scale on initialize, indexed by SpaceInvaders::BitmapKey.
+  std::array<const Bitmap*, SpaceInvaders::BMK_COUNT> _bitmaps;
+
   static constexpr float beatFreqScale {0.8f};
   BeatBox _beatBox;
 
@@ -670,11 +791,124 @@ private:
   static constexpr int32_t paletteSize {7}; 
   std::array<Color3f, paletteSize> _colorPalette;
 
-  static constexpr int32_t gridWidth {11};
-  static constexpr int32_t gridHeight {5};
-  static constexpr int32_t gridSize {gridWidth * gridHeight};
-  using GridRow = std::array<Alien, gridWidth>;
-  std::array<GridRow, gridHeight> _grid; 
+  Config _config;
+
+  static constexpr uint32_t snapshotMagic {0x53495353};  // "SISS"
+  static constexpr uint32_t snapshotVersion {4};
+  std::vector<uint8_t> _quickSnapshot;                 // Debug quick save/load slot.
+
+  //
+  // The state decoded from a snapshot, in the order it is packed. Applying a load swaps the
+  // heap backed parts with those of the game state, so the next load reuses their storage.
+  //
+  struct SnapshotLoad
+  {
+    int32_t _score;
+    int32_t _lives;
+    int32_t _round;
+    xorwow::state_type _randState;
+    TimerWheel _timers;
+    std::array<TimerWheel::Handle, TIMER_COUNT> _timerHandles;
+    BeatBox _beatBox;
+    int32_t _levelIndex;
+    int32_t _activeCycle;
+    int32_t _activeBeat;
+    std::vector<int32_t> _alienXs;
+    std::vector<int32_t> _alienYs;
+    std::vector<AlienClassId> _alienClassIds;
+    std::vector<uint64_t> _alienAliveMasks;
+    std::vector<uint64_t> _alienFrameMasks;
+    int32_t _alienMoveDirection;
+    int32_t _dropsDone;
+    GridIndex _nextMover;
+    int32_t _alienBoomer;
+    int32_t _alienMorpher;
+    bool _isAliensMorphing;
+    bool _isAliensBooming;
+    bool _isAliensSpawning;
+    bool _isAliensDropping;
+    bool _isAliensFrozen;
+    bool _isAliensAboveInvasionRow;
+    bool _haveAliensInvaded;
+    AlienClassId _lastClassAlive;
+    Ufo _ufo;
+    int32_t _ufoDirection;
+    int32_t _ufoCounter;
+    int32_t _ufoLastScoreGiven;
+    bool _isUfoBooming;
+    bool _isUfoScoring;
+    bool _canUfosSpawn;
+    int32_t _bombClock;
+    EntityStore _entities;
+    Laser _laser;
+    int32_t _shotCounter;
+    Cannon _cannon;
+    std::unique_ptr<Bitmap> _hitbarBitmap;
+    std::vector<std::unique_ptr<Bunker>> _bunkers;
+    int32_t _bunkerCount;
+    bool _isRoundIntro;
+    bool _isGameOver;
+    bool _isVictory;
+    std::vector<EntityStore::Entity_t> _boomTimerEntities;
+  };
+
+  SnapshotLoad _snapshotLoad;
+
+  //
+  // The update tick runs as a set of systems on a scheduler, each declaring the parts of the
+  // game state it reads and writes, so systems which do not conflict may run concurrently on
+  // 'systemWorkers' threads (default none; the systems are small). Systems which use the
+  // engine context (input, mixer, random numbers) always run in order on the update thread.
+  //
+  enum SystemResource : Scheduler::Resources_t
+  {
+    RES_ALIENS  = 1 << 0,                      // The fleet and its movement state.
+    RES_BOMBS   = 1 << 1,                      // The entity store and the bomb clock.
+    RES_LASER   = 1 << 2,                      // The laser and the shot counter.
+    RES_CANNON  = 1 << 3,
+    RES_UFO     = 1 << 4,
+    RES_BUNKERS = 1 << 5,
+    RES_HITBAR  = 1 << 6,
+    RES_TIMERS  = 1 << 7,
+    RES_GAME    = 1 << 8,                      // Score, lives, hud, beat box, cycles and flags.
+    RES_CONTEXT = Scheduler::resourceContext,
+    RES_ALL     = ~Scheduler::Resources_t{0}
+  };
+
+  std::unique_ptr<Scheduler> _scheduler;
+  int32_t _tickBeats;                          // The beats of the current tick.
+
+  static constexpr float updateHz {60.f};  // The fixed rate the engine ticks onUpdate.
+  static int32_t toTicks(float seconds) {return std::max(1, static_cast<int32_t>(std::lround(seconds * updateHz)));}
+
+  //
+  // Moving things (cannon, laser, bombs, ufo) have fixed point positions and move by a fixed
+  // point speed each tick, rather than by speed * dt in float, so the simulation is bit-identical
+  // on all platforms. Positions are converted to ints for collisions and to floats for drawing.
+  //
+  static Fixed toSpeed(float pixelsPerSecond) {return Fixed{pixelsPerSecond / updateHz};}
+  TimerWheel _timers;
+  std::array<TimerWheel::Handle, TIMER_COUNT> _timerHandles;  // Unused for TIMER_BOMB_BOOM_END.
+
+  int32_t _gridWidth;                             // Constraint: value=[1, 64].
+  int32_t _gridHeight;                            // Constraint: value=[1, maxGridHeight].
+  int32_t _gridSize;
+
+  //
+  // The alien fleet is stored as a structure of arrays indexed [(row * gridWidth) + col], with
+  // the alive state and animation frame of each row held as bitmasks in which bit n is the 
+  // alien in column n (hence the grid width limit of 64). All aliens, dead or alive, are moved,
+  // thus at the end of each move pass all aliens in a column share an x position and all aliens
+  // in a row share a y position.
+  //
+  static constexpr int32_t nullAlien {-1};
+  int32_t toAlienIndex(int32_t row, int32_t col) const {return (row * _gridWidth) + col;}
+  static uint64_t toColumnBit(int32_t col) {return uint64_t{1} << col;}
+  std::vector<int32_t> _alienXs;
+  std::vector<int32_t> _alienYs;
+  std::vector<AlienClassId> _alienClassIds;
+  std::vector<uint64_t> _alienAliveMasks;
+  std::vector<uint64_t> _alienFrameMasks;
   Vector2i _alienShiftDisplacement;
   static constexpr int32_t minSpawnDrops {6};
   static constexpr int32_t baseAlienDropDisplacement {14};
@@ -694,13 +928,10 @@ private:
   int32_t _worldTopBorderY;
   int32_t _alienMoveDirection;            // Limited to values -1 for left, +1 for right.
   int32_t _dropsDone;
-  int32_t _alienPopulation;               // Count of the number of aliens alive.
   GridIndex _nextMover;                   // The alien to move in the next tick.
-  Alien* _alienBoomer;                    // The alien going BOOM! (not your dad).
-  float _alienBoomClock;                  // Unit: seconds.
+  int32_t _alienBoomer;                   // The alien going BOOM! (not your dad).
   float _alienBoomDuration;               // Unit: seconds.
-  Alien* _alienMorpher;                   // The alien morphing into a cuttle fish.
-  float _alienMorphClock;
+  int32_t _alienMorpher;                  // The alien morphing into a cuttle fish.
   float _alienMorphDuration;              // Unit: seconds. How long it takes to morph into a cuttle fish.
   bool _isAliensMorphing;
   bool _isAliensBooming;
@@ -718,17 +949,15 @@ private:
   std::array<UfoClass, ufoClassCount> _ufoClasses;
   Ufo _ufo;
   Mixer::Channel_t _ufoSfxChannel;
-  static constexpr int tillUfoMin {1200};// each update we do --tillUfo, so for updates at 60hz,
-  static constexpr int tillUfoMax {1800};// to spawn ufo every 25s, set tillUfo = 25*60 = 1500.
-  int32_t _tillUfo;                      // when _tillUfo == 0, ufo spawns.
+  static constexpr int tillUfoMin {1200};// Unit: ticks - so for updates at 60hz, to spawn a ufo
+  static constexpr int tillUfoMax {1800};// every 25s, set till = 25*60 = 1500.
   int32_t _ufoDirection;                 // Constraint: value=-1 (left) or value=1 (right).
   int32_t _ufoCounter;
   int32_t _ufoLastScoreGiven;
-  float _ufoSpawnY;                      // Height of ufos.
-  float _ufoSpeed;                       // Unit: pixels per second.
+  int32_t _ufoSpawnY;                    // Height of ufos.
+  Fixed _ufoSpeed;                       // Unit: pixels per tick.
   float _ufoBoomScoreDuration;           // Unit: seconds.
   float _ufoPhaseDuration;               // Unit: seconds.
-  float _ufoBoomScoreClock;
   bool _isUfoBooming;
   bool _isUfoScoring;                    // Is the score displaying after the ufo was destroyed?
   bool _canUfosSpawn;                    // ufos cannot spawn if alien pop <= 8
@@ -739,7 +968,7 @@ private:
   static constexpr int32_t cycleStart {0};
   static constexpr int32_t cycleEnd {-1};
   using Cycle = std::array<int32_t, cycleLength>;
-  std::array<Cycle, cycleCount> _cycles;
+  std::array<Cycle, cycleCount> _cycles;           // Derived from the base cycles and fleet size.
   std::array<int32_t, cycleCount> _cycleTransitions;
   int32_t _activeCycle;
   int32_t _activeBeat;  // A beat is an element of a cycle.
@@ -747,25 +976,34 @@ private:
   static constexpr int32_t alienClassCount {5};
   std::array<AlienClass, alienClassCount> _alienClasses;
 
+  // Formations list the alien class of each row of the base fleet. Larger fleets stretch the
+  // formation over their rows.
   static constexpr int32_t formationCount {2};
-  using Formation = std::array<std::array<AlienClassId, gridWidth>, gridHeight>;
+  using Formation = std::array<AlienClassId, baseGridHeight>;
   std::array<Formation, formationCount> _formations;
 
   float _bombIntervalDeviation;                    // Max deviation in bomb drop beat count.
   std::array<int32_t, cycleCount> _bombIntervals;  // Beats between bomb drops.
   int32_t _bombInterval;                           // Base beat count between firing.
   int32_t _bombClock;                              // Unit: beats - used to time the firing.
-  std::array<int32_t, gridWidth> _columnPops;      // Populations of alive aliens in each column.
-  std::array<int32_t, gridHeight> _rowPops;        // Populations of alive aliens in each row.
 
   static constexpr int32_t bombClassCount {3};
   std::array<BombClass, bombClassCount> _bombClasses;
 
-  static constexpr int32_t maxBombs {20};
-  std::array<Bomb, maxBombs> _bombs;
-  int32_t _bombCount;
+  int32_t _maxBombs;
+
+  //
+  // Bombs and bomb booms are entities with a Bomb or a BombBoom component. The collision passes
+  // query the bombs so defer booming them and flush the store at the end of the pass. The bomb
+  // collision passes run in reverse row order, which decides the first hit resolved in a tick.
+  //
+  // Only the bombs and booms, which are spawned and destroyed throughout play, live in the
+  // store. The fleet is kept as structure of arrays with alive masks, the cannon, laser and ufo
+  // are singletons, bunkers own (not trivially copyable) bitmaps, and the SosState alien and ufo
+  // belong to another app state, so these are not entities.
+  //
+  EntityStore _entities;
 
-  std::array<BombBoom, maxBombs> _bombBooms;
   std::array<Assets::Key_t, 2> _bombBoomKeys;
   int32_t _bombBoomWidth;
   int32_t _bombBoomHeight;
@@ -776,8 +1014,12 @@ private:
   Cannon _cannon;
 
   std::unique_ptr<Hitbar> _hitbar;
+  int32_t _hitbarHeight;
+  std::unique_ptr<Bitmap> _hitbarDamageMask;                // Clears the bar under a bomb boom.
+  std::array<std::unique_ptr<Bitmap>, 2> _hitbarStripeMasks; // Indexed by parity of the hit x.
 
   std::vector<std::unique_ptr<Bunker>> _bunkers;
+  std::vector<std::unique_ptr<Bunker>> _spareBunkers;  // Deleted bunkers, reused by makeBunker.
   int32_t _bunkerColorIndex;
   int32_t _bunkerSpawnX;
   int32_t _bunkerSpawnY;
@@ -796,7 +1038,6 @@ private:
   static constexpr const char* msgVictory {"VICTORY!"};
   static constexpr const char* msgRoundIntro {"ROUND"};
   static constexpr float msgPeriodSeconds {4.f}; 
-  float _msgClockSeconds;
   bool _isRoundIntro;
   bool _isGameOver;
   bool _isVictory;
@@ -932,6 +1173,10 @@ public:
 
   std::string getName(){return name;}
 
+private:
+  static constexpr int musicFadeInTime_ms {2000};
+  static constexpr int musicFadeOutTime_ms {500};
+
 private:
   void populateHud();
   void depopulateHud();
@@ -1103,4 +1348,362 @@ private:
   float _exitDelaySeconds;
 };
 
+//===============================================================================================//
+// ##>ENVIRONMENT                                                                                //
+//===============================================================================================//
+
+//
+// A reinforcement learning environment over a headless game at world scale 1. Reset starts a 
+// new game and each step holds the keys of an action for a number of update ticks, returning
+// the observation, the score gained as the reward and whether the game is over. Resets and 
+// steps reuse the storage of the game (entities, timers, bunkers, HUD labels), which grows only
+// when the game holds more than it has before, so once the first episodes have warmed it up
+// they do not allocate. The observation is held by the env and overwritten by each call.
+//
+// An env runs in the context of the thread which creates it (see pxr::Context), which must 
+// already exist, and must only be used on that thread. Envs sharing a thread each keep their own
+// random stream, swapped into the context for the duration of each call. The sos interlude 
+// between rounds is skipped as no action affects it. The C interface is in si_env.h.
+//
+// Frame and gray observations may be pooled down by a factor (see Bitmap::poolBits) and any 
+// observation may be stacked, the observation then being the last stack count observations, 
+// oldest first; a reset fills the stack with the first.
+//
+class Env final
+{
+public:
+  enum Action
+  {
+    ACTION_NOOP, ACTION_LEFT, ACTION_RIGHT, ACTION_FIRE, ACTION_LEFT_FIRE, ACTION_RIGHT_FIRE, 
+    ACTION_COUNT
+  };
+
+  enum ObservationType
+  {
+    OBSERVATION_FRAME,     // See GameState::drawObservation; the bitmap's render bytes.
+    OBSERVATION_FEATURES,  // See GameState::writeFeatures; floats.
+    OBSERVATION_GRAY       // See GameState::drawObservationPlanes; a gray byte per pixel.
+  };
+
+  struct Options
+  {
+    ObservationType _observationType {OBSERVATION_FRAME};
+    int32_t _ticksPerStep {1};
+    int32_t _poolFactor {1};     // 1, 2, 4 or 8; frame and gray only.
+    int32_t _stackCount {1};
+  };
+
+  struct Step
+  {
+    std::span<const uint8_t> _observation;
+    int32_t _reward;
+    bool _isDone;
+  };
+
+public:
+  explicit Env(const Options& options);
+  explicit Env(ObservationType observationType, int32_t ticksPerStep = 1);
+  ~Env() = default;
+
+  Env(const Env&) = delete;
+  Env& operator=(const Env&) = delete;
+
+  std::span<const uint8_t> reset(xorwow::result_type seed);
+  Step step(int32_t action);
+
+  // A copy of this env, as of the last call, which continues exactly as this one would.
+  std::unique_ptr<Env> clone() const;
+
+  const Options& getOptions() const {return _options;}
+  ObservationType getObservationType() const {return _options._observationType;}
+  int32_t getTicksPerStep() const {return _options._ticksPerStep;}
+  int32_t getObservationSize() const {return _stack.getFrameCount() * _stack.getFrameSize();}
+  Vector2i getFrameSize() const;
+  std::span<const uint8_t> getObservation() const {return _stack.getFrames();}
+  bool isDone() const {return _isDone;}
+
+private:
+  static constexpr float tickDt {1.f / 60.f};
+
+  int32_t getSingleObservationSize() const;
+  void observe(bool isReset);
+
+  std::unique_ptr<SpaceInvaders> _app;
+  GameState* _game;
+  Options _options;
+  Bitmap _frame;
+  std::vector<Bitmap> _planes;           // Per palette color; gray observations only.
+  std::vector<uint8_t> _grays;
+  std::vector<uint8_t> _observation;     // The latest, before stacking.
+  FrameStack _stack;
+  std::vector<uint8_t> _startSnapshot;   // The game as started, loaded by each reset.
+  xorwow _random;
+  int64_t _tick;
+  int32_t _score;
+  bool _isDone;
+};
+
+//
+// A batch of envs stepped in lockstep by one call. The envs are spread over worker threads, each
+// with its own headless context sharing the given log and sealed assets, and write their 
+// observations, rewards and done flags into contiguous per batch arrays, env i's observation at
+// byte i * getObservationSize(). An env whose game ends in a step is reset within the step, so
+// its observation is then the first of its next game. Each env draws its reset seeds from its 
+// own stream, split from the batch seed, so results do not depend on the thread count.
+//
+class BatchEnv final
+{
+public:
+  BatchEnv(std::shared_ptr<Log> sharedLog, std::shared_ptr<Assets> sealedAssets, int32_t envCount,
+           const Env::Options& options, int32_t threadCount = 1);
+  BatchEnv(std::shared_ptr<Log> sharedLog, std::shared_ptr<Assets> sealedAssets, int32_t envCount,
+           Env::ObservationType observationType, int32_t ticksPerStep = 1, int32_t threadCount = 1);
+  ~BatchEnv();
+
+  BatchEnv(const BatchEnv&) = delete;
+  BatchEnv& operator=(const BatchEnv&) = delete;
+
+  void reset(xorwow::result_type seed);
+  void step(std::span<const int32_t> actions);
+
+  int32_t getEnvCount() const {return _envCount;}
+  int32_t getThreadCount() const {return static_cast<int32_t>(_workers.size());}
+  int32_t getObservationSize() const {return _observationSize;}
+  std::span<const uint8_t> getObservations() const {return _observations;}
+  std::span<const int32_t> getRewards() const {return _rewards;}
+  std::span<const uint8_t> getDones() const {return _dones;}
+
+private:
+  enum Command {COMMAND_CREATE, COMMAND_RESET, COMMAND_STEP, COMMAND_STOP};
+
+  struct Worker
+  {
+    std::thread _thread;
+    std::vector<std::unique_ptr<Env>> _envs;
+    int32_t _firstEnv;
+    int32_t _envCount;
+  };
+
+  void workerLoop(int32_t worker, std::shared_ptr<Log> log, std::shared_ptr<Assets> assets);
+  void runCommand(Command command);
+  void finishCommand();
+  void resetEnv(Env& env, int32_t index);
+  void writeObservation(const Env& env, int32_t index);
+
+  Env::Options _options;
+  int32_t _envCount;
+  int32_t _observationSize;
+  std::vector<Worker> _workers;
+  std::vector<xorwow> _seedStreams;
+  std::vector<int32_t> _actions;
+  std::vector<uint8_t> _observations;
+  std::vector<int32_t> _rewards;
+  std::vector<uint8_t> _dones;
+
+  std::mutex _commandMutex;
+  std::condition_variable _commandCondition;
+  std::condition_variable _finishCondition;
+  Command _command;
+  uint64_t _commandGeneration;
+  int32_t _pendingWorkers;
+};
+
+//===============================================================================================//
+// ##>RECORDING                                                                                  //
+//===============================================================================================//
+
+//
+// Session recordings hold the keys held on each update tick of a headless game played at a 
+// fixed tick rate, from which the game can be replayed exactly, along with a keyframe, a 
+// run length compressed snapshot of the game state (see GameState::saveSnapshot), every 
+// keyframe period. An index of the keyframes at the end of the file lets a replay seek to any
+// tick by restoring the nearest keyframe at or before it and simulating only the remainder.
+//
+// Keyframes can only be taken during play, so one falling due during the sos interlude or a 
+// game over is deferred to the next tick in play. A recording is written as it goes and is 
+// only valid once finished, which writes the index. Files are in native byte order.
+//
+// Layout: header, then per keyframe the keyframe followed by the keys of each tick up to the 
+// next, then the index, then the footer. 
+//
+// A recorder may also write a hash stream alongside, at the path with '.hashes' appended: the
+// state hashed after each tick, by snapshot section, for checking replays reproduce the session
+// bit for bit, e.g. on another machine, build or system worker count (see SessionHashes).
+//
+class SessionRecording
+{
+public:
+  static constexpr int32_t ticksPerSecond {60};
+  static constexpr float tickDt {1.f / ticksPerSecond};
+  static constexpr int32_t defaultKeyframeSeconds {10};
+
+  // The keys held for a tick, a bit each.
+  enum KeyBit : uint8_t {KEYBIT_LEFT = 1 << 0, KEYBIT_RIGHT = 1 << 1, KEYBIT_FIRE = 1 << 2};
+
+  static uint8_t readKeys();
+  static void applyKeys(uint8_t keys);
+
+  static constexpr int32_t hashSectionCount {GameState::SNAPSHOT_SECTION_COUNT};
+  using SectionHashes = std::array<uint64_t, hashSectionCount>;
+
+  //
+  // Hashes the state by snapshot section (see GameState::hashSnapshotSections). Out of play,
+  // e.g. in the sos interlude, only the player section, with the active state, is hashed and
+  // the others are 0.
+  //
+  static void hashSession(SpaceInvaders& app, SectionHashes& hashes);
+  static std::string getHashesPath(const std::string& path) {return path + ".hashes";}
+
+protected:
+  static constexpr uint32_t fileMagic {0x43524953};    // "SIRC"
+  static constexpr uint32_t fileVersion {1};
+
+  //
+  // The parts of the file, written a field at a time in the order declared, so with no padding.
+  // A keyframe is its tick, the keys of the tick before (so key presses replay as recorded), 
+  // the snapshot size, the compressed size and the compressed snapshot.
+  //
+  struct Header
+  {
+    uint32_t _magic;
+    uint32_t _version;
+    int32_t _ticksPerSecond;
+    int32_t _keyframeTicks;
+  };
+
+  struct IndexEntry
+  {
+    int64_t _tick;
+    uint64_t _offset;          // Of the keyframe.
+  };
+
+  struct Footer
+  {
+    uint64_t _indexOffset;
+    int32_t _keyframeCount;
+    int64_t _tickCount;
+    uint32_t _magic;
+  };
+
+  static constexpr size_t headerSize {16};
+  static constexpr size_t keyframeHeaderSize {17};
+  static constexpr uint32_t maxSnapshotSize {1 << 24};   // Far beyond any config's snapshot.
+  static constexpr size_t indexEntrySize {16};
+  static constexpr size_t footerSize {24};
+
+  // The hash stream is a header of the magic, version and section count, then a tick's 
+  // section hashes after another.
+  static constexpr uint32_t hashesMagic {0x53484953};  // "SIHS"
+  static constexpr uint32_t hashesVersion {1};
+};
+
+class SessionRecorder final : public SessionRecording
+{
+public:
+  explicit SessionRecorder(const std::string& path, int32_t keyframeSeconds = defaultKeyframeSeconds, 
+                           bool isHashing = false);
+  ~SessionRecorder();
+
+  SessionRecorder(const SessionRecorder&) = delete;
+  SessionRecorder& operator=(const SessionRecorder&) = delete;
+
+  //
+  // Call on each tick, before the app is updated with the keys set for the tick. The app must 
+  // be in play on the first tick.
+  //
+  void recordTick(SpaceInvaders& app);
+
+  // Call on each tick after the app is updated; does nothing unless hashing.
+  void recordHashes(SpaceInvaders& app);
+
+  // Writes the index; returns false if any write failed.
+  bool finish();
+
+  bool isGood() const {return _file && (!_isHashing || _hashFile);}
+  int64_t getTickCount() const {return _tickCount;}
+  int32_t getKeyframeCount() const {return static_cast<int32_t>(_index.size());}
+
+private:
+  void writeKeyframe(SpaceInvaders& app);
+
+  std::string _path;
+  std::ofstream _file;
+  std::ofstream _hashFile;
+  bool _isHashing;
+  int32_t _keyframeTicks;
+  int64_t _tickCount;
+  int64_t _nextKeyframeTick;
+  uint8_t _previousKeys;
+  std::vector<IndexEntry> _index;
+  bool _isFinished;
+};
+
+//
+// Replays a recording into an app of its own, which runs in the context of the thread which 
+// creates the replay.
+//
+class SessionReplay final : public SessionRecording
+{
+public:
+  explicit SessionReplay(const std::string& path);
+
+  SessionReplay(const SessionReplay&) = delete;
+  SessionReplay& operator=(const SessionReplay&) = delete;
+
+  //
+  // Restores the app to as it was before the given tick was simulated, i.e. after tick - 1, 
+  // restoring the keyframe at or before it and simulating the rest. Fails, returning false, 
+  // if the recording is bad or the tick is outside [0, tick count].
+  //
+  bool seek(int64_t tick);
+
+  // Simulates the next tick; returns false at the end of the recording.
+  bool step();
+
+  bool isGood() const {return _isGood;}
+  int64_t getTick() const {return _tick;}
+  int64_t getTickCount() const {return _footer._tickCount;}
+  int32_t getKeyframeCount() const {return _footer._keyframeCount;}
+  int64_t getKeyframeTick() const {return _keyframeTick;}   // Of the last keyframe restored.
+  SpaceInvaders& getApp() {return *_app;}
+
+private:
+  bool readBlock(int32_t block);
+  bool restoreKeyframe();
+  bool fail();
+
+  std::string _path;
+  std::ifstream _file;
+  Header _header;
+  Footer _footer;
+  std::vector<IndexEntry> _index;
+  std::unique_ptr<SpaceInvaders> _app;
+  std::vector<uint8_t> _blockBytes;
+  std::vector<uint8_t> _snapshot;      // Of the read block.
+  std::span<const uint8_t> _blockKeys; // Keys of the ticks of the read block.
+  int64_t _blockTick;                  // First tick of the read block.
+  uint8_t _blockPreviousKeys;
+  int32_t _block;
+  int64_t _keyframeTick;
+  int64_t _tick;
+  bool _isGood;
+};
+
+//
+// The hash stream of a recording, read whole.
+//
+class SessionHashes final : public SessionRecording
+{
+public:
+  explicit SessionHashes(const std::string& path);
+
+  bool isGood() const {return _isGood;}
+  int64_t getTickCount() const {return static_cast<int64_t>(_hashes.size());}
+  const SectionHashes& getHashes(int64_t tick) const {return _hashes[tick];}
+
+private:
+  std::vector<SectionHashes> _hashes;
+  bool _isGood;
+};
+
 #endif